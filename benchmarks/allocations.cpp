@@ -0,0 +1,64 @@
+#include <iostream>
+#include <vector>
+#include <span>
+#include <new>
+#include <cstdlib>
+
+#include "octree.hpp"
+#include "intersection_bitset.hpp"
+#include "bounding_box.hpp"
+#include "scenes.hpp"
+
+namespace {
+
+size_t number_of_allocations = 0;
+
+} // namespace
+
+void* operator new(size_t size) {
+    ++number_of_allocations;
+
+    if (void* memory = std::malloc(size == 0 ? 1 : size))
+        return memory;
+
+    throw std::bad_alloc{};
+}
+
+void operator delete(void* memory) noexcept {
+    std::free(memory);
+}
+
+void operator delete(void* memory, size_t) noexcept {
+    std::free(memory);
+}
+
+int main() {
+    const size_t number_of_triangles = 20000;
+
+    // Small triangles around a few centers: the tree has some depth and nodes with many pairs
+    std::vector<double> coordinates = Benchmarks::make_scene(Benchmarks::scene_kind_t::clustered, number_of_triangles);
+
+    Octree::octree_t<double> octree{std::span<const double>{coordinates}, Benchmarks::make_bounding_box(coordinates)};
+
+    Geom_objects::intersection_bitset_t result{number_of_triangles};
+
+    size_t allocations_before = number_of_allocations;
+    octree.get_number_of_intersections(result);
+    size_t first_query_allocations = number_of_allocations - allocations_before;
+
+    // The same query again: the result is a preallocated bitset, so every allocation
+    // here comes from traversal or the narrow phase
+    result.clear();
+    allocations_before = number_of_allocations;
+    octree.get_number_of_intersections(result);
+    size_t repeated_query_allocations = number_of_allocations - allocations_before;
+
+    std::cout << "triangles:                          " << number_of_triangles << "\n"
+              << "intersecting triangles:             " << result.size() << "\n"
+              << "allocations in first query:         " << first_query_allocations << "\n"
+              << "allocations in repeated query:      " << repeated_query_allocations << "\n"
+              << "repeated query allocations/polygon: " 
+              << static_cast<double>(repeated_query_allocations) / number_of_triangles << std::endl;
+
+    return repeated_query_allocations == 0 ? 0 : 1;
+}
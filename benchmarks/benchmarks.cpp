@@ -0,0 +1,632 @@
+#include <iostream>
+#include <fstream>
+#include <vector>
+#include <string>
+#include <string_view>
+#include <sstream>
+#include <random>
+#include <span>
+#include <thread>
+#include <bit>
+#include <memory>
+#include <limits>
+
+#include "scenes.hpp"
+#include "harness.hpp"
+#include "input_parser.hpp"
+#include "octree.hpp"
+#include "linear_octree.hpp"
+#include "sweep_and_prune.hpp"
+#include "bvh.hpp"
+#include "hash_grid.hpp"
+#include "intersection_bitset.hpp"
+#include "triangle_batch.hpp"
+#include "thread_pool.hpp"
+#include "options.hpp"
+#include "number_writer.hpp"
+
+namespace {
+
+struct benchmark_options_t {
+    std::vector<size_t>                     sizes       = {1000, 10000, 100000};
+    std::vector<Benchmarks::scene_kind_t>   scenes      = {Benchmarks::scene_kind_t::uniform,
+                                                           Benchmarks::scene_kind_t::clustered,
+                                                           Benchmarks::scene_kind_t::degenerate};
+    size_t                                  repetitions = 3;
+    size_t                                  number_of_threads = 1;
+    std::string                             output_path;  // stdout if empty
+    std::string                             filter;       // only benchmarks with this in the name
+    std::string                             tune_path;    // sweep split parameters over this input instead
+};
+
+void print_usage(const char* program_name) {
+    std::cerr << "Usage: " << program_name << " [options]\n"
+              << "Times parsing, octree construction, queries, pair kernels and output, prints JSON\n"
+              << "Options:\n"
+              << "  --sizes <n,n,...>       numbers of triangles in scenes (1000,10000,100000)\n"
+              << "  --scenes <name,...>     uniform, clustered, degenerate (all)\n"
+              << "  --repetitions <n>       runs of every benchmark, the fastest is reported (3)\n"
+              << "  --threads <n>           also time parallel build and query with n threads (1)\n"
+              << "  --filter <text>         run only benchmarks with text in the name\n"
+              << "  --output <file>         write JSON to file instead of stdout\n"
+              << "  --tune <file>           time octree build and query on triangles of file (text or binary)\n"
+              << "                          with each set of split parameters of a grid, print the fastest\n";
+}
+
+template <typename Function>
+bool for_each_item(std::string_view list, Function&& function) {
+    while (!list.empty()) {
+        size_t comma = list.find(',');
+        if (!function(list.substr(0, comma)))
+            return false;
+        list = comma == std::string_view::npos ? std::string_view{} : list.substr(comma + 1);
+    }
+
+    return true;
+}
+
+bool parse_benchmark_options(int argc, char* argv[], benchmark_options_t& options) {
+    for (int argument_number = 1; argument_number < argc; ++argument_number) {
+        std::string_view argument = argv[argument_number];
+        if (argument == "--help") {
+            print_usage(argv[0]);
+            return false;
+        }
+
+        if (argument_number + 1 >= argc) {
+            std::cerr << "Unexpected argument " << argument << std::endl;
+            print_usage(argv[0]);
+            return false;
+        }
+
+        std::string_view value = argv[++argument_number];
+        bool parsed = true;
+
+        if (argument == "--sizes") {
+            options.sizes.clear();
+            parsed = for_each_item(value, [&](std::string_view item) {
+                options.sizes.push_back(0);
+                return Options::parse_number(item, options.sizes.back());
+            });
+        } else if (argument == "--scenes") {
+            options.scenes.clear();
+            try {
+                for_each_item(value, [&](std::string_view item) {
+                    options.scenes.push_back(Benchmarks::get_scene_kind(item));
+                    return true;
+                });
+            } catch (const std::invalid_argument& error) {
+                std::cerr << error.what() << std::endl;
+                parsed = false;
+            }
+        } else if (argument == "--repetitions") {
+            parsed = Options::parse_number(value, options.repetitions) && options.repetitions != 0;
+        } else if (argument == "--threads") {
+            parsed = Options::parse_number(value, options.number_of_threads);
+        } else if (argument == "--filter") {
+            options.filter = value;
+        } else if (argument == "--output") {
+            options.output_path = value;
+        } else if (argument == "--tune") {
+            options.tune_path = value;
+        } else {
+            std::cerr << "Unexpected argument " << argument << std::endl;
+            print_usage(argv[0]);
+            return false;
+        }
+
+        if (!parsed)
+            return false;
+    }
+
+    return true;
+}
+
+// Coordinates of text or binary input, float records are widened to double
+bool read_input(const std::string& path, std::vector<double>& coordinates) {
+    try {
+        Input::input_buffer_t input_buffer{path};
+
+        if (Input::is_binary_input(input_buffer.view())) {
+            Input::binary_view_t binary_input{input_buffer.view()};
+            if (binary_input.get_scalar_type() == Input::scalar_type_t::float_type) {
+                auto records = binary_input.get_records<float>();
+                coordinates.assign(records.begin(), records.end());
+            } else {
+                auto records = binary_input.get_records<double>();
+                coordinates.assign(records.begin(), records.end());
+            }
+            return true;
+        }
+
+        // The reader of main, with its checks of the count and of the numbers
+        return Input::read_text_input(input_buffer.view(), coordinates);
+    } catch (const std::exception& error) {
+        std::cerr << "Error input: " << error.what() << std::endl;
+        return false;
+    }
+}
+
+// Split parameters swept by --tune, the rest are defaults
+std::vector<Octree::subdivision_parameters_t<double>> make_tuning_grid() {
+    std::vector<Octree::subdivision_parameters_t<double>> grid;
+    for (size_t min_size : std::initializer_list<size_t>{4, 8, 16, 32, 64}) {
+        for (size_t max_depth : std::initializer_list<size_t>{8, 16, 24}) {
+            for (double node_cost : {8.0, 32.0, 128.0, 512.0}) {
+                for (double max_straddling : {0.5, 1.0}) {
+                    grid.emplace_back();
+                    grid.back().min_size       = min_size;
+                    grid.back().max_depth      = max_depth;
+                    grid.back().node_cost      = node_cost;
+                    grid.back().max_straddling = max_straddling;
+                }
+            }
+        }
+    }
+
+    return grid;
+}
+
+// The options of the main program for the parameters
+std::string get_split_arguments(const Octree::subdivision_parameters_t<double>& parameters) {
+    std::ostringstream arguments;
+    arguments << "--min-size " << parameters.min_size << " --max-depth " << parameters.max_depth
+              << " --node-cost " << parameters.node_cost << " --max-straddling " << parameters.max_straddling;
+    return arguments.str();
+}
+
+class benchmark_runner_t {
+    private:
+    const benchmark_options_t& options_;
+    std::vector<Benchmarks::result_t> results_;
+
+    public:
+    explicit benchmark_runner_t(const benchmark_options_t& options): options_{options} {}
+
+    const std::vector<Benchmarks::result_t>& get_results() const { return results_; }
+
+    bool is_selected(const std::string& name) const {
+        return options_.filter.empty() || name.find(options_.filter) != std::string::npos;
+    }
+
+    // Returns the result to add counters to, nullptr if the benchmark is filtered out
+    template <typename Function>
+    Benchmarks::result_t* run(const std::string& name, size_t items, Function&& function) {
+        if (!is_selected(name))
+            return nullptr;
+
+        results_.push_back(Benchmarks::measure(name, options_.repetitions, items, function));
+        std::cerr << "." << std::flush;
+        return &results_.back();
+    }
+
+    void run_scene(Benchmarks::scene_kind_t kind, size_t number_of_triangles) {
+        std::string suffix = "/" + std::string{Benchmarks::get_scene_name(kind)} + "/" +
+                             std::to_string(number_of_triangles);
+
+        std::vector<double> coordinates = Benchmarks::make_scene(kind, number_of_triangles);
+        auto bounding_box = Benchmarks::make_bounding_box(coordinates);
+        std::span<const double> records{coordinates};
+
+        if (is_selected("parse" + suffix)) {
+            std::string text = Benchmarks::make_text_input(coordinates);
+            std::vector<double> parsed;
+
+            auto* result = run("parse" + suffix, number_of_triangles, [&] {
+                Input::text_parser_t<double> parser{text};
+                size_t number = 0;
+                parser.read_number(number);
+
+                parsed.resize(number * Input::coordinates_per_triangle);
+                for (size_t point = 0; point < number * Input::points_in_triangle; ++point)
+                    parser.read_point(parsed.data() + point * Input::coordinates_in_point);
+
+                Benchmarks::do_not_optimize(parsed.back());
+            });
+            result->counters.emplace_back("bytes", static_cast<double>(text.size()));
+        }
+
+        run("extents" + suffix, number_of_triangles, [&] {
+            Benchmarks::do_not_optimize(Geom_objects::get_extents(records).max[0]);
+        });
+
+        run("build" + suffix, number_of_triangles, [&] {
+            Octree::octree_t<double> octree{records, bounding_box};
+            Benchmarks::do_not_optimize(octree.get_number_of_nodes());
+        });
+
+        std::string query_name = "query" + suffix, linear_query_name = "query_linear" + suffix;
+        if (is_selected(query_name) || is_selected(linear_query_name)) {
+            Octree::octree_t<double> octree{records, bounding_box};
+            Geom_objects::intersection_bitset_t result{number_of_triangles};
+
+            auto* query_result = run(query_name, number_of_triangles, [&] {
+                result.clear();
+                octree.get_number_of_intersections(result);
+            });
+            if (query_result != nullptr) {
+                query_result->counters.emplace_back("intersecting", static_cast<double>(result.size()));
+                query_result->counters.emplace_back("nodes", static_cast<double>(octree.get_number_of_nodes()));
+                query_result->counters.emplace_back("pairs", static_cast<double>(octree.get_number_of_pairs()));
+                query_result->counters.emplace_back("rejected_by_boxes",
+                                                    static_cast<double>(octree.get_number_of_rejected_pairs()));
+                query_result->counters.emplace_back("straddlers",
+                                                    static_cast<double>(octree.get_number_of_straddlers()));
+            }
+
+            Octree::linear_octree_t<double> linear_octree{octree};
+            run(linear_query_name, number_of_triangles, [&] {
+                result.clear();
+                linear_octree.get_number_of_intersections(result);
+            });
+        }
+
+        // Children boxes enlarged twice, polygons placed by centroid: fewer straddlers, more nodes
+        if (is_selected("query_loose" + suffix)) {
+            Octree::subdivision_parameters_t<double> parameters;
+            parameters.looseness = 2;
+
+            Octree::octree_t<double> octree{records, bounding_box, parameters};
+            Geom_objects::intersection_bitset_t result{number_of_triangles};
+
+            auto* query_result = run("query_loose" + suffix, number_of_triangles, [&] {
+                result.clear();
+                octree.get_number_of_intersections(result);
+            });
+            query_result->counters.emplace_back("intersecting", static_cast<double>(result.size()));
+            query_result->counters.emplace_back("nodes", static_cast<double>(octree.get_number_of_nodes()));
+            query_result->counters.emplace_back("pairs", static_cast<double>(octree.get_number_of_pairs()));
+            query_result->counters.emplace_back("straddlers", static_cast<double>(octree.get_number_of_straddlers()));
+        }
+
+        run("build_sap" + suffix, number_of_triangles, [&] {
+            Broad_phase::sweep_and_prune_t<double> sweep{records};
+            Benchmarks::do_not_optimize(sweep.get_sweep_axis());
+        });
+
+        if (is_selected("query_sap" + suffix)) {
+            Broad_phase::sweep_and_prune_t<double> sweep{records};
+            Geom_objects::intersection_bitset_t result{number_of_triangles};
+
+            auto* query_result = run("query_sap" + suffix, number_of_triangles, [&] {
+                result.clear();
+                sweep.get_number_of_intersections(result);
+            });
+            query_result->counters.emplace_back("candidates", static_cast<double>(sweep.get_number_of_candidates()));
+        }
+
+        run("build_bvh" + suffix, number_of_triangles, [&] {
+            Broad_phase::bvh_t<double> bvh{records};
+            Benchmarks::do_not_optimize(bvh.get_number_of_nodes());
+        });
+
+        if (is_selected("query_bvh" + suffix)) {
+            Broad_phase::bvh_t<double> bvh{records};
+            Geom_objects::intersection_bitset_t result{number_of_triangles};
+
+            auto* query_result = run("query_bvh" + suffix, number_of_triangles, [&] {
+                result.clear();
+                bvh.get_number_of_intersections(result);
+            });
+            query_result->counters.emplace_back("candidates", static_cast<double>(bvh.get_number_of_candidates()));
+            query_result->counters.emplace_back("nodes", static_cast<double>(bvh.get_number_of_nodes()));
+        }
+
+        run("build_grid" + suffix, number_of_triangles, [&] {
+            Broad_phase::hash_grid_t<double> grid{records};
+            Benchmarks::do_not_optimize(grid.get_number_of_cells());
+        });
+
+        if (is_selected("query_grid" + suffix)) {
+            Broad_phase::hash_grid_t<double> grid{records};
+            Geom_objects::intersection_bitset_t result{number_of_triangles};
+
+            auto* query_result = run("query_grid" + suffix, number_of_triangles, [&] {
+                result.clear();
+                grid.get_number_of_intersections(result);
+            });
+            query_result->counters.emplace_back("candidates", static_cast<double>(grid.get_number_of_candidates()));
+            query_result->counters.emplace_back("cells", static_cast<double>(grid.get_number_of_cells()));
+        }
+
+        if (options_.number_of_threads == 1)
+            return;
+
+        Parallel::thread_pool_t thread_pool{options_.number_of_threads};
+        run("extents_parallel" + suffix, number_of_triangles, [&] {
+            Benchmarks::do_not_optimize(Geom_objects::get_extents(records, thread_pool).max[0]);
+        });
+
+        run("build_parallel" + suffix, number_of_triangles, [&] {
+            Octree::octree_t<double> octree{records, bounding_box, thread_pool};
+            Benchmarks::do_not_optimize(octree.get_number_of_nodes());
+        });
+
+        if (is_selected("query_parallel" + suffix)) {
+            Octree::octree_t<double> octree{records, bounding_box, thread_pool};
+            Geom_objects::intersection_bitset_t result{number_of_triangles};
+
+            run("query_parallel" + suffix, number_of_triangles, [&] {
+                result.clear();
+                octree.get_number_of_intersections(result, thread_pool);
+            });
+        }
+    }
+
+    // Build and query together for every parameters of make_tuning_grid, returns the fastest
+    Octree::subdivision_parameters_t<double> run_tuning(std::span<const double> records) {
+        size_t number_of_triangles = records.size() / Input::coordinates_per_triangle;
+        auto bounding_box = Geom_objects::make_bounding_box<double>(Geom_objects::get_extents(records));
+
+        std::unique_ptr<Parallel::thread_pool_t> thread_pool;
+        if (options_.number_of_threads > 1)
+            thread_pool = std::make_unique<Parallel::thread_pool_t>(options_.number_of_threads);
+
+        Octree::subdivision_parameters_t<double> best_parameters;
+        double best_seconds = std::numeric_limits<double>::infinity();
+
+        for (const auto& parameters : make_tuning_grid()) {
+            std::ostringstream name;
+            name << "tune/leaf" << parameters.min_size << "/depth" << parameters.max_depth << "/cost"
+                 << parameters.node_cost << "/straddle" << parameters.max_straddling;
+
+            Geom_objects::intersection_bitset_t result{number_of_triangles};
+            size_t number_of_nodes = 0, number_of_pairs = 0;
+
+            auto* tuning_result = run(name.str(), number_of_triangles, [&] {
+                result.clear();
+                if (thread_pool) {
+                    Octree::octree_t<double> octree{records, bounding_box, parameters, *thread_pool};
+                    octree.get_number_of_intersections(result, *thread_pool);
+                    number_of_nodes = octree.get_number_of_nodes();
+                    number_of_pairs = octree.get_number_of_pairs();
+                } else {
+                    Octree::octree_t<double> octree{records, bounding_box, parameters};
+                    octree.get_number_of_intersections(result);
+                    number_of_nodes = octree.get_number_of_nodes();
+                    number_of_pairs = octree.get_number_of_pairs();
+                }
+            });
+            if (tuning_result == nullptr)
+                continue;
+
+            tuning_result->counters.emplace_back("intersecting", static_cast<double>(result.size()));
+            tuning_result->counters.emplace_back("nodes", static_cast<double>(number_of_nodes));
+            tuning_result->counters.emplace_back("pairs", static_cast<double>(number_of_pairs));
+
+            if (tuning_result->min_seconds < best_seconds) {
+                best_seconds    = tuning_result->min_seconds;
+                best_parameters = parameters;
+            }
+        }
+
+        return best_parameters;
+    }
+
+    // Printing numbers of intersecting triangles to /dev/null: a flush per line with std::endl,
+    // as main did before, against blocks of number_writer_t
+    void run_output(size_t number_of_numbers) {
+        std::string suffix = "/" + std::to_string(number_of_numbers);
+        std::ofstream output{"/dev/null", std::ios::binary};
+
+        run("output_endl" + suffix, number_of_numbers, [&] {
+            for (size_t number = 0; number < number_of_numbers; ++number)
+                output << number << std::endl;
+        });
+
+        run("output_text" + suffix, number_of_numbers, [&] {
+            Output::number_writer_t writer{output, Output::number_format_t::text};
+            for (size_t number = 0; number < number_of_numbers; ++number)
+                writer.write(number);
+        });
+
+        run("output_binary" + suffix, number_of_numbers, [&] {
+            Output::number_writer_t writer{output, Output::number_format_t::binary};
+            for (size_t number = 0; number < number_of_numbers; ++number)
+                writer.write(number);
+        });
+    }
+
+    // Every pair of two lists of polygons of the given kinds, a few of them intersect
+    void run_pair_kernels() {
+        const size_t number_of_polygons = 512;
+
+        std::mt19937_64 generator{7};
+        std::uniform_real_distribution<double> space{-4.0, 4.0};
+        std::uniform_real_distribution<double> offset{-1.0, 1.0};
+
+        auto make_polygons = [&](Geom_objects::primitive_kind_t kind) {
+            std::vector<Geom_objects::polygon_t<double>> polygons;
+            while (polygons.size() < number_of_polygons) {
+                std::array<double, 3> center{space(generator), space(generator), space(generator)};
+                std::array<double, Input::coordinates_per_triangle> points{};
+                for (size_t coordinate = 0; coordinate < points.size(); ++coordinate)
+                    points[coordinate] = center[coordinate % 3] + offset(generator);
+
+                if (kind == Geom_objects::primitive_kind_t::point) {
+                    for (size_t coordinate = 3; coordinate < points.size(); ++coordinate)
+                        points[coordinate] = points[coordinate % 3];
+                } else if (kind == Geom_objects::primitive_kind_t::segment) {
+                    for (size_t axis = 0; axis < 3; ++axis)
+                        points[6 + axis] = (points[axis] + points[3 + axis]) / 2;
+                }
+
+                auto polygon = Geom_objects::make_geometric_primitive<double>(points.data(), polygons.size());
+                if (polygon.index() == static_cast<size_t>(kind))
+                    polygons.push_back(polygon);
+            }
+
+            return polygons;
+        };
+
+        std::array<std::vector<Geom_objects::polygon_t<double>>, 3> polygons_of_kind{
+            make_polygons(Geom_objects::primitive_kind_t::point),
+            make_polygons(Geom_objects::primitive_kind_t::segment),
+            make_polygons(Geom_objects::primitive_kind_t::triangle)};
+        const std::array<std::string, 3> kind_names{"point", "segment", "triangle"};
+
+        const size_t number_of_pairs = number_of_polygons * number_of_polygons;
+
+        for (size_t first = 0; first < 3; ++first) {
+            for (size_t second = first; second < 3; ++second) {
+                size_t intersections = 0;
+                auto* result = run("pair/" + kind_names[first] + "_" + kind_names[second], number_of_pairs, [&] {
+                    intersections = 0;
+                    for (const auto& first_polygon : polygons_of_kind[first]) {
+                        for (const auto& second_polygon : polygons_of_kind[second])
+                            intersections += Geom_objects::check_figures_intersection(first_polygon, second_polygon);
+                    }
+                });
+
+                if (result != nullptr)
+                    result->counters.emplace_back("intersections", static_cast<double>(intersections));
+            }
+        }
+
+        const auto& triangles = polygons_of_kind[2];
+        const std::array<std::pair<Geom_objects::simd_level_t, std::string>, 4> levels{{
+            {Geom_objects::simd_level_t::none, "none"}, {Geom_objects::simd_level_t::sse, "sse"},
+            {Geom_objects::simd_level_t::avx2, "avx2"}, {Geom_objects::simd_level_t::avx512, "avx512"}}};
+
+        for (const auto& [level, level_name] : levels) {
+            if (level > Geom_objects::get_supported_simd_level())
+                continue;
+
+            Geom_objects::polygon_batch_t<double> batch;
+            batch.set_simd_level(level);
+            for (const auto& triangle : triangles)
+                batch.push_back(triangle);
+
+            size_t intersections = 0;
+            auto* result = run("batch/triangle_triangle/" + level_name, number_of_pairs, [&] {
+                intersections = 0;
+                for (const auto& triangle : triangles)
+                    batch.intersect(triangle, 0, [&](size_t) { ++intersections; });
+            });
+
+            if (result != nullptr)
+                result->counters.emplace_back("intersections", static_cast<double>(intersections));
+        }
+
+        // Triangles against boxes of a 4x4x4 grid over the same space, like octree children
+        std::vector<Geom_objects::AABB_t<double>> boxes;
+        for (size_t cell = 0; cell < 64; ++cell) {
+            Geom_objects::point_t<double> center{-3.0 + 2.0 * double(cell % 4), -3.0 + 2.0 * double(cell / 4 % 4),
+                                                 -3.0 + 2.0 * double(cell / 16)};
+            boxes.emplace_back(center, std::array<double, 3>{1.0, 1.0, 1.0});
+        }
+
+        std::vector<Geom_objects::prepared_triangle_t<double>> prepared;
+        for (const auto& triangle : triangles)
+            prepared.push_back(Geom_objects::prepare_triangle(std::get<Geom_objects::triangle_t<double>>(triangle)));
+
+        size_t touching = 0;
+        auto* result = run("box/triangle", triangles.size() * boxes.size(), [&] {
+            touching = 0;
+            for (const auto& box : boxes) {
+                for (const auto& triangle : triangles)
+                    touching += box.is_polygon_part_inside_box(triangle);
+            }
+        });
+
+        if (result != nullptr)
+            result->counters.emplace_back("touching", static_cast<double>(touching));
+
+        result = run("box/prepared_triangle", triangles.size() * boxes.size(), [&] {
+            touching = 0;
+            for (const auto& box : boxes) {
+                for (size_t number = 0; number < triangles.size(); ++number) {
+                    const auto& triangle = std::get<Geom_objects::triangle_t<double>>(triangles[number]);
+                    touching += box.is_part_inside_box(triangle.get_a(), triangle.get_b(), triangle.get_c(),
+                                                       prepared[number]);
+                }
+            }
+        });
+
+        if (result != nullptr)
+            result->counters.emplace_back("touching", static_cast<double>(touching));
+
+        // The same boxes as octants of 8 parents, all 8 of a parent tested at once
+        for (const auto& [level, level_name] : levels) {
+            if (level > Geom_objects::get_supported_simd_level())
+                continue;
+
+            result = run("box/octants/" + level_name, triangles.size() * boxes.size(), [&] {
+                touching = 0;
+                for (size_t parent = 0; parent < 8; ++parent) {
+                    Geom_objects::point_t<double> center{(parent & 1) ? 2.0 : -2.0, (parent & 2) ? 2.0 : -2.0,
+                                                         (parent & 4) ? 2.0 : -2.0};
+                    Geom_objects::octant_columns_t<double> octants{{center, {2.0, 2.0, 2.0}}};
+
+                    for (size_t number = 0; number < triangles.size(); ++number) {
+                        const auto& triangle = std::get<Geom_objects::triangle_t<double>>(triangles[number]);
+                        touching += static_cast<size_t>(std::popcount(Geom_objects::get_touched_octants(
+                            level, octants, triangle.get_a(), triangle.get_b(), triangle.get_c(), prepared[number])));
+                    }
+                }
+            });
+
+            if (result != nullptr)
+                result->counters.emplace_back("touching", static_cast<double>(touching));
+        }
+    }
+};
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    benchmark_options_t options;
+    if (!parse_benchmark_options(argc, argv, options))
+        return -1;
+
+    benchmark_runner_t runner{options};
+
+    if (!options.tune_path.empty()) {
+        std::vector<double> coordinates;
+        if (!read_input(options.tune_path, coordinates))
+            return -1;
+
+        auto best_parameters = runner.run_tuning(coordinates);
+        std::cerr << "\n";
+
+        Benchmarks::print_table(std::cerr, runner.get_results());
+        std::cerr << "fastest: " << get_split_arguments(best_parameters) << std::endl;
+    } else {
+        runner.run_pair_kernels();
+        for (auto kind : options.scenes) {
+            for (size_t size : options.sizes)
+                runner.run_scene(kind, size);
+        }
+        for (size_t size : options.sizes)
+            runner.run_output(size);
+        std::cerr << "\n";
+
+        Benchmarks::print_table(std::cerr, runner.get_results());
+    }
+
+    std::vector<std::pair<std::string, std::string>> context{
+        {"executable", argv[0]},
+        {"num_cpus", std::to_string(std::thread::hardware_concurrency())},
+        {"threads", std::to_string(options.number_of_threads)},
+        {"repetitions", std::to_string(options.repetitions)},
+        {"library_build_type",
+#ifdef NDEBUG
+         "release"
+#else
+         "debug"
+#endif
+        }};
+
+    if (options.output_path.empty()) {
+        Benchmarks::print_json(std::cout, runner.get_results(), context);
+    } else {
+        std::ofstream output{options.output_path};
+        Benchmarks::print_json(output, runner.get_results(), context);
+        if (!output) {
+            std::cerr << "Error writing " << options.output_path << std::endl;
+            return -1;
+        }
+    }
+
+    return 0;
+}
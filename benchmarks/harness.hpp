@@ -0,0 +1,107 @@
+#ifndef HARNESS_HPP
+#define HARNESS_HPP
+
+#include <vector>
+#include <string>
+#include <chrono>
+#include <algorithm>
+#include <ostream>
+#include <iomanip>
+#include <utility>
+
+namespace Benchmarks {
+
+struct result_t {
+    std::string name;
+    size_t      repetitions = 0;
+    size_t      items       = 0;   // per repetition: triangles, pairs, bytes
+    double      min_seconds = 0;
+    double      mean_seconds = 0;
+    std::vector<std::pair<std::string, double>> counters;
+};
+
+// Runs function repetitions times, the fastest run is the result
+template <typename Function>
+result_t measure(const std::string& name, size_t repetitions, size_t items, Function&& function) {
+    result_t result;
+    result.name        = name;
+    result.repetitions = repetitions;
+    result.items       = items;
+
+    double total_seconds = 0;
+    for (size_t repetition = 0; repetition < repetitions; ++repetition) {
+        auto begin = std::chrono::steady_clock::now();
+        function();
+        std::chrono::duration<double> duration = std::chrono::steady_clock::now() - begin;
+
+        double seconds = duration.count();
+        total_seconds += seconds;
+        if (repetition == 0 || seconds < result.min_seconds)
+            result.min_seconds = seconds;
+    }
+
+    result.mean_seconds = total_seconds / static_cast<double>(repetitions);
+    return result;
+}
+
+// Keeps the optimizer from dropping a computed value
+template <typename T>
+void do_not_optimize(const T& value) {
+    asm volatile("" : : "r,m"(value) : "memory");
+}
+
+inline void print_table(std::ostream& output, const std::vector<result_t>& results) {
+    output << std::left << std::setw(48) << "benchmark" << std::right
+           << std::setw(14) << "min, ms" << std::setw(14) << "mean, ms" << std::setw(16) << "items/s" << "\n";
+
+    for (const auto& result : results) {
+        output << std::left << std::setw(48) << result.name << std::right << std::fixed << std::setprecision(3)
+               << std::setw(14) << result.min_seconds * 1e3 << std::setw(14) << result.mean_seconds * 1e3
+               << std::setw(16) << std::setprecision(0) << result.items / result.min_seconds;
+
+        for (const auto& [counter, value] : result.counters)
+            output << "  " << counter << "=" << value;
+        output << "\n";
+    }
+
+    output << std::defaultfloat << std::flush;
+}
+
+// The layout of Google Benchmark's JSON output, so its compare.py can diff two runs
+inline void print_json(std::ostream& output, const std::vector<result_t>& results,
+                       const std::vector<std::pair<std::string, std::string>>& context) {
+    output << "{\n  \"context\": {\n";
+    for (size_t number = 0; number < context.size(); ++number) {
+        output << "    \"" << context[number].first << "\": \"" << context[number].second << "\""
+               << (number + 1 < context.size() ? ",\n" : "\n");
+    }
+
+    output << "  },\n  \"benchmarks\": [\n" << std::setprecision(17);
+    for (size_t number = 0; number < results.size(); ++number) {
+        const auto& result = results[number];
+        double nanoseconds = result.min_seconds * 1e9;
+
+        output << "    {\n"
+               << "      \"name\": \"" << result.name << "\",\n"
+               << "      \"run_name\": \"" << result.name << "\",\n"
+               << "      \"run_type\": \"iteration\",\n"
+               << "      \"repetitions\": " << result.repetitions << ",\n"
+               << "      \"iterations\": 1,\n"
+               << "      \"real_time\": " << nanoseconds << ",\n"
+               << "      \"cpu_time\": " << nanoseconds << ",\n"
+               << "      \"mean_time\": " << result.mean_seconds * 1e9 << ",\n"
+               << "      \"time_unit\": \"ns\",\n"
+               << "      \"items_per_second\": " << result.items / result.min_seconds;
+
+        for (const auto& [counter, value] : result.counters)
+            output << ",\n      \"" << counter << "\": " << value;
+
+        output << "\n    }" << (number + 1 < results.size() ? ",\n" : "\n");
+    }
+
+    output << "  ]\n}" << std::endl;
+}
+
+} // namespace Benchmarks
+
+#endif // HARNESS_HPP
@@ -0,0 +1,123 @@
+#ifndef SCENES_HPP
+#define SCENES_HPP
+
+#include <vector>
+#include <span>
+#include <array>
+#include <string>
+#include <string_view>
+#include <random>
+#include <cmath>
+#include <charconv>
+#include <stdexcept>
+
+#include "input_parser.hpp"
+#include "bounding_box.hpp"
+
+namespace Benchmarks {
+
+enum class scene_kind_t {
+    uniform,    // small triangles scattered in a cube
+    clustered,  // small triangles around a few centers
+    degenerate  // points, segments and triangles lying in a few shared planes
+};
+
+inline std::string_view get_scene_name(scene_kind_t kind) {
+    switch (kind) {
+        case scene_kind_t::uniform:    return "uniform";
+        case scene_kind_t::clustered:  return "clustered";
+        case scene_kind_t::degenerate: return "degenerate";
+    }
+
+    return "unknown";
+}
+
+inline scene_kind_t get_scene_kind(std::string_view name) {
+    for (auto kind : {scene_kind_t::uniform, scene_kind_t::clustered, scene_kind_t::degenerate}) {
+        if (get_scene_name(kind) == name)
+            return kind;
+    }
+
+    throw std::invalid_argument("unknown scene " + std::string{name});
+}
+
+// Nine coordinates per triangle. The cube grows with the number of triangles,
+// so a triangle has about the same number of neighbours in every size.
+inline std::vector<double> make_scene(scene_kind_t kind, size_t number_of_triangles, unsigned seed = 42) {
+    std::mt19937_64 generator{seed};
+
+    const double triangle_size = 1.0;
+    const double space_size    = 4.0 * std::cbrt(static_cast<double>(number_of_triangles));
+
+    std::uniform_real_distribution<double> space{-space_size, space_size};
+    std::uniform_real_distribution<double> offset{-triangle_size, triangle_size};
+
+    std::vector<double> coordinates;
+    coordinates.reserve(number_of_triangles * Input::coordinates_per_triangle);
+
+    const size_t number_of_clusters = 16;
+    std::vector<std::array<double, 3>> clusters;
+    for (size_t cluster = 0; cluster < number_of_clusters; ++cluster)
+        clusters.push_back({space(generator), space(generator), space(generator)});
+    std::normal_distribution<double> cluster_spread{0.0, space_size / 16};
+
+    for (size_t triangle = 0; triangle < number_of_triangles; ++triangle) {
+        std::array<double, 3> center{space(generator), space(generator), space(generator)};
+        if (kind == scene_kind_t::clustered) {
+            const auto& cluster = clusters[triangle % number_of_clusters];
+            for (size_t axis = 0; axis < 3; ++axis)
+                center[axis] = cluster[axis] + cluster_spread(generator);
+        }
+
+        std::array<double, Input::coordinates_per_triangle> points{};
+        for (size_t coordinate = 0; coordinate < points.size(); ++coordinate)
+            points[coordinate] = center[coordinate % 3] + offset(generator);
+
+        if (kind == scene_kind_t::degenerate) {
+            switch (triangle % 4) {
+                case 0: // point
+                    for (size_t coordinate = 3; coordinate < points.size(); ++coordinate)
+                        points[coordinate] = points[coordinate % 3];
+                    break;
+
+                case 1: // segment: the third point is the middle of the first two
+                    for (size_t axis = 0; axis < 3; ++axis)
+                        points[6 + axis] = (points[axis] + points[3 + axis]) / 2;
+                    break;
+
+                default: // triangle in one of a few planes z = const
+                    for (size_t vertex = 0; vertex < 3; ++vertex)
+                        points[vertex * 3 + 2] = std::round(center[2] / 8) * 8;
+                    break;
+            }
+        }
+
+        coordinates.insert(coordinates.end(), points.begin(), points.end());
+    }
+
+    return coordinates;
+}
+
+// Root box as main builds it
+inline Geom_objects::AABB_t<double> make_bounding_box(const std::vector<double>& coordinates) {
+    return Geom_objects::make_bounding_box<double>(Geom_objects::get_extents(std::span<const double>{coordinates}));
+}
+
+// The input format: number of triangles and then the coordinates
+inline std::string make_text_input(const std::vector<double>& coordinates) {
+    std::string text = std::to_string(coordinates.size() / Input::coordinates_per_triangle) + "\n";
+    text.reserve(coordinates.size() * 24);
+
+    char buffer[32];
+    for (size_t index = 0; index < coordinates.size(); ++index) {
+        auto [end, error] = std::to_chars(buffer, buffer + sizeof(buffer), coordinates[index]);
+        text.append(buffer, end);
+        text += (index % Input::coordinates_per_triangle == Input::coordinates_per_triangle - 1) ? '\n' : ' ';
+    }
+
+    return text;
+}
+
+} // namespace Benchmarks
+
+#endif // SCENES_HPP
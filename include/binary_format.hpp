@@ -0,0 +1,153 @@
+#ifndef BINARY_FORMAT_HPP
+#define BINARY_FORMAT_HPP
+
+#include <array>
+#include <cstdint>
+#include <cstring>
+#include <limits>
+#include <ostream>
+#include <span>
+#include <stdexcept>
+#include <string_view>
+#include <type_traits>
+#include <algorithm>
+#include <cmath>
+
+#include "input_parser.hpp"
+
+namespace Input {
+
+// Binary triangle soup, native (little-endian) byte order:
+//   binary_header_t (64 bytes)
+//   number_of_triangles records of float[9] or double[9]: x, y, z of three points
+// The records are 8-byte aligned, so a mapped file is used in place.
+
+enum class scalar_type_t : uint8_t {
+    float_type  = 4,
+    double_type = 8
+};
+
+const std::array<char, 4> binary_magic = {'T', 'R', 'I', 'S'};
+const uint16_t binary_version          = 1;
+const uint8_t  flag_bounding_box       = 1;
+
+struct binary_header_t {
+    std::array<char, 4> magic;
+    uint16_t            version;
+    scalar_type_t       scalar_type;
+    uint8_t             flags;
+    uint64_t            number_of_triangles;
+    std::array<double, 3> min_point;
+    std::array<double, 3> max_point;
+};
+
+static_assert(sizeof(binary_header_t) == 64, "binary header layout changed");
+static_assert(std::is_trivially_copyable_v<binary_header_t>);
+
+template <typename S>
+constexpr scalar_type_t scalar_type_of() {
+    static_assert(std::is_same_v<S, float> || std::is_same_v<S, double>, "only float and double records");
+    return std::is_same_v<S, float> ? scalar_type_t::float_type : scalar_type_t::double_type;
+}
+
+inline bool is_binary_input(std::string_view input) {
+    return input.size() >= binary_magic.size() &&
+           std::equal(binary_magic.begin(), binary_magic.end(), input.begin());
+}
+
+// View over binary input, nothing is parsed or copied
+class binary_view_t {
+    private:
+    binary_header_t header_;
+    const char*     records_;
+
+    public:
+    explicit binary_view_t(std::string_view input) {
+        if (input.size() < sizeof(binary_header_t))
+            throw std::runtime_error("binary input is shorter than its header");
+
+        std::memcpy(&header_, input.data(), sizeof(binary_header_t));
+
+        if (header_.magic != binary_magic)
+            throw std::runtime_error("binary input has wrong magic");
+
+        if (header_.version != binary_version)
+            throw std::runtime_error("unsupported binary input version " + std::to_string(header_.version));
+
+        if (header_.scalar_type != scalar_type_t::float_type && header_.scalar_type != scalar_type_t::double_type)
+            throw std::runtime_error("unknown scalar type in binary input");
+
+        size_t record_size = coordinates_per_triangle * static_cast<size_t>(header_.scalar_type);
+        size_t available   = (input.size() - sizeof(binary_header_t)) / record_size;
+        if (header_.number_of_triangles > available)
+            throw std::runtime_error("binary input is truncated");
+
+        records_ = input.data() + sizeof(binary_header_t);
+
+        // Like text input, records are coordinates: NaN and infinities are broken input
+        bool is_finite = header_.scalar_type == scalar_type_t::float_type ? are_records_finite<float>()
+                                                                          : are_records_finite<double>();
+        if (!is_finite)
+            throw std::runtime_error("binary input has a coordinate that is not a finite number");
+    }
+
+    size_t        get_number_of_triangles() const { return header_.number_of_triangles; }
+    scalar_type_t get_scalar_type()         const { return header_.scalar_type; }
+    bool          has_bounding_box()        const { return header_.flags & flag_bounding_box; }
+
+    const std::array<double, 3>& get_min_point() const { return header_.min_point; }
+    const std::array<double, 3>& get_max_point() const { return header_.max_point; }
+
+    // coordinates_per_triangle scalars per triangle
+    template <typename S>
+    std::span<const S> get_records() const {
+        if (scalar_type_of<S>() != header_.scalar_type)
+            throw std::logic_error("binary records have another scalar type");
+
+        return {reinterpret_cast<const S*>(records_), header_.number_of_triangles * coordinates_per_triangle};
+    }
+
+    private:
+    template <typename S>
+    bool are_records_finite() const {
+        return std::ranges::all_of(get_records<S>(), [](S coordinate) { return std::isfinite(coordinate); });
+    }
+};
+
+// Writes records of type S converted from coordinates_per_triangle coordinates per triangle
+template <typename S, typename T>
+void write_binary(std::ostream& output, std::span<const T> coordinates) {
+    binary_header_t header{};
+    header.magic               = binary_magic;
+    header.version             = binary_version;
+    header.scalar_type         = scalar_type_of<S>();
+    header.flags               = flag_bounding_box;
+    header.number_of_triangles = coordinates.size() / coordinates_per_triangle;
+    header.min_point.fill(std::numeric_limits<double>::infinity());
+    header.max_point.fill(-std::numeric_limits<double>::infinity());
+
+    for (size_t index = 0; index < coordinates.size(); ++index) {
+        size_t axis = index % coordinates_in_point;
+        // Box of the stored values, so it also bounds the rounded float records
+        double value = static_cast<S>(coordinates[index]);
+        header.min_point[axis] = std::min(header.min_point[axis], value);
+        header.max_point[axis] = std::max(header.max_point[axis], value);
+    }
+
+    if (coordinates.empty())
+        header.flags = 0;
+
+    output.write(reinterpret_cast<const char*>(&header), sizeof(header));
+
+    std::array<S, coordinates_per_triangle> record{};
+    for (size_t index = 0; index + coordinates_per_triangle <= coordinates.size(); index += coordinates_per_triangle) {
+        for (size_t coordinate = 0; coordinate < coordinates_per_triangle; ++coordinate)
+            record[coordinate] = static_cast<S>(coordinates[index + coordinate]);
+
+        output.write(reinterpret_cast<const char*>(record.data()), sizeof(record));
+    }
+}
+
+} // namespace Input
+
+#endif // BINARY_FORMAT_HPP
@@ -4,16 +4,86 @@
 #include <array> 
 #include <variant> 
 #include <limits>
-#include <cassert>
+#include <algorithm>
+#include <cmath>
+#include <utility>
+#include <tuple>
+#include <span>
+#include <vector>
+#include <stdexcept>
 
 #include "point.hpp" 
 #include "segment.hpp"
 #include "triangle.hpp"
 #include "double_compare.hpp"
 #include "polygons.hpp"
+#include "primitive_store.hpp"
+#include "prepared_triangle.hpp"
+#include "thread_pool.hpp"
 
 namespace Geom_objects {
 
+// Triangle against boxes by separating axes, after T. Akenine-Möller, "Fast 3D Triangle-Box
+// Overlap Testing". A box with center m is apart from the triangle if for one of the 13 axes
+// axis · m is out of the slab: the projection of the triangle widened by the projection radius
+// of the box. Corners of the box are never built, boxes of one size share the slabs.
+template <typename T>
+struct triangle_slabs_t {
+    static constexpr size_t number_of_axes     = 13;
+    static constexpr size_t number_of_box_axes = 3;
+
+    std::array<vector_t<T>, number_of_axes> axes;
+    std::array<T, number_of_axes> low, high;
+};
+
+// Axes in order: x, y, z, the normal, x × edges, y × edges, z × edges.
+// The box axes reject most boxes, so they go first.
+template <typename T>
+vector_t<T> get_separating_axis(const prepared_triangle_t<T>& triangle, size_t axis) {
+    const vector_t<T> box_axes[3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
+    if (axis < 3)
+        return box_axes[axis];
+    if (axis == 3)
+        return triangle.normal;
+
+    axis -= 4;
+    return box_axes[axis / 3].cross_product(triangle.edges[axis % 3]);
+}
+
+// All three vertices are projected: axes are built from rounded edges, so the projections
+// of the ends of an edge may differ a little
+template <typename T>
+std::pair<T, T> get_slab(const vector_t<T>& axis, const point_t<T>& a, const point_t<T>& b, const point_t<T>& c,
+                         const std::array<T, 3>& half_edges) {
+    T radius = half_edges[0] * std::fabs(axis.get_x()) + half_edges[1] * std::fabs(axis.get_y()) +
+               half_edges[2] * std::fabs(axis.get_z());
+    auto [low, high] = std::minmax({axis.dot_product(as_vector(a)), axis.dot_product(as_vector(b)),
+                                    axis.dot_product(as_vector(c))});
+    return {low - radius, high + radius};
+}
+
+template <typename T>
+triangle_slabs_t<T> make_triangle_slabs(const point_t<T>& a, const point_t<T>& b, const point_t<T>& c,
+                                        const prepared_triangle_t<T>& triangle, const packed_box_t<T>& box,
+                                        const std::array<T, 3>& half_edges) {
+    triangle_slabs_t<T> slabs;
+
+    // Slabs of the box axes are the box of the triangle widened by the half edges,
+    // the same numbers get_slab would give
+    for (size_t axis = 0; axis < triangle_slabs_t<T>::number_of_box_axes; ++axis) {
+        slabs.axes[axis] = get_separating_axis(triangle, axis);
+        slabs.low[axis]  = box.min[axis] - half_edges[axis];
+        slabs.high[axis] = box.max[axis] + half_edges[axis];
+    }
+
+    for (size_t axis = triangle_slabs_t<T>::number_of_box_axes; axis < triangle_slabs_t<T>::number_of_axes; ++axis) {
+        slabs.axes[axis] = get_separating_axis(triangle, axis);
+        std::tie(slabs.low[axis], slabs.high[axis]) = get_slab(slabs.axes[axis], a, b, c, half_edges);
+    }
+
+    return slabs;
+}
+
 template <typename T>
 class AABB_t {
     public:
@@ -32,13 +102,29 @@ class AABB_t {
     T get_box_x_edge() const;
     T get_box_y_edge() const;
     T get_box_z_edge() const;
+    T get_tolerance() const;
+    std::array<T, number_of_edges> get_widened_edges() const;
+    AABB_t<T> get_octant(size_t octant, T looseness = 1) const;
+    std::array<AABB_t<T>, 8> get_octants(T looseness = 1) const;
     bool is_point_inside_box(const point_t<T>& point) const;
+    bool is_inside_box(const point_t<T>& point) const;
+    bool is_inside_box(const segment_t<T>& segment) const;
+    bool is_inside_box(const triangle_t<T>& triangle) const;
+    bool is_part_inside_box(const point_t<T>& point) const;
+    bool is_part_inside_box(const segment_t<T>& segment) const;
+    bool is_part_inside_box(const triangle_t<T>& triangle) const;
+    bool is_part_inside_box(const point_t<T>& a, const point_t<T>& b, const point_t<T>& c,
+                            const prepared_triangle_t<T>& triangle) const;
+    bool is_part_inside_box(const packed_box_t<T>& box) const;
     bool is_polygon_inside_box(const polygon_t<T>& polygon) const;
     bool is_polygon_part_inside_box(const polygon_t<T>& polygon) const;
-    bool check_triangle_intersection(const triangle_t<T>& triangle) const;
+    bool is_primitive_inside_box(const primitive_store_t<T>& store, 
+                                 typename primitive_store_t<T>::index_t index) const;
+    bool is_primitive_part_inside_box(const primitive_store_t<T>& store, 
+                                      typename primitive_store_t<T>::index_t index) const;
     void get_min_max(point_t<T>& min_pt, point_t<T>& max_pt) const;
-    bool check_axis(const vector_t<T>& axis, const point_t<T>& a, const point_t<T>& b, const point_t<T>& c) const;
     bool check_segment_intersection(const segment_t<T>& segment) const;
+    bool check_segment_intersection(const point_t<T>& beg_point, const vector_t<T>& dir_vector) const;
 
 };
 
@@ -67,6 +153,55 @@ T AABB_t<T>::get_box_z_edge() const {
     return box_edges_[2]; 
 }
 
+// Tolerance of the triangle test, relative to the size of the coordinates:
+// rounding of the projections never loses a triangle that touches the box
+template <typename T>
+T AABB_t<T>::get_tolerance() const {
+    T size = 1;
+    for (size_t axis = 0; axis < number_of_edges; ++axis)
+        size = std::max(size, std::fabs(middle_point_[axis]) + box_edges_[axis]);
+
+    return 2 * Compare::epsilon_v<T> * size;
+}
+
+template <typename T>
+std::array<T, AABB_t<T>::number_of_edges> AABB_t<T>::get_widened_edges() const {
+    T tolerance = get_tolerance();
+    return {box_edges_[0] + tolerance, box_edges_[1] + tolerance, box_edges_[2] + tolerance};
+}
+
+// Octant number of the box: bit 1 takes the lower half along x, bit 2 along y, bit 4 along z.
+// In a loose octree the box itself is enlarged looseness times, so the centers of octants
+// are nearer to its center; a child is enlarged the same way and has half of its edges.
+template <typename T>
+AABB_t<T> AABB_t<T>::get_octant(size_t octant, T looseness) const {
+    std::array<T, number_of_edges> halfs_of_edges {
+        box_edges_[0] / 2,
+        box_edges_[1] / 2,
+        box_edges_[2] / 2
+    };
+
+    std::array<T, number_of_edges> offsets {
+        halfs_of_edges[0] / looseness,
+        halfs_of_edges[1] / looseness,
+        halfs_of_edges[2] / looseness
+    };
+
+    point_t<T> middle_point{
+        middle_point_.get_x() + ((octant & 1) ? -offsets[0] : offsets[0]),
+        middle_point_.get_y() + ((octant & 2) ? -offsets[1] : offsets[1]),
+        middle_point_.get_z() + ((octant & 4) ? -offsets[2] : offsets[2])};
+
+    return AABB_t<T>{middle_point, halfs_of_edges};
+}
+
+template <typename T>
+std::array<AABB_t<T>, 8> AABB_t<T>::get_octants(T looseness) const {
+    return [this, looseness]<size_t... octants>(std::index_sequence<octants...>) {
+        return std::array<AABB_t<T>, 8>{get_octant(octants, looseness)...};
+    }(std::make_index_sequence<8>{});
+}
+
 template <typename T>
 bool AABB_t<T>::is_point_inside_box(const point_t<T>& point) const {
     T x_max = middle_point_.get_x() + box_edges_[0];
@@ -82,109 +217,122 @@ bool AABB_t<T>::is_point_inside_box(const point_t<T>& point) const {
 }
 
 template <typename T>
-bool AABB_t<T>::is_polygon_inside_box(const polygon_t<T>& polygon) const {
-    switch (polygon.index()) {
-        case 0: { // point_t 
-            return is_point_inside_box(std::get<point_t<T>>(polygon));
-        }
-
-        case 1: { // segment_t
-            auto segment = std::get<segment_t<T>>(polygon);
-
-            return is_point_inside_box(segment.get_beg_point()) &&
-                   is_point_inside_box(segment.get_end_point());
-        }
+bool AABB_t<T>::is_inside_box(const point_t<T>& point) const {
+    return is_point_inside_box(point);
+}
 
-        case 2: { // triangle_t
-            auto triangle = std::get<triangle_t<T>>(polygon);
+template <typename T>
+bool AABB_t<T>::is_inside_box(const segment_t<T>& segment) const {
+    return is_point_inside_box(segment.get_beg_point()) &&
+           is_point_inside_box(segment.get_end_point());
+}
 
-            return is_point_inside_box(triangle.get_a()) &&
-                   is_point_inside_box(triangle.get_b()) &&
-                   is_point_inside_box(triangle.get_c());
-        }
+template <typename T>
+bool AABB_t<T>::is_inside_box(const triangle_t<T>& triangle) const {
+    return is_point_inside_box(triangle.get_a()) &&
+           is_point_inside_box(triangle.get_b()) &&
+           is_point_inside_box(triangle.get_c());
+}
 
-        default: {
-            assert(0 && "problem :(");
-            return false; 
-        }
-    }
+template <typename T>
+bool AABB_t<T>::is_part_inside_box(const point_t<T>& point) const {
+    return is_point_inside_box(point);
 }
 
 template <typename T>
-bool AABB_t<T>::is_polygon_part_inside_box(const polygon_t<T>& polygon) const {
-    switch (polygon.index()) {
-        case 0: { // point_t
-            return is_point_inside_box(std::get<point_t<T>>(polygon));
-        }
+bool AABB_t<T>::is_part_inside_box(const segment_t<T>& segment) const {
+    return is_point_inside_box(segment.get_beg_point()) ||
+           is_point_inside_box(segment.get_end_point()) ||
+           check_segment_intersection(segment);
+}
 
-        case 1: { // segment_t 
-            auto segment = std::get<segment_t<T>>(polygon);
+template <typename T>
+bool AABB_t<T>::is_part_inside_box(const triangle_t<T>& triangle) const {
+    return is_part_inside_box(triangle.get_a(), triangle.get_b(), triangle.get_c(), prepare_triangle(triangle));
+}
 
-            return is_point_inside_box(segment.get_beg_point()) ||
-                   is_point_inside_box(segment.get_end_point()) ||
-                   check_segment_intersection(segment);
-        }
+// The slabs of make_triangle_slabs one by one, the box is widened by get_tolerance
+template <typename T>
+bool AABB_t<T>::is_part_inside_box(const point_t<T>& a, const point_t<T>& b, const point_t<T>& c,
+                                   const prepared_triangle_t<T>& triangle) const {
+    auto half_edges = get_widened_edges();
+    auto box = make_box(a, b, c);
+    for (size_t axis = 0; axis < triangle_slabs_t<T>::number_of_box_axes; ++axis) {
+        if (middle_point_[axis] < box.min[axis] - half_edges[axis] ||
+            middle_point_[axis] > box.max[axis] + half_edges[axis])
+            return false;
+    }
 
-        case 2: { // triangle_t
-            auto triangle = std::get<triangle_t<T>>(polygon);
+    for (size_t axis = triangle_slabs_t<T>::number_of_box_axes; axis < triangle_slabs_t<T>::number_of_axes; ++axis) {
+        vector_t<T> separating_axis = get_separating_axis(triangle, axis);
+        auto [low, high] = get_slab(separating_axis, a, b, c, half_edges);
 
-            if (is_point_inside_box(triangle.get_a()) ||
-                is_point_inside_box(triangle.get_b()) ||
-                is_point_inside_box(triangle.get_c())) 
-                return true;
+        T projection = separating_axis.dot_product(as_vector(middle_point_));
+        if (projection < low || projection > high)
+            return false;
+    }
 
-            return check_segment_intersection(triangle.get_segment_ab()) ||
-                   check_segment_intersection(triangle.get_segment_bc()) ||
-                   check_segment_intersection(triangle.get_segment_ca()) ||
-                   check_triangle_intersection(triangle);
-        }
+    return true;
+}
 
-        default: {
-            assert(0 && "problem :(");
+// Whether a tight box of primitives touches the box widened by get_tolerance
+template <typename T>
+bool AABB_t<T>::is_part_inside_box(const packed_box_t<T>& box) const {
+    auto half_edges = get_widened_edges();
+    for (size_t axis = 0; axis < number_of_edges; ++axis) {
+        if (middle_point_[axis] < box.min[axis] - half_edges[axis] ||
+            middle_point_[axis] > box.max[axis] + half_edges[axis])
             return false;
-        }
     }
+
+    return true;
 }
 
+// The overload for the kind of the polygon is picked by std::visit, without a switch
 template <typename T>
-bool AABB_t<T>::check_triangle_intersection(const triangle_t<T>& triangle) const {
-    auto a = triangle.get_a();
-    auto b = triangle.get_b();
-    auto c = triangle.get_c();
+bool AABB_t<T>::is_polygon_inside_box(const polygon_t<T>& polygon) const {
+    return std::visit([this](const auto& primitive) { return is_inside_box(primitive); }, polygon);
+}
 
-    for (size_t axis = 0; axis < 3; ++axis) {
-        T triangle_min = std::min({a[axis], b[axis], c[axis]}); 
-        T triangle_max = std::max({a[axis], b[axis], c[axis]});
+template <typename T>
+bool AABB_t<T>::is_polygon_part_inside_box(const polygon_t<T>& polygon) const {
+    return std::visit([this](const auto& primitive) { return is_part_inside_box(primitive); }, polygon);
+}
 
-        T box_min = middle_point_[axis] - box_edges_[axis];
-        T box_max = middle_point_[axis] + box_edges_[axis];
-        
-        // if projections don't intersect,
-        // there is no intersection
-        if (triangle_max < box_min || triangle_min > box_max) 
+// Vertices of points and segments are repeated in the store, so all three are checked for any kind
+template <typename T>
+bool AABB_t<T>::is_primitive_inside_box(const primitive_store_t<T>& store, 
+                                        typename primitive_store_t<T>::index_t index) const {
+    for (size_t vertex = 0; vertex < primitive_store_t<T>::vertices_in_primitive; ++vertex) {
+        if (!is_point_inside_box(store.get_vertex(index, vertex)))
             return false;
     }
 
-    vector_t<T> normal = triangle.get_plane().get_normal_vector().get_normalized();
+    return true;
+}
 
-    if (!check_axis(normal, a, b, c)) 
-        return false;
+template <typename T>
+bool AABB_t<T>::is_primitive_part_inside_box(const primitive_store_t<T>& store, 
+                                             typename primitive_store_t<T>::index_t index) const {
+    for (size_t vertex = 0; vertex < primitive_store_t<T>::vertices_in_primitive; ++vertex) {
+        if (is_point_inside_box(store.get_vertex(index, vertex)))
+            return true;
+    }
 
-    vector_t<T> aabb_edges[3] = {{1, 0, 0}, {0, 1, 0}, {0, 0, 1}};
-    vector_t<T> triangle_edges[3] = {b - a, c - b, a - c};
+    switch (store.get_kind(index)) {
+        case primitive_kind_t::point:
+            return false;
 
-    for (auto aabb_edge : aabb_edges) {
-        for (auto triangle_edge : triangle_edges) {
-            vector_t<T> axis = aabb_edge.cross_product(triangle_edge);
-            if (axis.is_null_vector()) 
-                continue;
+        case primitive_kind_t::segment:
+            return check_segment_intersection(store.get_vertex(index, 0),
+                                              store.get_vertex(index, 1) - store.get_vertex(index, 0));
 
-            if (!check_axis(axis.get_normalized(), a, b, c)) 
-                return false;
-        }
+        case primitive_kind_t::triangle:
+            return is_part_inside_box(store.get_vertex(index, 0), store.get_vertex(index, 1),
+                                      store.get_vertex(index, 2), store.get_prepared_triangle(index));
     }
 
-    return true;
+    return false;
 }
 
 template <typename T>
@@ -201,59 +349,27 @@ void AABB_t<T>::get_min_max(point_t<T>& min_pt, point_t<T>& max_pt) const {
 }
 
 template <typename T>
-bool AABB_t<T>::check_axis(const vector_t<T>& axis,
-                           const point_t<T>& a,
-                           const point_t<T>& b,
-                           const point_t<T>& c) const {
-    // triangle projection
-    T triangle_proj_a = axis.dot_product(as_vector(a));
-    T triangle_proj_b = axis.dot_product(as_vector(b));
-    T triangle_proj_c = axis.dot_product(as_vector(c));
-
-    T triangle_min = std::min({triangle_proj_a, triangle_proj_b, triangle_proj_c});
-    T triangle_max = std::max({triangle_proj_a, triangle_proj_b, triangle_proj_c});
-
-    // box projection
-    point_t<T> aabb_min, aabb_max;
-    get_min_max(aabb_min, aabb_max);
-    
-    T b_proj_min = std::numeric_limits<T>::max();
-    T b_proj_max = std::numeric_limits<T>::lowest();
-    
-    for (size_t i = 0; i < 8; ++i) {
-        point_t<T> p = {
-            (i & 1) ? aabb_max.get_x() : aabb_min.get_x(),
-            (i & 2) ? aabb_max.get_y() : aabb_min.get_y(),
-            (i & 4) ? aabb_max.get_z() : aabb_min.get_z()
-        };
-        
-        T projection = p.get_x() * axis.get_x() + p.get_y() * axis.get_y() + p.get_z() * axis.get_z();
-        b_proj_min = std::min(b_proj_min, projection);
-        b_proj_max = std::max(b_proj_max, projection);
-    }
-
-    return !(triangle_max < b_proj_min || triangle_min > b_proj_max);
+bool AABB_t<T>::check_segment_intersection(const segment_t<T>& segment) const {
+    return check_segment_intersection(segment.get_beg_point(), segment.get_dir_vector());
 }
 
 template <typename T>
-bool AABB_t<T>::check_segment_intersection(const segment_t<T>& segment) const {
+bool AABB_t<T>::check_segment_intersection(const point_t<T>& beg_point, const vector_t<T>& dir_vector) const {
     point_t<T> aabb_min, aabb_max;
     get_min_max(aabb_min, aabb_max);
     
     T t_min = 0.0;
     T t_max = 1.0;
     
-    vector_t<T> dir_vector = segment.get_dir_vector();
-
     vector_t<T> inv_dir = vector_t<T>(
-        Compare::is_equal(dir_vector.get_x(), 0.0) ? std::numeric_limits<T>::infinity() : 1.0 / dir_vector.get_x(),
-        Compare::is_equal(dir_vector.get_y(), 0.0) ? std::numeric_limits<T>::infinity() : 1.0 / dir_vector.get_y(),
-        Compare::is_equal(dir_vector.get_z(), 0.0) ? std::numeric_limits<T>::infinity() : 1.0 / dir_vector.get_z()
+        Compare::is_equal(dir_vector.get_x(), 0.0) ? std::numeric_limits<T>::infinity() : T{1} / dir_vector.get_x(),
+        Compare::is_equal(dir_vector.get_y(), 0.0) ? std::numeric_limits<T>::infinity() : T{1} / dir_vector.get_y(),
+        Compare::is_equal(dir_vector.get_z(), 0.0) ? std::numeric_limits<T>::infinity() : T{1} / dir_vector.get_z()
     );
 
     for (size_t axis = 0; axis < 3; ++axis) {
-        T t1 = (aabb_min[axis] - segment.get_beg_point()[axis]) * inv_dir[axis];
-        T t2 = (aabb_max[axis] - segment.get_beg_point()[axis]) * inv_dir[axis];
+        T t1 = (aabb_min[axis] - beg_point[axis]) * inv_dir[axis];
+        T t2 = (aabb_max[axis] - beg_point[axis]) * inv_dir[axis];
         
         if (inv_dir[axis] < 0.0) 
             std::swap(t1, t2);
@@ -270,6 +386,160 @@ bool AABB_t<T>::check_segment_intersection(const segment_t<T>& segment) const {
            (Compare::is_greater_or_equal(t_max, 0.0) && Compare::is_less_or_equal(t_min, 1.0));
 }
 
+// Min and max of x, y, z of points stored one after another, in one pass. A block of twelve
+// coordinates holds four whole points: every place of the block keeps its own min and max,
+// so the places don't depend on each other and the loop is vectorized. They are folded by axis
+// at the end. An axis with a NaN or infinite coordinate gets NaN extents: value * 0 is NaN
+// only for them, and sums of it (the marks) stay NaN.
+template <typename S>
+packed_box_t<S> get_extents(std::span<const S> coordinates) {
+    constexpr size_t block_size = 12;
+
+    std::array<S, block_size> block_min, block_max, block_marks{};
+    block_min.fill(std::numeric_limits<S>::infinity());
+    block_max.fill(-std::numeric_limits<S>::infinity());
+
+    const S* data = coordinates.data();
+    size_t blocks_end = coordinates.size() - coordinates.size() % block_size;
+    for (size_t begin = 0; begin < blocks_end; begin += block_size) {
+        for (size_t place = 0; place < block_size; ++place) {
+            S value = data[begin + place];
+            block_min[place] = value < block_min[place] ? value : block_min[place];
+            block_max[place] = value > block_max[place] ? value : block_max[place];
+            block_marks[place] += value * 0;
+        }
+    }
+
+    packed_box_t<S> extents;
+    extents.min.fill(std::numeric_limits<S>::infinity());
+    extents.max.fill(-std::numeric_limits<S>::infinity());
+    std::array<S, 3> marks{};
+
+    for (size_t place = 0; place < block_size; ++place) {
+        extents.min[place % 3] = std::min(extents.min[place % 3], block_min[place]);
+        extents.max[place % 3] = std::max(extents.max[place % 3], block_max[place]);
+        marks[place % 3] += block_marks[place];
+    }
+
+    for (size_t index = blocks_end; index < coordinates.size(); ++index) {
+        S value = data[index];
+        extents.min[index % 3] = value < extents.min[index % 3] ? value : extents.min[index % 3];
+        extents.max[index % 3] = value > extents.max[index % 3] ? value : extents.max[index % 3];
+        marks[index % 3] += value * 0;
+    }
+
+    for (size_t axis = 0; axis < 3; ++axis) {
+        if (std::isnan(marks[axis]))
+            extents.min[axis] = extents.max[axis] = std::numeric_limits<S>::quiet_NaN();
+    }
+
+    return extents;
+}
+
+// The same, parts of the coordinates are reduced by the pool
+template <typename S>
+packed_box_t<S> get_extents(std::span<const S> coordinates, Parallel::thread_pool_t& thread_pool) {
+    // Whole blocks of get_extents, about a megabyte of doubles: smaller parts don't pay for the tasks
+    constexpr size_t part_size = 12 << 14;
+
+    size_t number_of_parts = (coordinates.size() + part_size - 1) / part_size;
+    if (number_of_parts <= 1)
+        return get_extents(coordinates);
+
+    std::vector<packed_box_t<S>> parts(number_of_parts);
+    thread_pool.submit([&] {
+        thread_pool.parallel_for(0, number_of_parts, 1, [&](size_t parts_begin, size_t parts_end) {
+            for (size_t part = parts_begin; part < parts_end; ++part) {
+                size_t begin = part * part_size;
+                parts[part] = get_extents(coordinates.subspan(begin, std::min(part_size, coordinates.size() - begin)));
+            }
+        });
+    });
+    thread_pool.wait();
+
+    // merge_boxes may drop NaN, an axis that is NaN in a part stays NaN
+    packed_box_t<S> extents = parts[0];
+    for (size_t part = 1; part < number_of_parts; ++part) {
+        packed_box_t<S> merged = merge_boxes(extents, parts[part]);
+        for (size_t axis = 0; axis < 3; ++axis) {
+            if (std::isnan(extents.min[axis]) || std::isnan(parts[part].min[axis]))
+                merged.min[axis] = merged.max[axis] = std::numeric_limits<S>::quiet_NaN();
+        }
+        extents = merged;
+    }
+
+    return extents;
+}
+
+// Padding of make_bounding_box, relative to the largest half of the extents
+inline constexpr double bounding_box_padding = 0x1p-10;
+
+// Root box of an octree around the extents of its points: the middle of the extents and halves
+// of their sizes, each widened by padding times the largest half. Points on the faces and scenes
+// flat along an axis stay strictly inside, as is_point_inside_box needs, also after rounding
+// to T. No points (empty extents) give a unit box at the origin. NaN or infinite extents have
+// no box and throw std::domain_error.
+template <typename T, typename S>
+AABB_t<T> make_bounding_box(const packed_box_t<S>& extents, double padding = bounding_box_padding) {
+    constexpr size_t number_of_axes = AABB_t<T>::number_of_edges;
+
+    // Checked before emptiness: NaN extents look empty
+    for (size_t axis = 0; axis < number_of_axes; ++axis) {
+        if (std::isnan(extents.min[axis]) || std::isnan(extents.max[axis]))
+            throw std::domain_error("coordinates are not finite");
+    }
+
+    bool is_empty = false;
+    for (size_t axis = 0; axis < number_of_axes; ++axis)
+        is_empty |= !(extents.min[axis] <= extents.max[axis]);
+
+    if (is_empty)
+        return AABB_t<T>{{0, 0, 0}, {1, 1, 1}};
+
+    std::array<double, number_of_axes> min, max, halfs_of_sizes;
+    double largest_half = 0;
+    for (size_t axis = 0; axis < number_of_axes; ++axis) {
+        min[axis] = static_cast<double>(extents.min[axis]);
+        max[axis] = static_cast<double>(extents.max[axis]);
+        if (!std::isfinite(min[axis]) || !std::isfinite(max[axis]))
+            throw std::domain_error("coordinates are not finite");
+
+        // Halved before the subtraction: the size itself may be out of the range of double
+        halfs_of_sizes[axis] = max[axis] / 2 - min[axis] / 2;
+        largest_half = std::max(largest_half, halfs_of_sizes[axis]);
+    }
+
+    // A single point still gets a box
+    double widening = padding * (largest_half > 0 ? largest_half : 1.0);
+
+    constexpr double epsilon   = std::numeric_limits<T>::epsilon();
+    constexpr double max_value = std::numeric_limits<T>::max();
+
+    std::array<T, number_of_axes> middle, box_edges;
+    for (size_t axis = 0; axis < number_of_axes; ++axis) {
+        double middle_value = min[axis] + halfs_of_sizes[axis];
+
+        // Points of a flat scene on the middle plane would be on the faces of octants at every
+        // depth, and would never go down. At 2/3 of the box they are on no face.
+        if (halfs_of_sizes[axis] == 0)
+            middle_value = min[axis] - widening / 3;
+
+        middle[axis] = static_cast<T>(middle_value);
+
+        // Rounding of the middle and of the faces to T must not cut off the extents: the edge
+        // reaches them from the rounded middle with a margin of a few ulps of the faces.
+        // Edges of boxes near the end of the range of T stay at its largest value.
+        double reach  = std::max(max[axis] - static_cast<double>(middle[axis]),
+                                 static_cast<double>(middle[axis]) - min[axis]);
+        double margin = 4 * epsilon * (reach + std::fabs(static_cast<double>(middle[axis]))) +
+                        std::numeric_limits<T>::min();
+        double edge   = std::max(halfs_of_sizes[axis] + widening, reach + margin);
+        box_edges[axis] = static_cast<T>(std::min(edge, max_value));
+    }
+
+    return AABB_t<T>{point_t<T>{middle[0], middle[1], middle[2]}, box_edges};
+}
+
 } // namespace Geom_objects
 
 #endif // BOUNDING_BOX_HPP 
@@ -0,0 +1,476 @@
+#ifndef BVH_HPP
+#define BVH_HPP
+
+#include <vector>
+#include <array>
+#include <span>
+#include <atomic>
+#include <limits>
+#include <utility>
+#include <algorithm>
+#include <stdexcept>
+#include <cstdint>
+
+#include "polygons.hpp"
+#include "primitive_store.hpp"
+#include "primitive_box.hpp"
+#include "thread_pool.hpp"
+#include "triangle_batch.hpp"
+#include "intersection_bitset.hpp"
+
+namespace Broad_phase {
+
+// Children of an inner node are next to each other: first and first + 1
+template <typename T>
+struct bvh_node_t {
+    std::array<T, 3> min;
+    std::array<T, 3> max;
+    uint32_t first = 0; // first child of an inner node, first primitive of a leaf
+    uint32_t count = 0; // primitives of a leaf, 0 for an inner node
+
+    bool is_leaf() const { return count != 0; }
+};
+
+// Two nodes whose primitives are tested against each other, the same node twice
+// for the primitives of one subtree
+struct node_pair_t {
+    uint32_t first;
+    uint32_t second;
+};
+
+template <typename T>
+class bvh_t;
+
+template <typename T>
+class bvh_detector_of_collisions_t {
+    private:
+    // Pairs of nodes left to visit, and primitives of a pair of leaves overlapping the current one
+    std::vector<node_pair_t> pairs_stack_;
+    Geom_objects::store_batch_t<T> candidates_;
+    size_t number_of_candidates_ = 0;
+
+    public:
+    size_t get_number_of_candidates() const { return number_of_candidates_; }
+
+    // Dual-tree traversal from every given pair: pairs of nodes with disjoint boxes are
+    // dropped, the bigger node of a pair is split until both are leaves
+    template <typename Result>
+    void intersect_node_pairs(const bvh_t<T>& bvh, std::span<const node_pair_t> pairs, Result& result) {
+        for (const auto& start_pair : pairs) {
+            // Used a stack to avoid recursion
+            pairs_stack_.clear();
+            pairs_stack_.push_back(start_pair);
+
+            while (!pairs_stack_.empty()) {
+                node_pair_t pair = pairs_stack_.back();
+                pairs_stack_.pop_back();
+
+                if (!bvh.push_child_pairs(pair, pairs_stack_))
+                    intersect_leaves(bvh, pair, result);
+            }
+        }
+    }
+
+    private:
+    // Every primitive of the first leaf against the primitives of the second one with
+    // overlapping boxes, or against the ones after it for a leaf with itself. Pairs of two
+    // primitives already found intersecting something are counted, but not tested.
+    template <typename Result>
+    void intersect_leaves(const bvh_t<T>& bvh, node_pair_t pair, Result& result) {
+        const auto& boxes = bvh.get_boxes();
+        const auto& store = bvh.get_store();
+        const auto& first = bvh.get_node(pair.first);
+        const auto& second = bvh.get_node(pair.second);
+
+        for (uint32_t number_1 = first.first; number_1 < first.first + first.count; ++number_1) {
+            candidates_.clear();
+            bool polygon_is_found = result.is_found(boxes[number_1].number);
+
+            uint32_t begin = pair.first == pair.second ? number_1 + 1 : second.first;
+            for (uint32_t number_2 = begin; number_2 < second.first + second.count; ++number_2) {
+                if (!boxes_overlap(boxes[number_1], boxes[number_2]))
+                    continue;
+
+                ++number_of_candidates_;
+                if (!polygon_is_found || !result.is_found(boxes[number_2].number))
+                    candidates_.push_back(store, number_2);
+            }
+
+            if (candidates_.size() == 0)
+                continue;
+
+            candidates_.intersect(store, number_1, [&](index_t<T> candidate) {
+                result.insert_pair(boxes[number_1].number, boxes[candidate].number);
+            });
+        }
+    }
+};
+
+// Bounding volume hierarchy over boxes of primitives, built with the binned surface
+// area heuristic. Unlike midpoint octants, splits follow the primitives, so dense
+// regions get deep subtrees and empty space costs nothing.
+template <typename T>
+class bvh_t {
+    public:
+    static constexpr size_t number_of_bins = 16;
+    static constexpr size_t max_leaf_size  = 16; // bigger leaves are split even if SAH disagrees
+    static constexpr T      traversal_cost = 1;  // relative to the cost of a primitive test
+
+    // Subtrees with more primitives are built by their own tasks
+    static constexpr size_t parallel_build_size = 4096;
+    // Pairs of nodes for parallel detection: at least this many per thread
+    static constexpr size_t pairs_per_thread = 32;
+    static constexpr size_t pairs_per_task   = 4;
+
+    private:
+    // Both in the order of leaves: primitives of a leaf lie next to each other in the store.
+    // Indices in the store are places in the order, numbers in the input are in the boxes.
+    std::vector<primitive_box_t<T>> boxes_;
+    Geom_objects::primitive_store_t<T> store_;
+    std::vector<bvh_node_t<T>> nodes_;
+
+    size_t number_of_candidates_ = 0;
+    bvh_detector_of_collisions_t<T> detector_of_collisions_;
+
+    struct build_range_t {
+        uint32_t node;
+        size_t   begin, end;
+    };
+
+    public:
+    // Nine coordinates per triangle
+    template <typename S>
+    explicit bvh_t(std::span<const S> coordinates) {
+        boxes_.resize(coordinates.size() / coordinates_per_triangle);
+        set_boxes(coordinates, 0, boxes_.size());
+        build(nullptr);
+
+        store_.resize(boxes_.size());
+        set_primitives(coordinates, 0, boxes_.size());
+    }
+
+    // The same tree as the serial constructor, only nodes are numbered in another order
+    template <typename S>
+    bvh_t(std::span<const S> coordinates, Parallel::thread_pool_t& thread_pool) {
+        boxes_.resize(coordinates.size() / coordinates_per_triangle);
+        thread_pool.parallel_for(0, boxes_.size(), parallel_build_size, [&](size_t begin, size_t end) {
+            set_boxes(coordinates, begin, end);
+        });
+        build(&thread_pool);
+
+        store_.resize(boxes_.size());
+        thread_pool.parallel_for(0, boxes_.size(), parallel_build_size, [&](size_t begin, size_t end) {
+            set_primitives(coordinates, begin, end);
+        });
+    }
+
+    const Geom_objects::primitive_store_t<T>& get_store()            const { return store_; }
+    const std::vector<primitive_box_t<T>>&    get_boxes()            const { return boxes_; }
+    const bvh_node_t<T>&                      get_node(size_t node)  const { return nodes_[node]; }
+    size_t                                    get_number_of_nodes()  const { return nodes_.size(); }
+
+    // Pairs of primitives with overlapping boxes tested by the last query
+    size_t get_number_of_candidates() const { return number_of_candidates_; }
+
+    size_t get_allocated_bytes() const {
+        return boxes_.capacity() * sizeof(primitive_box_t<T>) + nodes_.capacity() * sizeof(bvh_node_t<T>);
+    }
+
+    // Pushes the pairs the pair is split into. Returns false for two leaves or a leaf with itself,
+    // their primitives are tested directly.
+    bool push_child_pairs(node_pair_t pair, std::vector<node_pair_t>& pairs) const {
+        const auto& first = nodes_[pair.first];
+        const auto& second = nodes_[pair.second];
+
+        if (pair.first == pair.second) {
+            if (first.is_leaf())
+                return false;
+
+            pairs.push_back({first.first, first.first});
+            pairs.push_back({first.first + 1, first.first + 1});
+            pairs.push_back({first.first, first.first + 1});
+            return true;
+        }
+
+        if (!boxes_overlap(first, second))
+            return true;
+
+        if (first.is_leaf() && second.is_leaf())
+            return false;
+
+        // The bigger node is split, the order of nodes in a pair is kept
+        if (second.is_leaf() || (!first.is_leaf() && get_half_area(first) >= get_half_area(second))) {
+            pairs.push_back({first.first, pair.second});
+            pairs.push_back({first.first + 1, pair.second});
+        } else {
+            pairs.push_back({pair.first, second.first});
+            pairs.push_back({pair.first, second.first + 1});
+        }
+
+        return true;
+    }
+
+    // Self-collision: the traversal starts from the root paired with itself
+    template <typename Result>
+    void get_number_of_intersections(Result& result) {
+        if (nodes_.empty())
+            return;
+
+        size_t candidates_before = detector_of_collisions_.get_number_of_candidates();
+        node_pair_t root_pair{0, 0};
+        detector_of_collisions_.intersect_node_pairs(*this, {&root_pair, 1}, result);
+        number_of_candidates_ = detector_of_collisions_.get_number_of_candidates() - candidates_before;
+    }
+
+    // The traversal is unrolled from the root until there are enough pairs of nodes
+    // for all threads, each worker has its own detector, the result is shared
+    template <typename Result>
+    void get_number_of_intersections(Result& result, Parallel::thread_pool_t& thread_pool) {
+        if (nodes_.empty())
+            return;
+
+        std::vector<node_pair_t> pairs{{0, 0}}, next_pairs;
+        size_t enough_pairs = pairs_per_thread * thread_pool.get_number_of_threads();
+
+        bool split = true;
+        while (split && pairs.size() < enough_pairs) {
+            split = false;
+            next_pairs.clear();
+            for (auto pair : pairs) {
+                if (push_child_pairs(pair, next_pairs))
+                    split = true;
+                else
+                    next_pairs.push_back(pair);
+            }
+            pairs.swap(next_pairs);
+        }
+
+        std::vector<bvh_detector_of_collisions_t<T>> detectors(thread_pool.get_number_of_threads());
+
+        thread_pool.submit([&] {
+            thread_pool.parallel_for(0, pairs.size(), pairs_per_task, [&](size_t begin, size_t end) {
+                size_t worker = thread_pool.get_current_worker();
+                detectors[worker].intersect_node_pairs(*this, {pairs.data() + begin, end - begin}, result);
+            });
+        });
+        thread_pool.wait();
+
+        number_of_candidates_ = 0;
+        for (const auto& detector : detectors)
+            number_of_candidates_ += detector.get_number_of_candidates();
+    }
+
+    private:
+    static constexpr size_t coordinates_per_triangle = 9;
+
+    template <typename S>
+    void set_boxes(std::span<const S> coordinates, size_t begin, size_t end) {
+        for (size_t number = begin; number < end; ++number)
+            boxes_[number] = make_primitive_box<T>(coordinates.data() + number * coordinates_per_triangle, number);
+    }
+
+    template <typename S>
+    void set_primitives(std::span<const S> coordinates, size_t begin, size_t end) {
+        for (size_t place = begin; place < end; ++place) {
+            size_t number = boxes_[place].number;
+            store_.set(static_cast<index_t<T>>(place), Geom_objects::make_geometric_primitive<T>(
+                                                          coordinates.data() + number * coordinates_per_triangle,
+                                                          number));
+        }
+    }
+
+    template <typename Box>
+    static T get_half_area(const Box& box) {
+        T x = box.max[0] - box.min[0], y = box.max[1] - box.min[1], z = box.max[2] - box.min[2];
+        return x * y + y * z + z * x;
+    }
+
+    static T get_center(const primitive_box_t<T>& box, size_t axis) {
+        return (box.min[axis] + box.max[axis]) / 2;
+    }
+
+    void build(Parallel::thread_pool_t* thread_pool) {
+        if (boxes_.empty())
+            return;
+
+        if (boxes_.size() > std::numeric_limits<uint32_t>::max() / 2)
+            throw std::length_error("too many primitives for 32-bit node indices");
+
+        // A binary tree with n leaves at most has 2n - 1 nodes
+        nodes_.resize(2 * boxes_.size() - 1);
+        std::atomic<uint32_t> next_node = 1;
+
+        if (thread_pool == nullptr) {
+            build_subtree({0, 0, boxes_.size()}, next_node, nullptr);
+        } else {
+            thread_pool->submit([this, &next_node, thread_pool] {
+                build_subtree({0, 0, boxes_.size()}, next_node, thread_pool);
+            });
+            thread_pool->wait();
+        }
+
+        nodes_.resize(next_node);
+        nodes_.shrink_to_fit();
+    }
+
+    void build_subtree(build_range_t root_range, std::atomic<uint32_t>& next_node,
+                       Parallel::thread_pool_t* thread_pool) {
+        // Used a stack to avoid recursion
+        std::vector<build_range_t> ranges_stack{root_range};
+
+        while (!ranges_stack.empty()) {
+            build_range_t range = ranges_stack.back();
+            ranges_stack.pop_back();
+
+            auto& node = nodes_[range.node];
+            set_node_box(node, range.begin, range.end);
+
+            size_t middle = split_range(node, range.begin, range.end);
+            if (middle == range.begin) {
+                node.first = static_cast<uint32_t>(range.begin);
+                node.count = static_cast<uint32_t>(range.end - range.begin);
+                continue;
+            }
+
+            node.first = next_node.fetch_add(2);
+            node.count = 0;
+
+            for (build_range_t child : {build_range_t{node.first, range.begin, middle},
+                                        build_range_t{node.first + 1, middle, range.end}}) {
+                if (thread_pool != nullptr && child.end - child.begin > parallel_build_size) {
+                    thread_pool->submit([this, child, &next_node, thread_pool] {
+                        build_subtree(child, next_node, thread_pool);
+                    });
+                } else {
+                    ranges_stack.push_back(child);
+                }
+            }
+        }
+    }
+
+    void set_node_box(bvh_node_t<T>& node, size_t begin, size_t end) const {
+        node.min = boxes_[begin].min;
+        node.max = boxes_[begin].max;
+        for (size_t number = begin + 1; number < end; ++number) {
+            for (size_t axis = 0; axis < 3; ++axis) {
+                node.min[axis] = std::min(node.min[axis], boxes_[number].min[axis]);
+                node.max[axis] = std::max(node.max[axis], boxes_[number].max[axis]);
+            }
+        }
+    }
+
+    // Finds the cheapest split of [begin, end) by centers of boxes in number_of_bins bins
+    // on every axis and partitions the boxes. Returns begin if a leaf is cheaper or the
+    // centers can't be separated.
+    size_t split_range(const bvh_node_t<T>& node, size_t begin, size_t end) {
+        size_t count = end - begin;
+        if (count <= 2)
+            return begin;
+
+        std::array<T, 3> center_min, center_max;
+        for (size_t axis = 0; axis < 3; ++axis) {
+            center_min[axis] = center_max[axis] = get_center(boxes_[begin], axis);
+            for (size_t number = begin + 1; number < end; ++number) {
+                center_min[axis] = std::min(center_min[axis], get_center(boxes_[number], axis));
+                center_max[axis] = std::max(center_max[axis], get_center(boxes_[number], axis));
+            }
+        }
+
+        struct bin_t {
+            std::array<T, 3> min, max;
+            size_t count = 0;
+        };
+
+        T best_cost = std::numeric_limits<T>::max();
+        size_t best_axis = 0, best_bin = 0;
+
+        for (size_t axis = 0; axis < 3; ++axis) {
+            T extent = center_max[axis] - center_min[axis];
+            if (!(extent > 0))
+                continue;
+
+            T scale = static_cast<T>(number_of_bins) / extent;
+            std::array<bin_t, number_of_bins> bins{};
+            for (size_t number = begin; number < end; ++number) {
+                auto& bin = bins[get_bin(boxes_[number], axis, center_min[axis], scale)];
+                if (bin.count++ == 0) {
+                    bin.min = boxes_[number].min;
+                    bin.max = boxes_[number].max;
+                    continue;
+                }
+                for (size_t box_axis = 0; box_axis < 3; ++box_axis) {
+                    bin.min[box_axis] = std::min(bin.min[box_axis], boxes_[number].min[box_axis]);
+                    bin.max[box_axis] = std::max(bin.max[box_axis], boxes_[number].max[box_axis]);
+                }
+            }
+
+            // Areas and counts of everything right of every split, then a sweep from the left
+            std::array<T, number_of_bins> right_areas{};
+            std::array<size_t, number_of_bins> right_counts{};
+            bin_t right{};
+            for (size_t bin = number_of_bins - 1; bin > 0; --bin) {
+                merge_bins(right, bins[bin]);
+                right_areas[bin]  = right.count ? get_half_area(right) : 0;
+                right_counts[bin] = right.count;
+            }
+
+            bin_t left{};
+            for (size_t bin = 1; bin < number_of_bins; ++bin) {
+                merge_bins(left, bins[bin - 1]);
+                if (left.count == 0 || right_counts[bin] == 0)
+                    continue;
+
+                T cost = get_half_area(left) * static_cast<T>(left.count) +
+                         right_areas[bin] * static_cast<T>(right_counts[bin]);
+                if (cost < best_cost) {
+                    best_cost = cost;
+                    best_axis = axis;
+                    best_bin  = bin;
+                }
+            }
+        }
+
+        if (best_bin == 0)
+            return begin;
+
+        T node_area = get_half_area(node);
+        T leaf_cost = static_cast<T>(count);
+        T split_cost = traversal_cost + (node_area > 0 ? best_cost / node_area : leaf_cost);
+        if (split_cost >= leaf_cost && count <= max_leaf_size)
+            return begin;
+
+        T extent = center_max[best_axis] - center_min[best_axis];
+        T scale = static_cast<T>(number_of_bins) / extent;
+        auto middle = std::partition(boxes_.data() + begin, boxes_.data() + end, [&](const auto& box) {
+            return get_bin(box, best_axis, center_min[best_axis], scale) < best_bin;
+        });
+
+        return static_cast<size_t>(middle - boxes_.data());
+    }
+
+    static size_t get_bin(const primitive_box_t<T>& box, size_t axis, T center_min, T scale) {
+        T position = (get_center(box, axis) - center_min) * scale;
+        return std::min(number_of_bins - 1, static_cast<size_t>(position));
+    }
+
+    template <typename Bin>
+    static void merge_bins(Bin& result, const Bin& bin) {
+        if (bin.count == 0)
+            return;
+
+        if (result.count == 0) {
+            result = bin;
+            return;
+        }
+
+        for (size_t axis = 0; axis < 3; ++axis) {
+            result.min[axis] = std::min(result.min[axis], bin.min[axis]);
+            result.max[axis] = std::max(result.max[axis], bin.max[axis]);
+        }
+        result.count += bin.count;
+    }
+};
+
+} // namespace Broad_phase
+
+#endif // BVH_HPP
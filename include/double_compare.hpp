@@ -2,26 +2,37 @@
 #define DOUBLE_COMPARE_HPP
 
 #include <array>
+#include <cmath>
+#include <type_traits>
 
 namespace Compare {
-    
-const double epsilon = 1.0e-9;
+
+// Tolerance of comparisons of a scalar type. Float has about 7 significant digits,
+// close calls of the float pipeline are decided again in double.
+template <typename T>
+inline constexpr T epsilon_v = static_cast<T>(1.0e-9);
+
+template <>
+inline constexpr float epsilon_v<float> = 1.0e-6f;
+
+const double epsilon = epsilon_v<double>;
 
 template <typename T>
 using interval = std::array<T, 2>;
 
+// y is converted to the type of x, so is_equal(x, 0.0) works for float x
 template <typename T>
-bool is_equal(const T x, const T y) {
-    return std::fabs(x - y) < epsilon;    
+bool is_equal(const T x, const std::type_identity_t<T> y) {
+    return std::fabs(x - y) < epsilon_v<T>;
 }
 
 template <typename T>
-bool is_greater_or_equal(const T x, const T y) {
+bool is_greater_or_equal(const T x, const std::type_identity_t<T> y) {
     return Compare::is_equal(x, y) || (x > y);    
 }
 
 template <typename T>
-bool is_less_or_equal(const T x, const T y) {
+bool is_less_or_equal(const T x, const std::type_identity_t<T> y) {
     return Compare::is_equal(x, y) || (x < y);    
 }
 
@@ -0,0 +1,313 @@
+#ifndef HASH_GRID_HPP
+#define HASH_GRID_HPP
+
+#include <vector>
+#include <array>
+#include <span>
+#include <cmath>
+#include <limits>
+#include <algorithm>
+#include <cstdint>
+
+#include "polygons.hpp"
+#include "primitive_store.hpp"
+#include "primitive_box.hpp"
+#include "thread_pool.hpp"
+#include "triangle_batch.hpp"
+#include "intersection_bitset.hpp"
+
+namespace Broad_phase {
+
+// A primitive in one cell, cells are numbered by x, y, z packed into one key
+template <typename T>
+struct grid_entry_t {
+    uint64_t   cell;
+    index_t<T> index;
+};
+
+template <typename T>
+class hash_grid_t;
+
+template <typename T>
+class grid_detector_of_collisions_t {
+    private:
+    // Primitives of the current cell tested against the current one, as one batch
+    Geom_objects::store_batch_t<T> candidates_;
+    size_t number_of_candidates_ = 0;
+
+    public:
+    size_t get_number_of_candidates() const { return number_of_candidates_; }
+
+    // Primitives of cells [begin, end) against each other. A pair of primitives may share
+    // several cells, it is tested only in the cell of the lowest corner of the overlap of their boxes.
+    // Pairs of two primitives already found intersecting something are counted, but not tested.
+    template <typename Result>
+    void intersect_cells(const hash_grid_t<T>& grid, size_t begin, size_t end, Result& result) {
+        const auto& store = grid.get_store();
+        const auto& boxes = grid.get_boxes();
+        const auto& entries = grid.get_entries();
+
+        for (size_t cell = begin; cell < end; ++cell) {
+            auto [cell_begin, cell_end] = grid.get_cell_entries(cell);
+            uint64_t cell_key = entries[cell_begin].cell;
+
+            for (size_t number_1 = cell_begin; number_1 < cell_end; ++number_1) {
+                index_t<T> index_1 = entries[number_1].index;
+                const auto& box_1 = boxes[index_1];
+                bool polygon_is_found = result.is_found(store.get_number(index_1));
+
+                candidates_.clear();
+                for (size_t number_2 = number_1 + 1; number_2 < cell_end; ++number_2) {
+                    index_t<T> index_2 = entries[number_2].index;
+                    const auto& box_2 = boxes[index_2];
+
+                    if (!boxes_overlap(box_1, box_2))
+                        continue;
+
+                    std::array<T, 3> overlap_min;
+                    for (size_t axis = 0; axis < 3; ++axis)
+                        overlap_min[axis] = std::max(box_1.min[axis], box_2.min[axis]);
+
+                    if (grid.get_cell_key(overlap_min) != cell_key)
+                        continue;
+
+                    ++number_of_candidates_;
+                    if (!polygon_is_found || !result.is_found(store.get_number(index_2)))
+                        candidates_.push_back(store, index_2);
+                }
+
+                if (candidates_.size() == 0)
+                    continue;
+
+                candidates_.intersect(store, index_1, [&](index_t<T> candidate) {
+                    result.insert_pair(store.get_number(index_1), store.get_number(candidate));
+                });
+            }
+        }
+    }
+};
+
+// Uniform grid with the cell size of a typical primitive: the median of the longest
+// edges of their boxes. Every primitive goes to each cell its box overlaps. Only
+// occupied cells are kept: entries are sorted by packed cell keys instead of hashing,
+// so a cell is a contiguous run and keys never collide.
+template <typename T>
+class hash_grid_t {
+    public:
+    static constexpr size_t bits_per_axis = 21; // three axes in a 64-bit key
+    static constexpr int64_t max_cells_per_axis = int64_t{1} << bits_per_axis;
+
+    // The cell grows while primitives overlap more cells on average
+    static constexpr size_t max_cells_per_primitive = 16;
+
+    static constexpr size_t parallel_build_size = 4096;
+    static constexpr size_t cells_per_task      = 256;
+
+    private:
+    // Primitives are in the input order, the boxes too
+    Geom_objects::primitive_store_t<T> store_;
+    std::vector<primitive_box_t<T>> boxes_;
+
+    std::array<T, 3> origin_{};
+    T cell_size_ = 1;
+
+    std::vector<grid_entry_t<T>> entries_;  // sorted by cell, then by index
+    std::vector<size_t> cell_starts_;        // first entry of every cell and entries_.size()
+
+    size_t number_of_candidates_ = 0;
+    grid_detector_of_collisions_t<T> detector_of_collisions_;
+
+    public:
+    // Nine coordinates per triangle
+    template <typename S>
+    explicit hash_grid_t(std::span<const S> coordinates) {
+        size_t number_of_polygons = coordinates.size() / coordinates_per_triangle;
+        store_.resize(number_of_polygons);
+        boxes_.resize(number_of_polygons);
+        set_primitives(coordinates, 0, number_of_polygons);
+
+        choose_cell_size();
+        fill_cells(nullptr);
+    }
+
+    template <typename S>
+    hash_grid_t(std::span<const S> coordinates, Parallel::thread_pool_t& thread_pool) {
+        size_t number_of_polygons = coordinates.size() / coordinates_per_triangle;
+        store_.resize(number_of_polygons);
+        boxes_.resize(number_of_polygons);
+        thread_pool.parallel_for(0, number_of_polygons, parallel_build_size, [&](size_t begin, size_t end) {
+            set_primitives(coordinates, begin, end);
+        });
+
+        choose_cell_size();
+        fill_cells(&thread_pool);
+    }
+
+    const Geom_objects::primitive_store_t<T>& get_store()           const { return store_; }
+    const std::vector<primitive_box_t<T>>&    get_boxes()           const { return boxes_; }
+    const std::vector<grid_entry_t<T>>&       get_entries()         const { return entries_; }
+    size_t                                    get_number_of_cells() const { return cell_starts_.size() - 1; }
+    T                                         get_cell_size()       const { return cell_size_; }
+
+    std::pair<size_t, size_t> get_cell_entries(size_t cell) const {
+        return {cell_starts_[cell], cell_starts_[cell + 1]};
+    }
+
+    // Pairs of primitives with overlapping boxes tested by the last query
+    size_t get_number_of_candidates() const { return number_of_candidates_; }
+
+    size_t get_allocated_bytes() const {
+        return boxes_.capacity() * sizeof(primitive_box_t<T>) + entries_.capacity() * sizeof(grid_entry_t<T>) +
+               cell_starts_.capacity() * sizeof(size_t);
+    }
+
+    uint64_t get_cell_key(const std::array<T, 3>& point) const {
+        uint64_t key = 0;
+        for (size_t axis = 0; axis < 3; ++axis)
+            key = (key << bits_per_axis) | static_cast<uint64_t>(get_cell(point[axis], axis));
+        return key;
+    }
+
+    // Occupied cells one by one, in the order of their keys
+    template <typename Result>
+    void get_number_of_intersections(Result& result) {
+        size_t candidates_before = detector_of_collisions_.get_number_of_candidates();
+        detector_of_collisions_.intersect_cells(*this, 0, get_number_of_cells(), result);
+        number_of_candidates_ = detector_of_collisions_.get_number_of_candidates() - candidates_before;
+    }
+
+    // A pair is tested only in one cell, so runs of cells go to workers with no coordination
+    // beyond the shared result
+    template <typename Result>
+    void get_number_of_intersections(Result& result, Parallel::thread_pool_t& thread_pool) {
+        std::vector<grid_detector_of_collisions_t<T>> detectors(thread_pool.get_number_of_threads());
+
+        thread_pool.submit([&] {
+            thread_pool.parallel_for(0, get_number_of_cells(), cells_per_task, [&](size_t begin, size_t end) {
+                size_t worker = thread_pool.get_current_worker();
+                detectors[worker].intersect_cells(*this, begin, end, result);
+            });
+        });
+        thread_pool.wait();
+
+        number_of_candidates_ = 0;
+        for (const auto& detector : detectors)
+            number_of_candidates_ += detector.get_number_of_candidates();
+    }
+
+    private:
+    static constexpr size_t coordinates_per_triangle = 9;
+
+    template <typename S>
+    void set_primitives(std::span<const S> coordinates, size_t begin, size_t end) {
+        for (size_t number = begin; number < end; ++number) {
+            const S* points = coordinates.data() + number * coordinates_per_triangle;
+            store_.set(static_cast<index_t<T>>(number), Geom_objects::make_geometric_primitive<T>(points, number));
+            boxes_[number] = make_primitive_box<T>(points, number);
+        }
+    }
+
+    int64_t get_cell(T coordinate, size_t axis) const {
+        T cell = std::floor((coordinate - origin_[axis]) / cell_size_);
+        return std::clamp(static_cast<int64_t>(cell), int64_t{0}, max_cells_per_axis - 1);
+    }
+
+    size_t get_number_of_box_cells(const primitive_box_t<T>& box) const {
+        size_t number_of_cells = 1;
+        for (size_t axis = 0; axis < 3; ++axis)
+            number_of_cells *= static_cast<size_t>(get_cell(box.max[axis], axis) - get_cell(box.min[axis], axis) + 1);
+        return number_of_cells;
+    }
+
+    // The median of the longest box edges, but not so small that the scene
+    // doesn't fit into the keys or primitives overlap too many cells
+    void choose_cell_size() {
+        if (boxes_.empty())
+            return;
+
+        std::array<T, 3> scene_max;
+        origin_ = scene_max = boxes_[0].min;
+        std::vector<T> extents(boxes_.size());
+        for (size_t number = 0; number < boxes_.size(); ++number) {
+            const auto& box = boxes_[number];
+            extents[number] = 0;
+            for (size_t axis = 0; axis < 3; ++axis) {
+                origin_[axis]   = std::min(origin_[axis], box.min[axis]);
+                scene_max[axis] = std::max(scene_max[axis], box.max[axis]);
+                extents[number] = std::max(extents[number], box.max[axis] - box.min[axis]);
+            }
+        }
+
+        auto median = extents.begin() + static_cast<std::ptrdiff_t>(extents.size() / 2);
+        std::nth_element(extents.begin(), median, extents.end());
+        cell_size_ = *median;
+
+        T scene_extent = 0;
+        for (size_t axis = 0; axis < 3; ++axis)
+            scene_extent = std::max(scene_extent, scene_max[axis] - origin_[axis]);
+        cell_size_ = std::max(cell_size_, scene_extent / static_cast<T>(max_cells_per_axis - 1));
+        if (!(cell_size_ > 0))
+            cell_size_ = 1;
+
+        for (;;) {
+            size_t number_of_entries = 0;
+            for (const auto& box : boxes_)
+                number_of_entries += get_number_of_box_cells(box);
+
+            if (number_of_entries <= max_cells_per_primitive * boxes_.size())
+                break;
+            cell_size_ *= 2;
+        }
+    }
+
+    void fill_cells(Parallel::thread_pool_t* thread_pool) {
+        // Places of the first entries of primitives
+        std::vector<size_t> first_entries(boxes_.size() + 1, 0);
+        for (size_t number = 0; number < boxes_.size(); ++number)
+            first_entries[number + 1] = first_entries[number] + get_number_of_box_cells(boxes_[number]);
+
+        entries_.resize(first_entries.back());
+
+        auto fill = [&](size_t begin, size_t end) {
+            for (size_t number = begin; number < end; ++number) {
+                const auto& box = boxes_[number];
+                std::array<int64_t, 3> min_cell, max_cell;
+                for (size_t axis = 0; axis < 3; ++axis) {
+                    min_cell[axis] = get_cell(box.min[axis], axis);
+                    max_cell[axis] = get_cell(box.max[axis], axis);
+                }
+
+                size_t entry = first_entries[number];
+                for (int64_t x = min_cell[0]; x <= max_cell[0]; ++x) {
+                    for (int64_t y = min_cell[1]; y <= max_cell[1]; ++y) {
+                        for (int64_t z = min_cell[2]; z <= max_cell[2]; ++z) {
+                            uint64_t key = (static_cast<uint64_t>(x) << (2 * bits_per_axis)) |
+                                           (static_cast<uint64_t>(y) << bits_per_axis) | static_cast<uint64_t>(z);
+                            entries_[entry++] = {key, static_cast<index_t<T>>(number)};
+                        }
+                    }
+                }
+            }
+        };
+
+        if (thread_pool != nullptr)
+            thread_pool->parallel_for(0, boxes_.size(), parallel_build_size, fill);
+        else
+            fill(0, boxes_.size());
+
+        std::sort(entries_.begin(), entries_.end(), [](const auto& first, const auto& second) {
+            return first.cell != second.cell ? first.cell < second.cell : first.index < second.index;
+        });
+
+        cell_starts_.clear();
+        for (size_t entry = 0; entry < entries_.size(); ++entry) {
+            if (entry == 0 || entries_[entry].cell != entries_[entry - 1].cell)
+                cell_starts_.push_back(entry);
+        }
+        cell_starts_.push_back(entries_.size());
+    }
+};
+
+} // namespace Broad_phase
+
+#endif // HASH_GRID_HPP
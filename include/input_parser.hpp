@@ -0,0 +1,210 @@
+#ifndef INPUT_PARSER_HPP
+#define INPUT_PARSER_HPP
+
+#include <charconv>
+#include <string_view>
+#include <system_error>
+#include <stdexcept>
+#include <vector>
+#include <string>
+#include <iostream>
+#include <cerrno>
+#include <cstring>
+#include <cmath>
+#include <type_traits>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace Input {
+
+const size_t points_in_triangle       = 3;
+const size_t coordinates_in_point     = 3;
+const size_t coordinates_per_triangle = points_in_triangle * coordinates_in_point;
+
+// A digit and a space for every coordinate: no text triangle is shorter
+const size_t min_text_triangle_size   = coordinates_per_triangle * 2;
+
+// Whole input in one piece of memory: a regular file is mapped,
+// a pipe is read in large blocks
+class input_buffer_t {
+    public:
+    static constexpr size_t block_size = 1 << 20;
+
+    private:
+    const char*       data_    = nullptr;
+    size_t            size_    = 0;
+    void*             mapping_ = nullptr;
+    std::vector<char> storage_;
+
+    public:
+    // Reads stdin
+    input_buffer_t() {
+        if (!map_descriptor(STDIN_FILENO))
+            read_descriptor(STDIN_FILENO);
+    }
+
+    explicit input_buffer_t(const std::string& path) {
+        int descriptor = open(path.c_str(), O_RDONLY);
+        if (descriptor < 0)
+            throw std::runtime_error("can't open " + path + ": " + std::strerror(errno));
+
+        if (!map_descriptor(descriptor))
+            read_descriptor(descriptor);
+
+        close(descriptor);
+    }
+
+    input_buffer_t(const input_buffer_t& other) = delete;
+    input_buffer_t& operator=(const input_buffer_t& other) = delete;
+
+    ~input_buffer_t() {
+        if (mapping_ != nullptr)
+            munmap(mapping_, size_);
+    }
+
+    std::string_view view() const { return {data_, size_}; }
+    const char*      data() const { return data_; }
+    size_t           size() const { return size_; }
+
+    private:
+    bool map_descriptor(int descriptor) {
+        struct stat file_stat{};
+        if (fstat(descriptor, &file_stat) != 0 || !S_ISREG(file_stat.st_mode) || file_stat.st_size == 0)
+            return false;
+
+        // Stdin may be redirected from the middle of a file
+        off_t offset = lseek(descriptor, 0, SEEK_CUR);
+        if (offset != 0)
+            return false;
+
+        size_t file_size = static_cast<size_t>(file_stat.st_size);
+        void* mapping = mmap(nullptr, file_size, PROT_READ, MAP_PRIVATE, descriptor, 0);
+        if (mapping == MAP_FAILED)
+            return false;
+
+        madvise(mapping, file_size, MADV_SEQUENTIAL);
+
+        mapping_ = mapping;
+        data_    = static_cast<const char*>(mapping);
+        size_    = file_size;
+        return true;
+    }
+
+    void read_descriptor(int descriptor) {
+        size_t used = 0;
+        while (true) {
+            storage_.resize(used + block_size);
+
+            ssize_t bytes_read = read(descriptor, storage_.data() + used, block_size);
+            if (bytes_read < 0) {
+                if (errno == EINTR)
+                    continue;
+                throw std::runtime_error(std::string{"read error: "} + std::strerror(errno));
+            }
+
+            if (bytes_read == 0)
+                break;
+
+            used += static_cast<size_t>(bytes_read);
+        }
+
+        storage_.resize(used);
+        data_ = storage_.data();
+        size_ = used;
+    }
+};
+
+// Whitespace separated numbers, parsed with std::from_chars straight from the buffer
+template <typename T>
+class text_parser_t {
+    private:
+    const char* current_;
+    const char* end_;
+
+    public:
+    explicit text_parser_t(std::string_view text): current_{text.data()}, end_{text.data() + text.size()} {}
+
+    template <typename NumberT>
+    bool read_number(NumberT& number) {
+        skip_spaces();
+
+        // std::from_chars doesn't accept an explicit plus, std::cin does
+        if (current_ != end_ && *current_ == '+')
+            ++current_;
+
+        auto [next, error] = std::from_chars(current_, end_, number);
+        if (error != std::errc{} || next == current_)
+            return false;
+
+        // std::from_chars also reads "inf" and "nan", std::cin doesn't; they are no coordinates
+        if constexpr (std::is_floating_point_v<NumberT>) {
+            if (!std::isfinite(number))
+                return false;
+        }
+
+        current_ = next;
+
+        // A number glued to garbage like "12abc" is a broken input
+        return current_ == end_ || is_space(*current_);
+    }
+
+    // Writes x, y, z of one point to coordinates[0..2]
+    bool read_point(T* coordinates) {
+        return read_number(coordinates[0]) &&
+               read_number(coordinates[1]) &&
+               read_number(coordinates[2]);
+    }
+
+    private:
+    static bool is_space(char symbol) {
+        return symbol == ' '  || symbol == '\n' || symbol == '\t' ||
+               symbol == '\r' || symbol == '\v' || symbol == '\f';
+    }
+
+    void skip_spaces() {
+        while (current_ != end_ && is_space(*current_))
+            ++current_;
+    }
+};
+
+// Text input: the number of triangles and x, y, z of their points. Errors are printed to stderr.
+inline bool read_text_input(std::string_view input, std::vector<double>& coordinates) {
+    text_parser_t<double> parser{input};
+
+    size_t number_of_polygons = 0;
+
+    if (!parser.read_number(number_of_polygons)) {
+        std::cerr << "Error input" << std::endl;
+        return false;
+    }
+
+    // A count the input can't hold is broken, it must not size the coordinates
+    if (number_of_polygons > input.size() / min_text_triangle_size) {
+        std::cerr << "Error input: " << number_of_polygons << " triangles don't fit in the input" << std::endl;
+        return false;
+    }
+
+    // x, y, z of all three points of every triangle one after another
+    coordinates.resize(number_of_polygons * coordinates_per_triangle);
+
+    for (size_t polygon_counter = 0; polygon_counter < number_of_polygons; ++polygon_counter) {
+        double* triangle_coordinates = coordinates.data() + polygon_counter * coordinates_per_triangle;
+
+        for (size_t point_counter = 0; point_counter < points_in_triangle; ++point_counter) {
+            if (!parser.read_point(triangle_coordinates + point_counter * coordinates_in_point)) {
+                std::cerr << "Error reading point " << point_counter + 1 
+                          << " for triangle " << polygon_counter << std::endl;
+                return false;
+            }
+        }
+    }
+
+    return true;
+}
+
+} // namespace Input
+
+#endif // INPUT_PARSER_HPP
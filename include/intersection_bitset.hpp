@@ -0,0 +1,122 @@
+#ifndef INTERSECTION_BITSET_HPP
+#define INTERSECTION_BITSET_HPP
+
+#include <vector>
+#include <atomic>
+#include <bit>
+#include <cstdint>
+#include <utility>
+
+namespace Geom_objects {
+
+// Detectors report intersecting pairs to a result with two operations:
+//   insert_pair(first, second) - numbers of two intersecting primitives in the input, every pair once;
+//   is_found(number)           - a pair of two primitives with is_found true may be skipped.
+// Both are called from several workers at once by the parallel queries.
+
+// Numbers of intersecting primitives: one bit per primitive of the scene instead of a tree
+// node per number. Workers of a pool mark bits of the same set, so every detector sees what
+// the others have found and may skip pairs of two primitives already known to intersect.
+class intersection_bitset_t {
+    public:
+    static constexpr size_t bits_in_word = 64;
+
+    private:
+    std::vector<std::atomic<uint64_t>> words_;
+    size_t number_of_primitives_ = 0;
+
+    public:
+    intersection_bitset_t() = default;
+
+    explicit intersection_bitset_t(size_t number_of_primitives):
+        words_((number_of_primitives + bits_in_word - 1) / bits_in_word),
+        number_of_primitives_{number_of_primitives} {}
+
+    size_t get_number_of_primitives() const { return number_of_primitives_; }
+
+    bool contains(size_t number) const {
+        return (words_[number / bits_in_word].load(std::memory_order_relaxed) >> (number % bits_in_word)) & 1u;
+    }
+
+    // May be called by several threads at once
+    void insert(size_t number) {
+        uint64_t bit = uint64_t{1} << (number % bits_in_word);
+        auto& word = words_[number / bits_in_word];
+        // A primitive usually intersects many others, so the bit is mostly set already
+        if (!(word.load(std::memory_order_relaxed) & bit))
+            word.fetch_or(bit, std::memory_order_relaxed);
+    }
+
+    void insert_pair(size_t first, size_t second) {
+        insert(first);
+        insert(second);
+    }
+
+    // Once a primitive is known to intersect something, the set doesn't need its other pairs
+    bool is_found(size_t number) const { return contains(number); }
+
+    void clear() {
+        for (auto& word : words_)
+            word.store(0, std::memory_order_relaxed);
+    }
+
+    // Number of marked primitives
+    size_t size() const {
+        size_t number_of_marked = 0;
+        for (const auto& word : words_)
+            number_of_marked += static_cast<size_t>(std::popcount(word.load(std::memory_order_relaxed)));
+        return number_of_marked;
+    }
+
+    bool empty() const { return size() == 0; }
+
+    // Calls function(number) for marked numbers in ascending order
+    template <typename Function>
+    void for_each(Function&& function) const {
+        for (size_t word_number = 0; word_number < words_.size(); ++word_number) {
+            uint64_t word = words_[word_number].load(std::memory_order_relaxed);
+            while (word != 0) {
+                function(word_number * bits_in_word + static_cast<size_t>(std::countr_zero(word)));
+                word &= word - 1;
+            }
+        }
+    }
+
+    std::vector<size_t> get_numbers() const {
+        std::vector<size_t> numbers;
+        for_each([&numbers](size_t number) { numbers.push_back(number); });
+        return numbers;
+    }
+
+    bool operator==(const intersection_bitset_t& other) const {
+        if (number_of_primitives_ != other.number_of_primitives_)
+            return false;
+
+        for (size_t word_number = 0; word_number < words_.size(); ++word_number) {
+            if (words_[word_number].load(std::memory_order_relaxed) !=
+                other.words_[word_number].load(std::memory_order_relaxed))
+                return false;
+        }
+
+        return true;
+    }
+};
+
+// Every intersecting pair goes to function(first, second), nothing is skipped and nothing
+// is stored. In parallel queries function is called by workers of the pool at once.
+template <typename Function>
+class pair_callback_t {
+    private:
+    Function function_;
+
+    public:
+    explicit pair_callback_t(Function function): function_{std::move(function)} {}
+
+    void insert_pair(size_t first, size_t second) { function_(first, second); }
+
+    bool is_found(size_t) const { return false; }
+};
+
+} // namespace Geom_objects
+
+#endif // INTERSECTION_BITSET_HPP
@@ -0,0 +1,397 @@
+#ifndef LINEAR_OCTREE_HPP
+#define LINEAR_OCTREE_HPP
+
+#include <vector>
+#include <span>
+#include <utility>
+#include <tuple>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <bit>
+
+#include "octree.hpp"
+
+namespace Octree {
+
+// 16 bytes instead of a pointer node: children of a node lie next to each other
+// starting from first_child, in order of bits of children_mask
+struct linear_node_t {
+    uint32_t first_child    = 0;
+    uint32_t polygons_begin = 0; // range in the shared index array
+    uint32_t polygons_end   = 0;
+    uint8_t  children_mask  = 0;
+};
+
+template <typename T>
+class linear_octree_t;
+
+template <typename T>
+class linear_detector_of_collisions_t {
+    private:
+    // The same scratch buffers as in detector_of_collisions_t
+    Geom_objects::polygon_batch_t<T> node_polygons_;
+    Geom_objects::polygon_batch_t<T> child_polygons_;
+    std::vector<std::vector<size_t>> active_polygons_;
+    std::vector<std::vector<uint8_t>> touched_octants_;
+
+    std::vector<std::tuple<uint32_t, size_t, size_t>> children_stack_;
+
+    T looseness_ = 1;
+
+    public:
+    explicit linear_detector_of_collisions_t(T looseness = 1): looseness_{looseness} {}
+
+    T get_looseness() const { return looseness_; }
+
+    size_t get_number_of_pairs() const {
+        return node_polygons_.get_number_of_pairs() + child_polygons_.get_number_of_pairs();
+    }
+
+    size_t get_number_of_rejected() const {
+        return node_polygons_.get_number_of_rejected() + child_polygons_.get_number_of_rejected();
+    }
+
+    // Nodes are in breadth-first order, so the tree is walked by a plain loop
+    template <typename Result>
+    void intersect_polygons_inside_tree(const linear_octree_t<T>& tree, Result& result) {
+        for (size_t node = 0; node < tree.get_number_of_nodes(); ++node)
+            intersect_node_polygons(tree, node, 0, tree.get_node_polygons(node).size(), result);
+    }
+
+    // Polygons [begin, end) of the node against the polygons after them in the node
+    // and against all descendants. Tests the same pairs as detector_of_collisions_t.
+    template <typename Result>
+    void intersect_node_polygons(const linear_octree_t<T>& tree, size_t node, size_t begin, size_t end,
+                                 Result& result) {
+        const auto& store = tree.get_store();
+        auto polygons = tree.get_node_polygons(node);
+
+        node_polygons_.clear();
+        for (size_t number = begin; number < polygons.size(); ++number)
+            node_polygons_.push_back(store.get_polygon(polygons[number]), store.get_box(polygons[number]));
+
+        for (size_t number_1 = begin; number_1 < end; ++number_1) {
+            bool polygon_is_found = result.is_found(store.get_number(polygons[number_1]));
+            node_polygons_.intersect(node_polygons_[number_1 - begin], number_1 - begin + 1, [&](size_t number_2) {
+                result.insert_pair(store.get_number(polygons[number_1]),
+                                   store.get_number(polygons[number_2 + begin]));
+            }, [&](size_t number_2) {
+                return polygon_is_found && result.is_found(store.get_number(polygons[number_2 + begin]));
+            });
+        }
+
+        intersect_polygons_with_children(tree, node, begin, end, result);
+        intersect_polygons_with_cousins(tree, node, begin, end, result);
+    }
+
+    private:
+    template <typename Result>
+    void intersect_polygons_with_children(const linear_octree_t<T>& tree, size_t node, size_t begin, size_t end,
+                                          Result& result) {
+        if (tree.get_node(node).children_mask == 0 || begin == end)
+            return;
+
+        find_all_octants(tree, node, tree.get_box(node), begin, end);
+
+        children_stack_.clear();
+        push_children(tree, node, 1);
+        intersect_polygons_with_stacked(tree, node, begin, result);
+    }
+
+    // Subtrees of siblings of the node and of its ancestors, as in detector_of_collisions_t
+    template <typename Result>
+    void intersect_polygons_with_cousins(const linear_octree_t<T>& tree, size_t node, size_t begin, size_t end,
+                                         Result& result) {
+        if (looseness_ == 1 || begin == end)
+            return;
+
+        const auto& store = tree.get_store();
+        auto polygons = tree.get_node_polygons(node);
+
+        auto polygons_box = store.get_box(polygons[begin]);
+        for (size_t number = begin + 1; number < end; ++number)
+            polygons_box = Geom_objects::merge_boxes(polygons_box, store.get_box(polygons[number]));
+
+        for (size_t current = node; current != 0; current = tree.get_parent(current)) {
+            size_t parent = tree.get_parent(current);
+            const linear_node_t& data = tree.get_node(parent);
+
+            children_stack_.clear();
+            uint32_t child = data.first_child;
+            for (unsigned mask = data.children_mask; mask != 0; mask &= mask - 1, ++child) {
+                if (child > current && tree.get_box(child).is_part_inside_box(polygons_box))
+                    children_stack_.emplace_back(child, 1, static_cast<size_t>(std::countr_zero(mask)));
+            }
+
+            if (children_stack_.empty())
+                continue;
+
+            find_all_octants(tree, node, tree.get_box(parent), begin, end);
+            intersect_polygons_with_stacked(tree, node, begin, result);
+        }
+    }
+
+    auto get_prepared(const linear_octree_t<T>& tree, size_t node, size_t begin) const {
+        return [&store = tree.get_store(), polygons = tree.get_node_polygons(node), begin](size_t number)
+                   -> const auto& { return store.get_prepared_triangle(polygons[begin + number]); };
+    }
+
+    void find_all_octants(const linear_octree_t<T>& tree, size_t node, const Geom_objects::AABB_t<T>& box,
+                          size_t begin, size_t end) {
+        if (active_polygons_.empty()) {
+            active_polygons_.emplace_back();
+            touched_octants_.emplace_back();
+        }
+
+        auto& all_polygons = active_polygons_[0];
+        all_polygons.clear();
+        for (size_t number = 0; number < end - begin; ++number)
+            all_polygons.push_back(number);
+
+        node_polygons_.find_octants(box, looseness_, all_polygons, touched_octants_[0],
+                                    get_prepared(tree, node, begin));
+    }
+
+    template <typename Result>
+    void intersect_polygons_with_stacked(const linear_octree_t<T>& tree, size_t node, size_t begin,
+                                         Result& result) {
+        const auto& store = tree.get_store();
+        auto node_polygon_indices = tree.get_node_polygons(node);
+
+        while (!children_stack_.empty()) {
+            auto [child, depth, octant] = children_stack_.back();
+            children_stack_.pop_back();
+
+            if (active_polygons_.size() <= depth) {
+                active_polygons_.resize(depth + 1);
+                touched_octants_.resize(depth + 1);
+            }
+
+            const auto& parent_polygons = active_polygons_[depth - 1];
+            const auto& parent_octants  = touched_octants_[depth - 1];
+            auto& child_active_polygons = active_polygons_[depth];
+            child_active_polygons.clear();
+
+            for (size_t number = 0; number < parent_polygons.size(); ++number) {
+                if (parent_octants[number] & (1u << octant))
+                    child_active_polygons.push_back(parent_polygons[number]);
+            }
+
+            if (child_active_polygons.empty())
+                continue;
+
+            auto child_polygons = tree.get_node_polygons(child);
+
+            child_polygons_.clear();
+            for (auto child_polygon : child_polygons)
+                child_polygons_.push_back(store.get_polygon(child_polygon), store.get_box(child_polygon));
+
+            for (size_t number : child_active_polygons) {
+                const auto& polygon = node_polygons_[number];
+                size_t polygon_number = store.get_number(node_polygon_indices[begin + number]);
+                bool polygon_is_found = result.is_found(polygon_number);
+
+                child_polygons_.intersect(polygon, 0, [&](size_t child_number) {
+                    result.insert_pair(polygon_number, store.get_number(child_polygons[child_number]));
+                }, [&](size_t child_number) {
+                    return polygon_is_found && result.is_found(store.get_number(child_polygons[child_number]));
+                });
+            }
+
+            if (tree.get_node(child).children_mask == 0)
+                continue;
+
+            node_polygons_.find_octants(tree.get_box(child), looseness_, child_active_polygons,
+                                        touched_octants_[depth], get_prepared(tree, node, begin));
+            push_children(tree, child, depth + 1);
+        }
+    }
+
+    // The octant of a child is the bit of children_mask it stands for
+    void push_children(const linear_octree_t<T>& tree, size_t node, size_t depth) {
+        const linear_node_t& data = tree.get_node(node);
+
+        uint32_t child = data.first_child;
+        for (unsigned mask = data.children_mask; mask != 0; mask &= mask - 1)
+            children_stack_.emplace_back(child++, depth, static_cast<size_t>(std::countr_zero(mask)));
+    }
+};
+
+// Pointer-free copy of an octree: nodes in one array in breadth-first order, boxes in
+// a parallel array, polygons of all nodes in one index array. Detection gives the same
+// result as octree_t.
+template <typename T>
+class linear_octree_t {
+    public:
+    // Big nodes are split into parts of this size for parallel detection
+    static constexpr size_t polygons_per_task = 64;
+    static constexpr size_t parts_per_task    = 8;
+
+    private:
+    std::vector<linear_node_t> nodes_;
+    std::vector<Geom_objects::AABB_t<T>> boxes_;
+    std::vector<uint32_t> parents_; // the root is its own parent
+    std::vector<index_t<T>> polygons_;
+    Geom_objects::primitive_store_t<T> store_;
+    linear_detector_of_collisions_t<T> detector_of_collisions_;
+
+    size_t number_of_pairs_          = 0;
+    size_t number_of_rejected_pairs_ = 0;
+
+    public:
+    // Copies primitives of the tree
+    explicit linear_octree_t(const octree_t<T>& octree):
+        store_{octree.get_store()}, detector_of_collisions_{octree.get_looseness()} {
+        flatten(octree.get_root());
+    }
+
+    // The pointer tree is built and dropped
+    template <typename S>
+    linear_octree_t(std::span<const S> coordinates, const Geom_objects::AABB_t<T>& bounding_box,
+                    size_t min_size = default_min_size):
+        linear_octree_t{coordinates, bounding_box, subdivision_parameters_t<T>{.min_size = min_size}} {}
+
+    template <typename S>
+    linear_octree_t(std::span<const S> coordinates, const Geom_objects::AABB_t<T>& bounding_box,
+                    const subdivision_parameters_t<T>& parameters):
+        detector_of_collisions_{parameters.looseness} {
+        octree_t<T> octree{coordinates, bounding_box, parameters};
+        flatten(octree.get_root());
+        store_ = octree.take_store();
+    }
+
+    template <typename S>
+    linear_octree_t(std::span<const S> coordinates, const Geom_objects::AABB_t<T>& bounding_box,
+                    Parallel::thread_pool_t& thread_pool, size_t min_size = default_min_size):
+        linear_octree_t{coordinates, bounding_box, subdivision_parameters_t<T>{.min_size = min_size}, thread_pool} {}
+
+    template <typename S>
+    linear_octree_t(std::span<const S> coordinates, const Geom_objects::AABB_t<T>& bounding_box,
+                    const subdivision_parameters_t<T>& parameters, Parallel::thread_pool_t& thread_pool):
+        detector_of_collisions_{parameters.looseness} {
+        octree_t<T> octree{coordinates, bounding_box, parameters, thread_pool};
+        flatten(octree.get_root());
+        store_ = octree.take_store();
+    }
+
+    size_t                                    get_number_of_nodes()   const { return nodes_.size(); }
+    const linear_node_t&                      get_node(size_t node)   const { return nodes_[node]; }
+    const Geom_objects::AABB_t<T>&            get_box(size_t node)    const { return boxes_[node]; }
+    size_t                                    get_parent(size_t node) const { return parents_[node]; }
+    const Geom_objects::primitive_store_t<T>& get_store()             const { return store_; }
+
+    std::span<const index_t<T>> get_node_polygons(size_t node) const {
+        return {polygons_.data() + nodes_[node].polygons_begin, polygons_.data() + nodes_[node].polygons_end};
+    }
+
+    // Polygons of nodes with children, as octree_t::get_number_of_straddlers
+    size_t get_number_of_straddlers() const {
+        size_t number_of_straddlers = 0;
+        for (size_t node = 0; node < nodes_.size(); ++node) {
+            if (nodes_[node].children_mask != 0)
+                number_of_straddlers += get_node_polygons(node).size();
+        }
+
+        return number_of_straddlers;
+    }
+
+    size_t get_allocated_bytes() const {
+        return nodes_.capacity() * sizeof(linear_node_t) + boxes_.capacity() * sizeof(Geom_objects::AABB_t<T>) +
+               parents_.capacity() * sizeof(uint32_t) + polygons_.capacity() * sizeof(index_t<T>);
+    }
+
+    // Result is a Geom_objects::intersection_bitset_t with a bit for every primitive of the tree
+    // or a Geom_objects::pair_callback_t
+    template <typename Result>
+    void get_number_of_intersections(Result& result) {
+        size_t pairs_before    = detector_of_collisions_.get_number_of_pairs();
+        size_t rejected_before = detector_of_collisions_.get_number_of_rejected();
+        detector_of_collisions_.intersect_polygons_inside_tree(*this, result);
+        number_of_pairs_          = detector_of_collisions_.get_number_of_pairs() - pairs_before;
+        number_of_rejected_pairs_ = detector_of_collisions_.get_number_of_rejected() - rejected_before;
+    }
+
+    // Pairs tested by the last query and pairs of them rejected by boxes before the exact test
+    size_t get_number_of_pairs()          const { return number_of_pairs_; }
+    size_t get_number_of_rejected_pairs() const { return number_of_rejected_pairs_; }
+
+    // Parts of at most polygons_per_task polygons of every node are spread over the pool,
+    // each worker has its own detector, the result is shared
+    template <typename Result>
+    void get_number_of_intersections(Result& result, Parallel::thread_pool_t& thread_pool) {
+        struct part_t {
+            size_t node, begin, end;
+        };
+
+        std::vector<part_t> parts;
+        for (size_t node = 0; node < nodes_.size(); ++node) {
+            size_t number_of_polygons = get_node_polygons(node).size();
+            for (size_t begin = 0; begin < number_of_polygons; begin += polygons_per_task)
+                parts.push_back({node, begin, std::min(number_of_polygons, begin + polygons_per_task)});
+        }
+
+        std::vector<linear_detector_of_collisions_t<T>> detectors(thread_pool.get_number_of_threads(),
+                                                                  linear_detector_of_collisions_t<T>{
+                                                                      detector_of_collisions_.get_looseness()});
+
+        thread_pool.submit([&] {
+            thread_pool.parallel_for(0, parts.size(), parts_per_task, [&](size_t parts_begin, size_t parts_end) {
+                size_t worker = thread_pool.get_current_worker();
+                for (size_t part = parts_begin; part < parts_end; ++part)
+                    detectors[worker].intersect_node_polygons(*this, parts[part].node, parts[part].begin,
+                                                              parts[part].end, result);
+            });
+        });
+        thread_pool.wait();
+
+        number_of_pairs_ = number_of_rejected_pairs_ = 0;
+        for (const auto& detector : detectors) {
+            number_of_pairs_          += detector.get_number_of_pairs();
+            number_of_rejected_pairs_ += detector.get_number_of_rejected();
+        }
+    }
+
+    private:
+    void flatten(const octree_node_t<T>* root) {
+        if (root == nullptr)
+            return;
+
+        // Children of a node get consecutive places in breadth-first order
+        std::vector<const octree_node_t<T>*> order{root};
+        parents_.push_back(0);
+        for (size_t place = 0; place < order.size(); ++place) {
+            const octree_node_t<T>* node = order[place];
+
+            linear_node_t linear_node{};
+            linear_node.first_child = to_index(order.size());
+
+            for (size_t number_of_child = 0; number_of_child < number_of_children; ++number_of_child) {
+                if (!node->valid_children_[number_of_child])
+                    continue;
+
+                linear_node.children_mask |= static_cast<uint8_t>(1u << number_of_child);
+                order.push_back(node->children_[number_of_child]);
+                parents_.push_back(to_index(place));
+            }
+
+            linear_node.polygons_begin = to_index(polygons_.size());
+            polygons_.insert(polygons_.end(), node->polygons_in_space_.begin(), node->polygons_in_space_.end());
+            linear_node.polygons_end = to_index(polygons_.size());
+
+            nodes_.push_back(linear_node);
+            boxes_.push_back(node->bounding_box_);
+        }
+    }
+
+    static uint32_t to_index(size_t value) {
+        if (value > std::numeric_limits<uint32_t>::max())
+            throw std::length_error("linear octree is too big for 32-bit offsets");
+
+        return static_cast<uint32_t>(value);
+    }
+};
+
+} // namespace Octree
+
+#endif // LINEAR_OCTREE_HPP
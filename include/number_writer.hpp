@@ -0,0 +1,70 @@
+#ifndef NUMBER_WRITER_HPP
+#define NUMBER_WRITER_HPP
+
+#include <vector>
+#include <ostream>
+#include <charconv>
+#include <cstring>
+#include <cstdint>
+
+namespace Output {
+
+enum class number_format_t {
+    text,  // a number per line
+    binary // uint32_t per number, native (little-endian) byte order, no header
+};
+
+// Numbers are formatted with std::to_chars into one big block, and a full block is
+// a single write to the stream instead of a flush per line as with std::endl
+class number_writer_t {
+    public:
+    static constexpr size_t block_size      = size_t{1} << 16;
+    static constexpr size_t max_record_size = 20 + 1; // a number and a new line
+
+    private:
+    std::ostream& output_;
+    number_format_t format_;
+    std::vector<char> block_;
+    size_t size_ = 0;
+
+    public:
+    number_writer_t(std::ostream& output, number_format_t format):
+        output_{output}, format_{format}, block_(block_size) {}
+
+    number_writer_t(const number_writer_t&) = delete;
+    number_writer_t& operator=(const number_writer_t&) = delete;
+
+    ~number_writer_t() { flush(); }
+
+    void write(size_t number) {
+        if (block_size - size_ < max_record_size)
+            write_block();
+
+        char* record = block_.data() + size_;
+        if (format_ == number_format_t::binary) {
+            uint32_t value = static_cast<uint32_t>(number);
+            std::memcpy(record, &value, sizeof(value));
+            size_ += sizeof(value);
+        } else {
+            record = std::to_chars(record, block_.data() + block_size, number).ptr;
+            *record++ = '\n';
+            size_ = static_cast<size_t>(record - block_.data());
+        }
+    }
+
+    // Errors are left in the state of the stream
+    void flush() {
+        write_block();
+        output_.flush();
+    }
+
+    private:
+    void write_block() {
+        output_.write(block_.data(), static_cast<std::streamsize>(size_));
+        size_ = 0;
+    }
+};
+
+} // namespace Output
+
+#endif // NUMBER_WRITER_HPP
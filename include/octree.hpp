@@ -2,26 +2,94 @@
 #define OCTREE_HPP
 
 #include <iterator>
+#include <algorithm>
 #include <vector>
 #include <list>
 #include <cassert>
 #include <stack>
+#include <queue>
+#include <memory>
+#include <memory_resource>
+#include <mutex>
+#include <new>
 #include <array>
+#include <utility>
+#include <tuple>
+#include <span>
+#include <cstdint>
+#include <functional>
 
 #include "bounding_box.hpp"
 #include "point.hpp"
 #include "triangle.hpp"
+#include "primitive_store.hpp"
+#include "thread_pool.hpp"
+#include "triangle_batch.hpp"
+#include "intersection_bitset.hpp"
 
 namespace Octree {
 
 const size_t number_of_children = 8;
 
+template <typename T>
+using index_t = typename Geom_objects::primitive_store_t<T>::index_t;
+
+// What subdivider_t knows about a node when it decides whether to split it
+template <typename T>
+struct split_candidate_t {
+    size_t number_of_polygons   = 0; // in the node
+    size_t number_of_straddlers = 0; // would stay in the node, inside none of the children
+    std::array<size_t, number_of_children> polygons_in_children{};
+    size_t depth    = 0;
+    T      box_size = 0; // the longest edge of the node box
+};
+
+// Whether a node is split into the children of the candidate. Depends only on the candidate:
+// the parallel build asks for sibling nodes from different threads.
+template <typename T>
+using split_policy_t = std::function<bool(const split_candidate_t<T>&)>;
+
+inline constexpr size_t default_min_size = 32;
+
+// Shape of the tree built by subdivider_t
+template <typename T>
+struct subdivision_parameters_t {
+    size_t min_size       = default_min_size; // nodes with fewer polygons are not split
+    size_t max_depth      = 24;  // nodes this deep are not split
+    T      max_straddling = 1;   // nodes are not split if a bigger fraction of polygons would stay in them
+    T      node_cost      = 128; // of a child in tested pairs, for the cost model of make_cost_split_policy
+    T      looseness      = 1;   // boxes of nodes are their octants enlarged this many times, 1 for a plain octree
+    split_policy_t<T> split_policy = {}; // decides within the limits above, the cost model if empty
+};
+
+// A split is worth it if it saves pair tests. Polygons of a leaf are tested pairwise; after the split
+// straddlers are tested with each other and with the polygons of children, polygons of a child
+// with each other, and every child costs node_cost more for its visits and octant tests.
+template <typename T>
+split_policy_t<T> make_cost_split_policy(T node_cost) {
+    return [node_cost](const split_candidate_t<T>& candidate) {
+        auto get_pairs = [](double number) { return number * (number - 1) / 2; };
+
+        double number_of_polygons   = static_cast<double>(candidate.number_of_polygons);
+        double number_of_straddlers = static_cast<double>(candidate.number_of_straddlers);
+
+        double split_cost = get_pairs(number_of_straddlers) +
+                            number_of_straddlers * (number_of_polygons - number_of_straddlers);
+        for (size_t polygons_in_child : candidate.polygons_in_children) {
+            if (polygons_in_child != 0)
+                split_cost += get_pairs(static_cast<double>(polygons_in_child)) + static_cast<double>(node_cost);
+        }
+
+        return split_cost < get_pairs(number_of_polygons);
+    };
+}
+
 template <typename T>
 class octree_node_t {
     public:
     Geom_objects::AABB_t<T> bounding_box_; 
     size_t depth = 0; 
-    std::vector<Geom_objects::polygon_t<T>> polygons_in_space_;
+    std::pmr::vector<index_t<T>> polygons_in_space_; // indices in primitive store of the tree
     const octree_node_t<T>* parent_;
     std::array<octree_node_t<T>*, number_of_children> children_ = {nullptr, nullptr, nullptr, nullptr, 
                                                                    nullptr, nullptr, nullptr, nullptr};
@@ -30,193 +98,563 @@ class octree_node_t {
     bool is_leaf_ = true;
 
     public:
-    octree_node_t(const Geom_objects::AABB_t<T>& bounding_box, const octree_node_t<T>* parent_node):
-    bounding_box_{bounding_box}, parent_{parent_node} {};
+    octree_node_t(const Geom_objects::AABB_t<T>& bounding_box, const octree_node_t<T>* parent_node,
+                  std::pmr::polymorphic_allocator<index_t<T>> allocator):
+    bounding_box_{bounding_box}, depth{parent_node == nullptr ? 0 : parent_node->depth + 1},
+    polygons_in_space_{allocator}, parent_{parent_node} {};
+};
+
+// Bump allocation from big blocks, everything is freed at once. The mutex is for the
+// parallel build, allocations happen once per split, not per polygon.
+class arena_resource_t : public std::pmr::memory_resource {
+    public:
+    static constexpr size_t initial_block_size = 1 << 16;
+
+    private:
+    std::mutex mutex_;
+    std::pmr::monotonic_buffer_resource resource_{initial_block_size};
+    size_t allocated_bytes_ = 0;
+
+    public:
+    size_t get_allocated_bytes() const { return allocated_bytes_; }
+
+    void release() {
+        std::lock_guard lock{mutex_};
+        resource_.release();
+        allocated_bytes_ = 0;
+    }
+
+    private:
+    void* do_allocate(size_t bytes, size_t alignment) override {
+        std::lock_guard lock{mutex_};
+        allocated_bytes_ += bytes;
+        return resource_.allocate(bytes, alignment);
+    }
+
+    void do_deallocate(void*, size_t, size_t) override {}
+
+    bool do_is_equal(const std::pmr::memory_resource& other) const noexcept override {
+        return this == &other;
+    }
 };
 
+// Nodes and their polygon lists live in two arenas, so nodes lie next to each other:
+// children of a node are allocated as one block, and the serial build splits nodes
+// in breadth-first order. Destructors of nodes are never called, the tree is freed
+// with the arenas.
 template <typename T>
 class memory_manager_t {
+    private:
+    std::unique_ptr<arena_resource_t> nodes_arena_     = std::make_unique<arena_resource_t>();
+    std::unique_ptr<arena_resource_t> polygons_arena_  = std::make_unique<arena_resource_t>();
+
     public:
     octree_node_t<T>* make_node(const Geom_objects::AABB_t<T>& bounding_box, const octree_node_t<T>* parent) {
-        return new octree_node_t<T>{bounding_box, parent};
+        void* memory = nodes_arena_->allocate(sizeof(octree_node_t<T>), alignof(octree_node_t<T>));
+        return new (memory) octree_node_t<T>{bounding_box, parent, get_polygons_allocator()};
+    }
+
+    // One block for the children that get polygons, the others stay nullptr.
+    // Lists of polygons are reserved for numbers_of_polygons.
+    void make_children(octree_node_t<T>* parent, 
+                       const std::array<Geom_objects::AABB_t<T>, number_of_children>& children_boxes,
+                       const std::array<size_t, number_of_children>& numbers_of_polygons) {
+        size_t number_of_new_nodes = 0;
+        for (size_t number_of_polygons : numbers_of_polygons)
+            number_of_new_nodes += (number_of_polygons != 0);
+
+        if (number_of_new_nodes == 0)
+            return;
+
+        void* memory = nodes_arena_->allocate(number_of_new_nodes * sizeof(octree_node_t<T>), 
+                                              alignof(octree_node_t<T>));
+        octree_node_t<T>* node = static_cast<octree_node_t<T>*>(memory);
+
+        for (size_t number_of_child = 0; number_of_child < number_of_children; ++number_of_child) {
+            if (numbers_of_polygons[number_of_child] == 0)
+                continue;
+
+            new (node) octree_node_t<T>{children_boxes[number_of_child], parent, get_polygons_allocator()};
+            node->polygons_in_space_.reserve(numbers_of_polygons[number_of_child]);
+            parent->children_[number_of_child] = node;
+            ++node;
+        }
+    }
+
+    std::pmr::polymorphic_allocator<index_t<T>> get_polygons_allocator() const {
+        return std::pmr::polymorphic_allocator<index_t<T>>{polygons_arena_.get()};
     }
 
     void delete_tree(octree_node_t<T>* root) {
         if (root == nullptr) 
             return;
 
-        // Used a stack to avoid recursion
-        std::stack<octree_node_t<T>*> node_stack;
-        node_stack.push(root);
+        nodes_arena_->release();
+        polygons_arena_->release();
+    }
 
-        while (!node_stack.empty()) {
-            auto node = node_stack.top();
-            node_stack.pop();
+    size_t get_number_of_nodes() const {
+        return nodes_arena_->get_allocated_bytes() / sizeof(octree_node_t<T>);
+    }
 
-            for (size_t number_of_child = 0; number_of_child < number_of_children; ++number_of_child) {
-                if (node->children_[number_of_child] != nullptr) {
-                    node_stack.push(node->children_[number_of_child]);
-                }
-            }
-            delete node;
-        }
+    size_t get_allocated_bytes() const {
+        return nodes_arena_->get_allocated_bytes() + polygons_arena_->get_allocated_bytes();
     }
 };
 
+// Intersecting pairs go to a result: Geom_objects::intersection_bitset_t for numbers of
+// intersecting primitives, Geom_objects::pair_callback_t for every pair, see intersection_bitset.hpp
 template <typename T> 
 class detector_of_collisions_t {
+    private:
+    // Scratch buffers are kept between calls, so after the first query traversal
+    // and narrow phase don't allocate
+
+    // Polygons of the current node starting from the first tested one,
+    // rebuilt from the store once, not for every pair
+    Geom_objects::polygon_batch_t<T> node_polygons_;
+    // Polygons of the visited descendant
+    Geom_objects::polygon_batch_t<T> child_polygons_;
+    // For every depth below the current node: which of node_polygons_ touch the box of the visited descendant,
+    // and which octants of that box each of them touches
+    std::vector<std::vector<size_t>> active_polygons_;
+    std::vector<std::vector<uint8_t>> touched_octants_;
+
+    std::vector<octree_node_t<T>*> node_stack_;
+    // A child, its depth and its octant in the parent
+    std::vector<std::tuple<const octree_node_t<T>*, size_t, size_t>> children_stack_;
+
+    // Of the tree, children boxes are the octants of a box enlarged this many times
+    T looseness_ = 1;
+
     public:
-    void intersect_polygons_with_children(std::set<size_t>& result, const Geom_objects::polygon_t<T>& polygone, 
-                                          const octree_node_t<T>* current_node) {
-        if (current_node == nullptr)
+    explicit detector_of_collisions_t(T looseness = 1): looseness_{looseness} {}
+
+    // Pairs given to the narrow phase and pairs of them rejected by boxes, over the lifetime of the detector
+    size_t get_number_of_pairs() const {
+        return node_polygons_.get_number_of_pairs() + child_polygons_.get_number_of_pairs();
+    }
+
+    size_t get_number_of_rejected() const {
+        return node_polygons_.get_number_of_rejected() + child_polygons_.get_number_of_rejected();
+    }
+
+    // Tests polygons [begin, end) of current_node (already in node_polygons_) against polygons 
+    // of all its descendants. A polygon goes down only into children whose boxes it touches.
+    template <typename Result>
+    void intersect_polygons_with_children(Result& result, const octree_node_t<T>* current_node,
+                                          size_t begin, size_t end,
+                                          const Geom_objects::primitive_store_t<T>& store) {
+        if (current_node == nullptr || current_node->is_leaf_ || begin == end)
             return;
 
-        // Used a stack to avoid recursion
-        std::stack<const octree_node_t<T>*> node_stack;
-        node_stack.push(current_node);
+        // Octants a polygon touches are found once per node, for all children at once
+        find_all_octants(current_node, current_node->bounding_box_, begin, end, store);
 
-        while (!node_stack.empty()) {
-            const octree_node_t<T>* node = node_stack.top();
-            node_stack.pop();
+        // Used a stack to avoid recursion, depth of a child is counted from current_node
+        children_stack_.clear();
+        push_children(current_node, 1);
+        intersect_polygons_with_stacked(result, current_node, begin, store);
+    }
 
-            if (node->is_leaf_)
-                continue;
+    // In a loose tree boxes of siblings overlap, so polygons [begin, end) of current_node may also
+    // intersect polygons in subtrees of siblings of current_node and of its ancestors. A pair of
+    // such subtrees is visited once, from the one with the smaller octant.
+    template <typename Result>
+    void intersect_polygons_with_cousins(Result& result, const octree_node_t<T>* current_node,
+                                         size_t begin, size_t end,
+                                         const Geom_objects::primitive_store_t<T>& store) {
+        if (current_node == nullptr || looseness_ == 1 || begin == end)
+            return;
 
-            for (size_t number_of_child = 0; number_of_child < number_of_children; ++number_of_child) {
-                if (!node->valid_children_[number_of_child])
-                    continue;
-
-                const octree_node_t<T>* child = node->children_[number_of_child];
-                if (!child->bounding_box_.is_polygon_part_inside_box(polygone))
-                    continue;
-
-                auto child_polygons = child->polygons_in_space_;
-                for (auto child_polygon : child_polygons) {
-                    if (check_figures_intersection(polygone, child_polygon)) {
-                        result.insert(get_number(child_polygon));
-                        result.insert(get_number(polygone));
-                    }
-                }
+        // Most siblings of far ancestors are away from the polygons
+        auto polygons_box = store.get_box(current_node->polygons_in_space_[begin]);
+        for (size_t number = begin + 1; number < end; ++number)
+            polygons_box = Geom_objects::merge_boxes(polygons_box,
+                                                     store.get_box(current_node->polygons_in_space_[number]));
+
+        for (const octree_node_t<T>* node = current_node; node->parent_ != nullptr; node = node->parent_) {
+            const octree_node_t<T>* parent = node->parent_;
+
+            size_t octant = 0;
+            while (parent->children_[octant] != node)
+                ++octant;
 
-                node_stack.push(child);
+            children_stack_.clear();
+            for (size_t sibling = octant + 1; sibling < number_of_children; ++sibling) {
+                if (parent->valid_children_[sibling] &&
+                    parent->children_[sibling]->bounding_box_.is_part_inside_box(polygons_box))
+                    children_stack_.emplace_back(parent->children_[sibling], 1, sibling);
             }
+
+            if (children_stack_.empty())
+                continue;
+
+            find_all_octants(current_node, parent->bounding_box_, begin, end, store);
+            intersect_polygons_with_stacked(result, current_node, begin, store);
         }
     }
 
-    void intersect_polygons_inside_node(octree_node_t<T>* current_node, std::set<size_t>& result) {
+    template <typename Result>
+    void intersect_polygons_inside_node(octree_node_t<T>* current_node, Result& result,
+                                        const Geom_objects::primitive_store_t<T>& store) {
         if (current_node == nullptr) 
             return;
 
         // Used a stack to avoid recursion
-        std::stack<octree_node_t<T>*> node_stack;
-        node_stack.push(current_node);
-
-        while (!node_stack.empty()) {
-            octree_node_t<T>* node = node_stack.top();
-            node_stack.pop();
-
-            auto& polygons = node->polygons_in_space_;
-            for (auto iter_1 = polygons.begin(); iter_1 != polygons.end(); ++iter_1) {
-                for (auto iter_2 = std::next(iter_1); iter_2 != polygons.end(); ++iter_2) {
-                    if (check_figures_intersection(*iter_1, *iter_2)) {
-                        result.insert(get_number(*iter_1));
-                        result.insert(get_number(*iter_2));
-                    }
-                }
-                intersect_polygons_with_children(result, *iter_1, node);
-            }
+        node_stack_.clear();
+        node_stack_.push_back(current_node);
+
+        while (!node_stack_.empty()) {
+            octree_node_t<T>* node = node_stack_.back();
+            node_stack_.pop_back();
+
+            intersect_node_polygons(node, 0, node->polygons_in_space_.size(), result, store);
 
             for (size_t number_of_child = 0; number_of_child < number_of_children; ++number_of_child) {
                 if (node->valid_children_[number_of_child]) {
-                    node_stack.push(node->children_[number_of_child]);
+                    node_stack_.push_back(node->children_[number_of_child]);
                 }
             }
         }
     }
+
+    // Polygons [begin, end) of the node against the polygons after them in the node
+    // and against all descendants. Parts of one node may be processed independently.
+    template <typename Result>
+    void intersect_node_polygons(const octree_node_t<T>* node, size_t begin, size_t end, 
+                                 Result& result, const Geom_objects::primitive_store_t<T>& store) {
+        const auto& polygons = node->polygons_in_space_;
+
+        node_polygons_.clear();
+        for (size_t number = begin; number < polygons.size(); ++number)
+            node_polygons_.push_back(store.get_polygon(polygons[number]), store.get_box(polygons[number]));
+
+        // A pair of polygons both already found intersecting something adds nothing to the result
+        for (size_t number_1 = begin; number_1 < end; ++number_1) {
+            bool polygon_is_found = result.is_found(store.get_number(polygons[number_1]));
+            node_polygons_.intersect(node_polygons_[number_1 - begin], number_1 - begin + 1, [&](size_t number_2) {
+                result.insert_pair(store.get_number(polygons[number_1]),
+                                   store.get_number(polygons[number_2 + begin]));
+            }, [&](size_t number_2) {
+                return polygon_is_found && result.is_found(store.get_number(polygons[number_2 + begin]));
+            });
+        }
+
+        intersect_polygons_with_children(result, node, begin, end, store);
+        intersect_polygons_with_cousins(result, node, begin, end, store);
+    }
+
+    private:
+    auto get_prepared(const octree_node_t<T>* current_node, size_t begin,
+                      const Geom_objects::primitive_store_t<T>& store) const {
+        return [current_node, begin, &store](size_t number) -> const auto& {
+            return store.get_prepared_triangle(current_node->polygons_in_space_[begin + number]);
+        };
+    }
+
+    // Octants of box touched by each of polygons [begin, end) of current_node, at depth 0
+    void find_all_octants(const octree_node_t<T>* current_node, const Geom_objects::AABB_t<T>& box,
+                          size_t begin, size_t end, const Geom_objects::primitive_store_t<T>& store) {
+        if (active_polygons_.empty()) {
+            active_polygons_.emplace_back();
+            touched_octants_.emplace_back();
+        }
+
+        auto& all_polygons = active_polygons_[0];
+        all_polygons.clear();
+        for (size_t number = 0; number < end - begin; ++number)
+            all_polygons.push_back(number);
+
+        node_polygons_.find_octants(box, looseness_, all_polygons, touched_octants_[0],
+                                    get_prepared(current_node, begin, store));
+    }
+
+    // Walks the subtrees on children_stack_ with polygons of current_node from node_polygons_
+    template <typename Result>
+    void intersect_polygons_with_stacked(Result& result, const octree_node_t<T>* current_node, size_t begin,
+                                         const Geom_objects::primitive_store_t<T>& store) {
+        while (!children_stack_.empty()) {
+            auto [child, depth, octant] = children_stack_.back();
+            children_stack_.pop_back();
+
+            // Parent's lists stay valid: only its descendants are visited between
+            // the parent and this child
+            if (active_polygons_.size() <= depth) {
+                active_polygons_.resize(depth + 1);
+                touched_octants_.resize(depth + 1);
+            }
+
+            const auto& parent_polygons = active_polygons_[depth - 1];
+            const auto& parent_octants  = touched_octants_[depth - 1];
+            auto& child_active_polygons = active_polygons_[depth];
+            child_active_polygons.clear();
+
+            for (size_t number = 0; number < parent_polygons.size(); ++number) {
+                if (parent_octants[number] & (1u << octant))
+                    child_active_polygons.push_back(parent_polygons[number]);
+            }
+
+            if (child_active_polygons.empty())
+                continue;
+
+            const auto& child_polygons = child->polygons_in_space_;
+
+            child_polygons_.clear();
+            for (auto child_polygon : child_polygons)
+                child_polygons_.push_back(store.get_polygon(child_polygon), store.get_box(child_polygon));
+
+            for (size_t number : child_active_polygons) {
+                const auto& polygon = node_polygons_[number];
+                size_t polygon_number = store.get_number(current_node->polygons_in_space_[begin + number]);
+                bool polygon_is_found = result.is_found(polygon_number);
+
+                child_polygons_.intersect(polygon, 0, [&](size_t child_number) {
+                    result.insert_pair(polygon_number, store.get_number(child_polygons[child_number]));
+                }, [&](size_t child_number) {
+                    return polygon_is_found && result.is_found(store.get_number(child_polygons[child_number]));
+                });
+            }
+
+            if (child->is_leaf_)
+                continue;
+
+            node_polygons_.find_octants(child->bounding_box_, looseness_, child_active_polygons,
+                                        touched_octants_[depth], get_prepared(current_node, begin, store));
+            push_children(child, depth + 1);
+        }
+    }
+
+    void push_children(const octree_node_t<T>* node, size_t depth) {
+        if (node->is_leaf_)
+            return;
+
+        for (size_t number_of_child = 0; number_of_child < number_of_children; ++number_of_child) {
+            if (node->valid_children_[number_of_child])
+                children_stack_.emplace_back(node->children_[number_of_child], depth, number_of_child);
+        }
+    }
 };
 
 template <typename T> 
 class subdivider_t {
+    public:
+    // Polygons of bigger nodes are sorted into children in parallel parts of this size
+    static constexpr size_t parallel_split_size = 4096;
+
+    // Nodes smaller than this many tolerances of their coordinates are not split,
+    // their octants are within rounding of each other
+    static constexpr size_t min_box_size_in_tolerances = 64;
+
     private:
     size_t min_size_;
+    size_t max_depth_;
+    T max_straddling_;
+    T looseness_;
+    split_policy_t<T> split_policy_;
 
     public:
-    subdivider_t(size_t min_size): min_size_{min_size} {}
+    subdivider_t(const subdivision_parameters_t<T>& parameters):
+        min_size_{parameters.min_size}, max_depth_{parameters.max_depth}, max_straddling_{parameters.max_straddling},
+        looseness_{parameters.looseness}, split_policy_{parameters.split_policy} {
+        if (!split_policy_)
+            split_policy_ = make_cost_split_policy(parameters.node_cost);
+    }
+
+    T get_looseness() const { return looseness_; }
+
+    // The root of a loose tree is the bounding box enlarged like every other node,
+    // so its children cover the octants of the bounding box itself
+    Geom_objects::AABB_t<T> get_root_box(const Geom_objects::AABB_t<T>& bounding_box) const {
+        auto box_edges = bounding_box.get_box_edges();
+        for (auto& box_edge : box_edges)
+            box_edge *= looseness_;
 
-    void subdivide(octree_node_t<T>* root, memory_manager_t<T>& memery_manager) {
+        return Geom_objects::AABB_t<T>{bounding_box.get_middle_point(), box_edges};
+    }
+
+    void subdivide(octree_node_t<T>* root, memory_manager_t<T>& memery_manager,
+                   const Geom_objects::primitive_store_t<T>& store) {
         if (root == nullptr)
             return;
 
-        if (root->polygons_in_space_.size() < min_size_)
-            return;
+        sort_by_kind(root, store);
 
-        std::stack<octree_node_t<T>*> node_stack;
-        node_stack.push(root);
-        while (!node_stack.empty()) {
-            auto current_node = node_stack.top();
-            node_stack.pop();
-            size_t begin_size = current_node->polygons_in_space_.size();
-
-            std::array<T, Geom_objects::AABB_t<T>::number_of_edges> halfs_of_edges {
-                current_node->bounding_box_.get_box_x_edge() / 2,
-                current_node->bounding_box_.get_box_y_edge() / 2,
-                current_node->bounding_box_.get_box_z_edge() / 2
-            };
+        // Breadth-first, so nodes are allocated level by level
+        std::queue<octree_node_t<T>*> node_queue;
+        node_queue.push(root);
+        while (!node_queue.empty()) {
+            auto current_node = node_queue.front();
+            node_queue.pop();
 
-            T middle_point_x, middle_point_y, middle_point_z;
+            split_node(current_node, memery_manager, store, nullptr);
 
             for (size_t number_of_child = 0; number_of_child < number_of_children; ++number_of_child) {
-                middle_point_x = current_node->bounding_box_.get_middle_point().get_x() + 
-                                ((number_of_child & 1) ? -halfs_of_edges[0] : halfs_of_edges[0]);
+                if (current_node->valid_children_[number_of_child])
+                    node_queue.push(current_node->children_[number_of_child]);
+            }
+        }
+    }          
 
-                middle_point_y = current_node->bounding_box_.get_middle_point().get_y() + 
-                                ((number_of_child & 2) ? -halfs_of_edges[1] : halfs_of_edges[1]);
+    // Builds the same tree as the serial version: a split depends only on the node itself,
+    // so sibling subtrees are built by different tasks
+    void subdivide(octree_node_t<T>* root, memory_manager_t<T>& memery_manager,
+                   const Geom_objects::primitive_store_t<T>& store, Parallel::thread_pool_t& thread_pool) {
+        if (root == nullptr)
+            return;
 
-                middle_point_z = current_node->bounding_box_.get_middle_point().get_z() + 
-                                ((number_of_child & 4) ? -halfs_of_edges[2] : halfs_of_edges[2]);
+        sort_by_kind(root, store);
 
-                Geom_objects::point_t<T> new_middle_point{middle_point_x, middle_point_y, middle_point_z};
-                Geom_objects::AABB_t<T> new_bounding_box{new_middle_point, halfs_of_edges};
+        thread_pool.submit([this, root, &memery_manager, &store, &thread_pool] {
+            subdivide_subtree(root, memery_manager, store, thread_pool);
+        });
+        thread_pool.wait();
+    }
 
-                current_node->children_[number_of_child] = memery_manager.make_node(new_bounding_box, 
-                                                                                    current_node);
-            }
+    private:
+    // Triangles go first. Splits keep the order, so in every node triangles are a prefix
+    // of the list, and polygon_batch_t tests them against a triangle by the triangle kernel alone.
+    static void sort_by_kind(octree_node_t<T>* root, const Geom_objects::primitive_store_t<T>& store) {
+        auto& polygons = root->polygons_in_space_;
+        std::stable_partition(polygons.begin(), polygons.end(), [&store](index_t<T> index) {
+            return store.get_kind(index) == Geom_objects::primitive_kind_t::triangle;
+        });
+    }
 
-            std::vector<Geom_objects::polygon_t<T>> polygons_to_move;
-            polygons_to_move.swap(current_node->polygons_in_space_);
+    void subdivide_subtree(octree_node_t<T>* node, memory_manager_t<T>& memery_manager,
+                           const Geom_objects::primitive_store_t<T>& store, Parallel::thread_pool_t& thread_pool) {
+        split_node(node, memery_manager, store, &thread_pool);
 
-            for (auto polygon : polygons_to_move) {
-                bool moved = false;
-                for (size_t number_of_child = 0; number_of_child < number_of_children; ++number_of_child) {
-                    if (current_node->children_[number_of_child]->bounding_box_.is_polygon_inside_box(polygon)) {
-                        current_node->children_[number_of_child]->polygons_in_space_.push_back(polygon);
-                        current_node->valid_children_[number_of_child] = true;
-                        moved = true;
-                    }
+        for (size_t number_of_child = 0; number_of_child < number_of_children; ++number_of_child) {
+            if (!node->valid_children_[number_of_child])
+                continue;
+
+            octree_node_t<T>* child = node->children_[number_of_child];
+            thread_pool.submit([this, child, &memery_manager, &store, &thread_pool] {
+                subdivide_subtree(child, memery_manager, store, thread_pool);
+            });
+        }
+    }
+
+    // Octant of the node the centroid of the polygon is in, numbered like AABB_t::get_octant
+    static size_t get_centroid_octant(const Geom_objects::point_t<T>& middle_point,
+                                      const Geom_objects::primitive_store_t<T>& store, index_t<T> index) {
+        T x = (store.get_x(index, 0) + store.get_x(index, 1) + store.get_x(index, 2)) / 3;
+        T y = (store.get_y(index, 0) + store.get_y(index, 1) + store.get_y(index, 2)) / 3;
+        T z = (store.get_z(index, 0) + store.get_z(index, 1) + store.get_z(index, 2)) / 3;
+
+        return (x < middle_point.get_x()) | ((y < middle_point.get_y()) << 1) | ((z < middle_point.get_z()) << 2);
+    }
+
+    // Nodes that small, that deep or that small in space stay leaves without looking at their polygons
+    bool may_split(const octree_node_t<T>* node) const {
+        return node->polygons_in_space_.size() >= min_size_ && node->depth < max_depth_ &&
+               get_box_size(node->bounding_box_) > min_box_size_in_tolerances * node->bounding_box_.get_tolerance();
+    }
+
+    static T get_box_size(const Geom_objects::AABB_t<T>& box) {
+        const auto& box_edges = box.get_box_edges();
+        return 2 * *std::max_element(box_edges.begin(), box_edges.end());
+    }
+
+    // Moves polygons of the node that are inside one of its octants to the child of that octant,
+    // if the split policy agrees. In a loose tree a polygon goes only to the octant of its centroid,
+    // if it is small enough to be inside its enlarged box. Children are created only for octants
+    // that get polygons.
+    void split_node(octree_node_t<T>* current_node, memory_manager_t<T>& memery_manager,
+                    const Geom_objects::primitive_store_t<T>& store, Parallel::thread_pool_t* thread_pool) {
+        if (!may_split(current_node))
+            return;
+
+        const auto& polygons = current_node->polygons_in_space_;
+        auto children_boxes = current_node->bounding_box_.get_octants(looseness_);
+
+        // Bit number_of_child is set if the polygon is inside that child
+        std::vector<uint8_t> children_masks(polygons.size());
+
+        auto find_children = [&](size_t begin, size_t end) {
+            if (looseness_ != 1) {
+                for (size_t number = begin; number < end; ++number) {
+                    size_t octant = get_centroid_octant(current_node->bounding_box_.get_middle_point(), store,
+                                                        polygons[number]);
+                    bool is_inside = children_boxes[octant].is_primitive_inside_box(store, polygons[number]);
+                    children_masks[number] = static_cast<uint8_t>(is_inside << octant);
                 }
-                if (!moved) {
-                    current_node->polygons_in_space_.push_back(polygon);
+                return;
+            }
+
+            for (size_t number = begin; number < end; ++number) {
+                uint8_t mask = 0;
+                for (size_t number_of_child = 0; number_of_child < number_of_children; ++number_of_child) {
+                    if (children_boxes[number_of_child].is_primitive_inside_box(store, polygons[number]))
+                        mask |= static_cast<uint8_t>(1u << number_of_child);
                 }
+                children_masks[number] = mask;
             }
+        };
+
+        if (thread_pool != nullptr && polygons.size() > parallel_split_size)
+            thread_pool->parallel_for(0, polygons.size(), parallel_split_size, find_children);
+        else 
+            find_children(0, polygons.size());
+
+        split_candidate_t<T> candidate;
+        candidate.number_of_polygons = polygons.size();
+        candidate.depth    = current_node->depth;
+        candidate.box_size = get_box_size(current_node->bounding_box_);
+
+        for (uint8_t mask : children_masks) {
+            candidate.number_of_straddlers += (mask == 0);
+            for (size_t number_of_child = 0; number_of_child < number_of_children; ++number_of_child)
+                candidate.polygons_in_children[number_of_child] += (mask & (1u << number_of_child)) != 0;
+        }
+
+        if (candidate.number_of_straddlers == candidate.number_of_polygons ||
+            static_cast<T>(candidate.number_of_straddlers) > max_straddling_ * static_cast<T>(polygons.size()) ||
+            !split_policy_(candidate))
+            return;
 
-            if (begin_size - current_node->polygons_in_space_.size()) 
-                current_node->is_leaf_ = false;
+        std::pmr::vector<index_t<T>> polygons_to_move{memery_manager.get_polygons_allocator()};
+        polygons_to_move.swap(current_node->polygons_in_space_);
+
+        memery_manager.make_children(current_node, children_boxes, candidate.polygons_in_children);
+        current_node->polygons_in_space_.reserve(candidate.number_of_straddlers);
+
+        // Sequential pass keeps the order of polygons in every node
+        for (size_t number = 0; number < polygons_to_move.size(); ++number) {
+            uint8_t mask = children_masks[number];
+            if (mask == 0) {
+                current_node->polygons_in_space_.push_back(polygons_to_move[number]);
+                continue;
+            }
 
             for (size_t number_of_child = 0; number_of_child < number_of_children; ++number_of_child) {
-                if (current_node->valid_children_[number_of_child])
-                    node_stack.push(current_node->children_[number_of_child]);
+                if (mask & (1u << number_of_child)) {
+                    current_node->children_[number_of_child]->polygons_in_space_.push_back(polygons_to_move[number]);
+                    current_node->valid_children_[number_of_child] = true;
+                }
             }
         }
-    }          
+
+        current_node->is_leaf_ = false;
+    }
 };
 
 template <typename T>
 class octree_t {
+    public:
+    // Big nodes are split into parts of this size for parallel detection
+    static constexpr size_t polygons_per_task = 64;
+
     private:
     memory_manager_t<T> memory_manager_;
+    Geom_objects::primitive_store_t<T> store_;
     subdivider_t<T> subdivider_;
     detector_of_collisions_t<T> detector_of_collisions_;
     octree_node_t<T>* root_ = nullptr;
+
+    size_t number_of_pairs_          = 0;
+    size_t number_of_rejected_pairs_ = 0;
     
     public:
     // rule of five 
@@ -224,10 +662,13 @@ class octree_t {
 
     octree_t& operator=(const octree_t& other) = delete;
 
-    octree_t(octree_t&& other) noexcept: memory_manager_{memory_manager_},
-                                         subdivider_{other.subdivider_},
-                                         detector_of_collisions_{other.detector_of_collisions_},
-                                         root_{other.root_} {
+    octree_t(octree_t&& other) noexcept: memory_manager_{std::move(other.memory_manager_)},
+                                         store_{std::move(other.store_)},
+                                         subdivider_{std::move(other.subdivider_)},
+                                         detector_of_collisions_{std::move(other.detector_of_collisions_)},
+                                         root_{other.root_},
+                                         number_of_pairs_{other.number_of_pairs_},
+                                         number_of_rejected_pairs_{other.number_of_rejected_pairs_} {
         other.root_ = nullptr;
     }
 
@@ -235,8 +676,12 @@ class octree_t {
         if (this == &other)
             return *this; 
         std::swap(memory_manager_, other.memory_manager_);
+        std::swap(store_, other.store_);
         std::swap(subdivider_, other.subdivider_);
+        std::swap(detector_of_collisions_, other.detector_of_collisions_);
         std::swap(root_, other.root_);
+        std::swap(number_of_pairs_, other.number_of_pairs_);
+        std::swap(number_of_rejected_pairs_, other.number_of_rejected_pairs_);
         return *this;
     }
 
@@ -246,22 +691,202 @@ class octree_t {
 
     template <typename PolygonsIterator>
     octree_t(PolygonsIterator begin, PolygonsIterator end, const Geom_objects::AABB_t<T>& bounding_box, 
-             size_t min_size = 50): subdivider_{min_size} {
+             size_t min_size = default_min_size):
+        subdivider_{subdivision_parameters_t<T>{.min_size = min_size}} {
         if (begin == end)
             return;
 
         root_ = memory_manager_.make_node(bounding_box, nullptr);
 
         for (auto polygon_iter = begin; polygon_iter != end; ++polygon_iter) {
-            root_->polygons_in_space_.emplace_back(*polygon_iter);
+            root_->polygons_in_space_.emplace_back(store_.add(*polygon_iter));
         }
 
-        subdivider_.subdivide(root_, memory_manager_); 
+        subdivider_.subdivide(root_, memory_manager_, store_); 
     } 
 
-    void get_number_of_intersections(std::set<size_t>& result) {
-       detector_of_collisions_.intersect_polygons_inside_node(root_, result);
+    // Nine coordinates per triangle, e.g. a view over mapped binary records
+    template <typename S>
+    octree_t(std::span<const S> coordinates, const Geom_objects::AABB_t<T>& bounding_box, 
+             size_t min_size = default_min_size):
+        octree_t{coordinates, bounding_box, subdivision_parameters_t<T>{.min_size = min_size}} {}
+
+    template <typename S>
+    octree_t(std::span<const S> coordinates, const Geom_objects::AABB_t<T>& bounding_box,
+             const subdivision_parameters_t<T>& parameters):
+        subdivider_{parameters}, detector_of_collisions_{parameters.looseness} {
+        const size_t coordinates_per_triangle = 9;
+        size_t number_of_polygons = coordinates.size() / coordinates_per_triangle;
+        if (number_of_polygons == 0)
+            return;
+
+        root_ = memory_manager_.make_node(subdivider_.get_root_box(bounding_box), nullptr);
+        root_->polygons_in_space_.reserve(number_of_polygons);
+        store_.reserve(number_of_polygons);
+
+        for (size_t number = 0; number < number_of_polygons; ++number) {
+            root_->polygons_in_space_.emplace_back(store_.add(
+                Geom_objects::make_geometric_primitive<T>(coordinates.data() + number * coordinates_per_triangle, number)));
+        }
+
+        subdivider_.subdivide(root_, memory_manager_, store_); 
+    }
+
+    // Builds the same tree as the serial constructor
+    template <typename S>
+    octree_t(std::span<const S> coordinates, const Geom_objects::AABB_t<T>& bounding_box, 
+             Parallel::thread_pool_t& thread_pool, size_t min_size = default_min_size):
+        octree_t{coordinates, bounding_box, subdivision_parameters_t<T>{.min_size = min_size}, thread_pool} {}
+
+    template <typename S>
+    octree_t(std::span<const S> coordinates, const Geom_objects::AABB_t<T>& bounding_box,
+             const subdivision_parameters_t<T>& parameters, Parallel::thread_pool_t& thread_pool):
+        subdivider_{parameters}, detector_of_collisions_{parameters.looseness} {
+        const size_t coordinates_per_triangle = 9;
+        size_t number_of_polygons = coordinates.size() / coordinates_per_triangle;
+        if (number_of_polygons == 0)
+            return;
+
+        root_ = memory_manager_.make_node(subdivider_.get_root_box(bounding_box), nullptr);
+        root_->polygons_in_space_.resize(number_of_polygons);
+        store_.resize(number_of_polygons);
+
+        thread_pool.parallel_for(0, number_of_polygons, subdivider_t<T>::parallel_split_size, 
+                                 [&](size_t begin, size_t end) {
+            for (size_t number = begin; number < end; ++number) {
+                index_t<T> index = static_cast<index_t<T>>(number);
+                store_.set(index, Geom_objects::make_geometric_primitive<T>(
+                                      coordinates.data() + number * coordinates_per_triangle, number));
+                root_->polygons_in_space_[number] = index;
+            }
+        });
+
+        subdivider_.subdivide(root_, memory_manager_, store_, thread_pool); 
+    }
+
+    // Result is a Geom_objects::intersection_bitset_t with a bit for every primitive of the tree
+    // or a Geom_objects::pair_callback_t
+    template <typename Result>
+    void get_number_of_intersections(Result& result) {
+        size_t pairs_before    = detector_of_collisions_.get_number_of_pairs();
+        size_t rejected_before = detector_of_collisions_.get_number_of_rejected();
+        detector_of_collisions_.intersect_polygons_inside_node(root_, result, store_);
+        number_of_pairs_          = detector_of_collisions_.get_number_of_pairs() - pairs_before;
+        number_of_rejected_pairs_ = detector_of_collisions_.get_number_of_rejected() - rejected_before;
     } 
+
+    // Pairs tested by the last query and pairs of them rejected by boxes before the exact test
+    size_t get_number_of_pairs()          const { return number_of_pairs_; }
+    size_t get_number_of_rejected_pairs() const { return number_of_rejected_pairs_; }
+
+    size_t get_number_of_nodes()  const { return memory_manager_.get_number_of_nodes(); }
+    size_t get_allocated_bytes()  const { return memory_manager_.get_allocated_bytes(); }
+    size_t get_store_bytes()      const { return store_.get_allocated_bytes(); }
+    T      get_looseness()        const { return subdivider_.get_looseness(); }
+
+    // Polygons kept in nodes with children: they straddle boxes of the children,
+    // and each of them is tested against the subtree below its node
+    size_t get_number_of_straddlers() const {
+        size_t number_of_straddlers = 0;
+
+        std::vector<const octree_node_t<T>*> nodes;
+        if (root_ != nullptr)
+            nodes.push_back(root_);
+
+        while (!nodes.empty()) {
+            const octree_node_t<T>* node = nodes.back();
+            nodes.pop_back();
+
+            if (!node->is_leaf_)
+                number_of_straddlers += node->polygons_in_space_.size();
+
+            for (size_t number_of_child = 0; number_of_child < number_of_children; ++number_of_child) {
+                if (node->valid_children_[number_of_child])
+                    nodes.push_back(node->children_[number_of_child]);
+            }
+        }
+
+        return number_of_straddlers;
+    }
+
+    // Depth of the deepest node, 0 for the root alone
+    size_t get_depth() const {
+        size_t depth = 0;
+
+        std::vector<const octree_node_t<T>*> nodes;
+        if (root_ != nullptr)
+            nodes.push_back(root_);
+
+        while (!nodes.empty()) {
+            const octree_node_t<T>* node = nodes.back();
+            nodes.pop_back();
+
+            depth = std::max(depth, node->depth);
+            for (size_t number_of_child = 0; number_of_child < number_of_children; ++number_of_child) {
+                if (node->valid_children_[number_of_child])
+                    nodes.push_back(node->children_[number_of_child]);
+            }
+        }
+
+        return depth;
+    }
+
+    const octree_node_t<T>*                   get_root()  const { return root_; }
+    const Geom_objects::primitive_store_t<T>& get_store() const { return store_; }
+
+    // Gives the primitives away, e.g. to a flattened copy of the tree. The tree can't be queried after it.
+    Geom_objects::primitive_store_t<T> take_store() { return std::move(store_); }
+
+    // The same pairs as in the serial version are tested, except the skipped ones: every subtree
+    // and every part of a big node is a task, each worker has its own detector, the result is shared
+    template <typename Result>
+    void get_number_of_intersections(Result& result, Parallel::thread_pool_t& thread_pool) {
+        if (root_ == nullptr)
+            return;
+
+        std::vector<detector_of_collisions_t<T>> detectors(thread_pool.get_number_of_threads(),
+                                                           detector_of_collisions_t<T>{get_looseness()});
+
+        thread_pool.submit([&] { submit_subtree(root_, thread_pool, detectors, result); });
+        thread_pool.wait();
+
+        number_of_pairs_ = number_of_rejected_pairs_ = 0;
+        for (const auto& detector : detectors) {
+            number_of_pairs_          += detector.get_number_of_pairs();
+            number_of_rejected_pairs_ += detector.get_number_of_rejected();
+        }
+    }
+
+    private:
+    template <typename Result>
+    void submit_subtree(const octree_node_t<T>* node, Parallel::thread_pool_t& thread_pool,
+                        std::vector<detector_of_collisions_t<T>>& detectors, Result& result) const {
+        for (size_t number_of_child = 0; number_of_child < number_of_children; ++number_of_child) {
+            if (!node->valid_children_[number_of_child])
+                continue;
+
+            const octree_node_t<T>* child = node->children_[number_of_child];
+            thread_pool.submit([this, child, &thread_pool, &detectors, &result] {
+                submit_subtree(child, thread_pool, detectors, result);
+            });
+        }
+
+        size_t number_of_polygons = node->polygons_in_space_.size();
+        for (size_t begin = 0; begin < number_of_polygons; begin += polygons_per_task) {
+            size_t end = std::min(number_of_polygons, begin + polygons_per_task);
+
+            auto task = [this, node, begin, end, &thread_pool, &detectors, &result] {
+                size_t worker = thread_pool.get_current_worker();
+                detectors[worker].intersect_node_polygons(node, begin, end, result, store_);
+            };
+
+            // The last part is done right here
+            if (end == number_of_polygons)
+                task();
+            else 
+                thread_pool.submit(task);
+        }
+    }
 };
 
 } // namespace Octree
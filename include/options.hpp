@@ -0,0 +1,238 @@
+#ifndef OPTIONS_HPP
+#define OPTIONS_HPP
+
+#include <iostream>
+#include <string>
+#include <string_view>
+#include <charconv>
+#include <optional>
+#include <cmath>
+
+#include "binary_format.hpp"
+#include "pair_writer.hpp"
+#include "number_writer.hpp"
+
+namespace Options {
+
+// More threads than this only fight for the cores and the memory of their stacks
+inline constexpr size_t max_number_of_threads = 256;
+
+enum class tree_layout_t {
+    pointer, // octree_t
+    linear   // linear_octree_t
+};
+
+enum class broad_phase_t {
+    octree,          // octree of tree_layout_t
+    sweep_and_prune, // Broad_phase::sweep_and_prune_t
+    bvh,             // Broad_phase::bvh_t
+    grid             // Broad_phase::hash_grid_t
+};
+
+struct options_t {
+    std::string             input_path;           // stdin if empty
+    std::string             convert_path;         // write binary input here and exit
+    std::string             output_path;          // results go here, stdout if empty
+    Input::scalar_type_t    convert_scalar_type = Input::scalar_type_t::double_type;
+    size_t                  number_of_threads   = 1;  // 0 means all hardware threads
+    bool                    print_statistics    = false;
+    tree_layout_t           tree_layout         = tree_layout_t::pointer;
+    broad_phase_t           broad_phase         = broad_phase_t::octree;
+    bool                    print_pairs         = false; // every intersecting pair instead of numbers
+    Output::pair_format_t   pair_format         = Output::pair_format_t::text;
+    Output::number_format_t number_format       = Output::number_format_t::text;
+    double                  looseness           = 1.0; // octree children are octants enlarged this many times
+    // Limits of octree splits, Octree::subdivision_parameters_t defaults if not given
+    std::optional<size_t>   min_size;
+    std::optional<size_t>   max_depth;
+    std::optional<double>   node_cost;
+    std::optional<double>   max_straddling;
+};
+
+inline void print_usage(const char* program_name) {
+    std::cerr << "Usage: " << program_name << " [options] [input file]\n"
+              << "Input is text or binary triangle soup, stdin if no file is given\n"
+              << "Options:\n"
+              << "  --convert <file>        write input as binary triangle soup to file and exit\n"
+              << "  --scalar float|double   scalar type of converted records (double)\n"
+              << "  --threads <number>      threads for build and detection, 0 for all hardware threads, at most "
+              << max_number_of_threads << " (1)\n"
+              << "  --layout pointer|linear layout of the octree for detection (pointer)\n"
+              << "  --broad-phase <name>    octree, sap (sweep and prune over boxes of primitives), bvh or grid (octree)\n"
+              << "  --looseness <factor>    loose octree: children are octants enlarged by factor >= 1 (1)\n"
+              << "  --min-size <number>     octree nodes with fewer triangles are not split (32)\n"
+              << "  --max-depth <number>    octree nodes this deep are not split (24)\n"
+              << "  --node-cost <pairs>     cost of an octree node in tested pairs, splits must save more (128)\n"
+              << "  --max-straddling <part> no split leaving a bigger part of triangles in the node, 0..1 (1)\n"
+              << "  --output <file>         write results to file instead of stdout\n"
+              << "  --ids text|binary       numbers of intersecting triangles as lines or uint32_t (text)\n"
+              << "  --pairs text|binary     print every intersecting pair instead of numbers of triangles\n"
+              << "  --stats                 print sizes of the broad phase structure to stderr\n"
+              << "  --help                  show this message\n";
+}
+
+inline bool parse_number(std::string_view value, size_t& number) {
+    auto [next, error] = std::from_chars(value.data(), value.data() + value.size(), number);
+    if (error != std::errc{} || next != value.data() + value.size()) {
+        std::cerr << "Wrong number " << value << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// std::from_chars reads "inf" and "nan" too, no option takes them
+inline bool parse_number(std::string_view value, double& number) {
+    auto [next, error] = std::from_chars(value.data(), value.data() + value.size(), number);
+    if (error != std::errc{} || next != value.data() + value.size() || !std::isfinite(number)) {
+        std::cerr << "Wrong number " << value << std::endl;
+        return false;
+    }
+
+    return true;
+}
+
+// Returns false and prints usage on wrong arguments
+inline bool parse_options(int argc, char* argv[], options_t& options) {
+    for (int argument_number = 1; argument_number < argc; ++argument_number) {
+        std::string_view argument = argv[argument_number];
+
+        auto next_value = [&](std::string_view& value) {
+            if (argument_number + 1 >= argc) {
+                std::cerr << "Missing value for " << argument << std::endl;
+                return false;
+            }
+            value = argv[++argument_number];
+            return true;
+        };
+
+        std::string_view value;
+
+        if (argument == "--help") {
+            print_usage(argv[0]);
+            return false;
+        } else if (argument == "--convert") {
+            if (!next_value(value))
+                return false;
+            options.convert_path = value;
+        } else if (argument == "--scalar") {
+            if (!next_value(value))
+                return false;
+            if (value == "float")
+                options.convert_scalar_type = Input::scalar_type_t::float_type;
+            else if (value == "double")
+                options.convert_scalar_type = Input::scalar_type_t::double_type;
+            else {
+                std::cerr << "Unknown scalar type " << value << std::endl;
+                return false;
+            }
+        } else if (argument == "--threads") {
+            if (!next_value(value) || !parse_number(value, options.number_of_threads))
+                return false;
+            if (options.number_of_threads > max_number_of_threads) {
+                std::cerr << "At most " << max_number_of_threads << " threads" << std::endl;
+                return false;
+            }
+        } else if (argument == "--layout") {
+            if (!next_value(value))
+                return false;
+            if (value == "pointer")
+                options.tree_layout = tree_layout_t::pointer;
+            else if (value == "linear")
+                options.tree_layout = tree_layout_t::linear;
+            else {
+                std::cerr << "Unknown layout " << value << std::endl;
+                return false;
+            }
+        } else if (argument == "--broad-phase") {
+            if (!next_value(value))
+                return false;
+            if (value == "octree")
+                options.broad_phase = broad_phase_t::octree;
+            else if (value == "sap")
+                options.broad_phase = broad_phase_t::sweep_and_prune;
+            else if (value == "bvh")
+                options.broad_phase = broad_phase_t::bvh;
+            else if (value == "grid")
+                options.broad_phase = broad_phase_t::grid;
+            else {
+                std::cerr << "Unknown broad phase " << value << std::endl;
+                return false;
+            }
+        } else if (argument == "--looseness") {
+            if (!next_value(value) || !parse_number(value, options.looseness))
+                return false;
+            if (!(std::isfinite(options.looseness) && options.looseness >= 1.0)) {
+                std::cerr << "Looseness must be at least 1" << std::endl;
+                return false;
+            }
+        } else if (argument == "--min-size") {
+            options.min_size.emplace();
+            if (!next_value(value) || !parse_number(value, *options.min_size))
+                return false;
+        } else if (argument == "--max-depth") {
+            options.max_depth.emplace();
+            if (!next_value(value) || !parse_number(value, *options.max_depth))
+                return false;
+        } else if (argument == "--node-cost") {
+            double node_cost = 0;
+            if (!next_value(value) || !parse_number(value, node_cost))
+                return false;
+            if (!(node_cost >= 0.0)) {
+                std::cerr << "Node cost must not be negative" << std::endl;
+                return false;
+            }
+            options.node_cost = node_cost;
+        } else if (argument == "--max-straddling") {
+            double max_straddling = 0;
+            if (!next_value(value) || !parse_number(value, max_straddling))
+                return false;
+            if (!(max_straddling >= 0.0 && max_straddling <= 1.0)) {
+                std::cerr << "Max straddling must be from 0 to 1" << std::endl;
+                return false;
+            }
+            options.max_straddling = max_straddling;
+        } else if (argument == "--output") {
+            if (!next_value(value))
+                return false;
+            options.output_path = value;
+        } else if (argument == "--ids") {
+            if (!next_value(value))
+                return false;
+            if (value == "text")
+                options.number_format = Output::number_format_t::text;
+            else if (value == "binary")
+                options.number_format = Output::number_format_t::binary;
+            else {
+                std::cerr << "Unknown number format " << value << std::endl;
+                return false;
+            }
+        } else if (argument == "--pairs") {
+            if (!next_value(value))
+                return false;
+            options.print_pairs = true;
+            if (value == "text")
+                options.pair_format = Output::pair_format_t::text;
+            else if (value == "binary")
+                options.pair_format = Output::pair_format_t::binary;
+            else {
+                std::cerr << "Unknown pair format " << value << std::endl;
+                return false;
+            }
+        } else if (argument == "--stats") {
+            options.print_statistics = true;
+        } else if (argument.starts_with("--") || !options.input_path.empty()) {
+            std::cerr << "Unexpected argument " << argument << std::endl;
+            print_usage(argv[0]);
+            return false;
+        } else {
+            options.input_path = argument;
+        }
+    }
+
+    return true;
+}
+
+} // namespace Options
+
+#endif // OPTIONS_HPP
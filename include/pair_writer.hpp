@@ -0,0 +1,105 @@
+#ifndef PAIR_WRITER_HPP
+#define PAIR_WRITER_HPP
+
+#include <vector>
+#include <mutex>
+#include <ostream>
+#include <charconv>
+#include <cstring>
+#include <cstdint>
+#include <utility>
+
+namespace Output {
+
+enum class pair_format_t {
+    text,  // "first second\n", first < second
+    binary // two uint32_t per pair, first < second, native (little-endian) byte order, no header
+};
+
+// Blocks of formatted pairs go to one stream. Blocks come from several threads,
+// a block is written whole, so lines of different threads never mix.
+class pair_writer_t {
+    private:
+    std::ostream& output_;
+    pair_format_t format_;
+    std::mutex mutex_;
+    size_t number_of_pairs_ = 0;
+
+    public:
+    pair_writer_t(std::ostream& output, pair_format_t format): output_{output}, format_{format} {}
+
+    pair_format_t get_format() const { return format_; }
+
+    size_t get_number_of_pairs() {
+        std::lock_guard lock{mutex_};
+        return number_of_pairs_;
+    }
+
+    // May be called by several threads at once
+    void write(const char* bytes, size_t size, size_t number_of_pairs) {
+        std::lock_guard lock{mutex_};
+        output_.write(bytes, static_cast<std::streamsize>(size));
+        number_of_pairs_ += number_of_pairs;
+    }
+};
+
+// Pairs of one thread are formatted into a block of fixed size, a full block goes
+// to the writer. Memory doesn't grow with the number of pairs.
+class pair_buffer_t {
+    public:
+    static constexpr size_t pairs_in_block = 4096;
+    static constexpr size_t max_record_size = 2 * 20 + 2; // two numbers, a space and a new line
+
+    private:
+    pair_writer_t* writer_;
+    std::vector<char> bytes_;
+    size_t size_ = 0;
+    size_t number_of_pairs_ = 0;
+
+    public:
+    explicit pair_buffer_t(pair_writer_t& writer): writer_{&writer}, bytes_(pairs_in_block * max_record_size) {}
+
+    // A moved buffer has nothing to flush
+    pair_buffer_t(pair_buffer_t&& other) noexcept:
+        writer_{other.writer_}, bytes_{std::move(other.bytes_)}, size_{std::exchange(other.size_, 0)},
+        number_of_pairs_{std::exchange(other.number_of_pairs_, 0)} {}
+
+    pair_buffer_t& operator=(pair_buffer_t&&) = delete;
+
+    ~pair_buffer_t() { flush(); }
+
+    void push_back(size_t first, size_t second) {
+        if (first > second)
+            std::swap(first, second);
+
+        char* record = bytes_.data() + size_;
+        if (writer_->get_format() == pair_format_t::binary) {
+            uint32_t numbers[2] = {static_cast<uint32_t>(first), static_cast<uint32_t>(second)};
+            std::memcpy(record, numbers, sizeof(numbers));
+            size_ += sizeof(numbers);
+        } else {
+            char* end = record + max_record_size;
+            record = std::to_chars(record, end, first).ptr;
+            *record++ = ' ';
+            record = std::to_chars(record, end, second).ptr;
+            *record++ = '\n';
+            size_ = static_cast<size_t>(record - bytes_.data());
+        }
+
+        if (++number_of_pairs_ == pairs_in_block)
+            flush();
+    }
+
+    void flush() {
+        if (number_of_pairs_ == 0)
+            return;
+
+        writer_->write(bytes_.data(), size_, number_of_pairs_);
+        size_ = 0;
+        number_of_pairs_ = 0;
+    }
+};
+
+} // namespace Output
+
+#endif // PAIR_WRITER_HPP
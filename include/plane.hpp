@@ -35,7 +35,7 @@ class plane_t {
     T get_b() const { return b_; };
     T get_c() const { return c_; };
     T get_d() const { return d_; };
-    vector_t<T> get_normal_vector() const { return normal_vector_; };
+    const vector_t<T>& get_normal_vector() const { return normal_vector_; };
 
     point_t<T> intersect_plane_and_segment(const segment_t<T>& segment) const {
         point_t<T> invalid_point{NAN, NAN, NAN};
@@ -3,6 +3,8 @@
 
 #include <cmath>
 #include <cassert>
+#include <iostream>
+#include <stdexcept>
 
 #include "double_compare.hpp"
 
@@ -2,10 +2,14 @@
 #define POLYGONS_HPP
 
 #include <variant>
+#include <array>
+#include <algorithm>
+#include <type_traits>
 
 #include "point.hpp"
 #include "segment.hpp"
 #include "triangle.hpp"
+#include "triangle_intersection.hpp"
 
 namespace Geom_objects {
 
@@ -52,66 +56,193 @@ polygon_t<T> make_geometric_primitive(const point_t<T>& a,
     return triangle_t{a, b, c, a.get_number()};
 }  
 
+// The same primitive with vertices of another scalar type, the kind is kept
+template <typename T, typename S>
+polygon_t<T> convert_polygon(const polygon_t<S>& polygon) {
+    auto convert_point = [](const point_t<S>& point) {
+        return point_t<T>{static_cast<T>(point.get_x()), static_cast<T>(point.get_y()),
+                          static_cast<T>(point.get_z()), point.get_number()};
+    };
+
+    switch (polygon.index()) {
+        case 0: // point_t
+            return convert_point(std::get<point_t<S>>(polygon));
+
+        case 1: { // segment_t
+            const auto& segment = std::get<segment_t<S>>(polygon);
+            return segment_t<T>{convert_point(segment.get_beg_point()), convert_point(segment.get_end_point()),
+                                segment.get_number()};
+        }
+
+        default: { // triangle_t
+            const auto& triangle = std::get<triangle_t<S>>(polygon);
+            return triangle_t<T>{convert_point(triangle.get_a()), convert_point(triangle.get_b()),
+                                 convert_point(triangle.get_c()), triangle.get_number()};
+        }
+    }
+}
+
+// Primitive from x, y, z of three points stored one after another. The kind is decided
+// in double for every T, so a float primitive is the double one with rounded vertices.
+template <typename T, typename S>
+polygon_t<T> make_geometric_primitive(const S* coordinates, size_t number) {
+    if constexpr (!std::is_same_v<T, double>) {
+        return convert_polygon<T>(make_geometric_primitive<double>(coordinates, number));
+    } else {
+        point_t<T> a{static_cast<T>(coordinates[0]), static_cast<T>(coordinates[1]), static_cast<T>(coordinates[2]), number};
+        point_t<T> b{static_cast<T>(coordinates[3]), static_cast<T>(coordinates[4]), static_cast<T>(coordinates[5]), number};
+        point_t<T> c{static_cast<T>(coordinates[6]), static_cast<T>(coordinates[7]), static_cast<T>(coordinates[8]), number};
+
+        return make_geometric_primitive(a, b, c);
+    }
+}
+
+// Tight box of the vertices of a primitive
 template <typename T>
-bool check_figures_intersection(const polygon_t<T>& first, const polygon_t<T>& second) {
-    switch (first.index()) {
+struct packed_box_t {
+    std::array<T, 3> min, max;
+};
+
+template <typename T>
+packed_box_t<T> make_box(const point_t<T>& a, const point_t<T>& b, const point_t<T>& c) {
+    packed_box_t<T> box;
+    for (size_t axis = 0; axis < 3; ++axis) {
+        box.min[axis] = std::min({a[axis], b[axis], c[axis]});
+        box.max[axis] = std::max({a[axis], b[axis], c[axis]});
+    }
+
+    return box;
+}
+
+template <typename T>
+packed_box_t<T> make_box(const polygon_t<T>& polygon) {
+    switch (polygon.index()) {
         case 0: { // point_t
-            auto point_1 = std::get<point_t<T>>(first);
-            switch (second.index()) {
-                case 0: { // point_t
-                    auto point_2 = std::get<point_t<T>>(second);
-                    return point_1.equal(point_2);
-                }
-                case 1: { // segment_t
-                    auto segment = std::get<segment_t<T>>(second);
-                    return segment.point_lies_on_segment(point_1);
-                }
-                case 2: { // triangle_t
-                    auto triangle = std::get<triangle_t<T>>(second);
-                    return triangle.point_lies_inside_triangle(point_1);
-                }
-            }
-            break;
+            const auto& point = std::get<point_t<T>>(polygon);
+            return make_box(point, point, point);
         }
 
         case 1: { // segment_t
-            auto segment_1 = std::get<segment_t<T>>(first);
-            switch (second.index()) {
-                case 0: { // point_t
-                    auto point = std::get<point_t<T>>(second);
-                    return segment_1.point_lies_on_segment(point);
-                }
-                case 1: { // segment_t
-                    auto segment_2 = std::get<segment_t<T>>(second);
-                    return segment_1.segments_intersects(segment_2) || segment_1.segments_overloap(segment_2);
-                }
-                case 2: { // triangle_t
-                    auto triangle = std::get<triangle_t<T>>(second);
-                    return triangle.triangle_intersect_segment(segment_1);
-                }
-            }
-            break;
+            const auto& segment = std::get<segment_t<T>>(polygon);
+            return make_box(segment.get_beg_point(), segment.get_end_point(), segment.get_end_point());
         }
-        case 2: { // triangle_t
-            auto triangle_1 = std::get<triangle_t<T>>(first);
-            switch (second.index()) {
-                case 0: { // point_t
-                    auto point = std::get<point_t<T>>(second);
-                    return triangle_1.point_lies_inside_triangle(point);
-                }
-                case 1: { // segment_t
-                    auto segment = std::get<segment_t<T>>(second);
-                    return triangle_1.triangle_intersect_segment(segment);
-                }
-                case 2: { // triangle_t
-                    auto triangle_2 = std::get<triangle_t<T>>(second);
-                    return triangle_2.triangles_intersects_in_3d(triangle_1);
-                }
-            }
-            break;
+
+        default: { // triangle_t
+            const auto& triangle = std::get<triangle_t<T>>(polygon);
+            return make_box(triangle.get_a(), triangle.get_b(), triangle.get_c());
         }
     }
-    return false;
+}
+
+// Tight box of the primitives of both boxes
+template <typename T>
+packed_box_t<T> merge_boxes(const packed_box_t<T>& first, const packed_box_t<T>& second) {
+    packed_box_t<T> box;
+    for (size_t axis = 0; axis < 3; ++axis) {
+        box.min[axis] = std::min(first.min[axis], second.min[axis]);
+        box.max[axis] = std::max(first.max[axis], second.max[axis]);
+    }
+
+    return box;
+}
+
+// Boxes of two primitives are farther apart than the tolerance of both, like in the box
+// filter of primitive_columns_t
+template <typename T>
+bool boxes_are_apart(const polygon_t<T>& first, const polygon_t<T>& second) {
+    packed_box_t<T> query = make_box(first), box = make_box(second);
+    const T tolerance = 2 * Compare::epsilon_v<T>;
+
+    bool apart = false;
+    for (size_t axis = 0; axis < 3; ++axis) {
+        query.min[axis] -= tolerance;
+        query.max[axis] += tolerance;
+        apart |= box.min[axis] > query.max[axis] || box.max[axis] < query.min[axis];
+    }
+
+    return apart;
+}
+
+// Test of a pair of primitives of fixed kinds. One order of every two kinds is specialized,
+// the other one swaps the arguments.
+template <typename First, typename Second>
+struct pair_kernel_t {
+    static bool intersect(const First& first, const Second& second) {
+        return pair_kernel_t<Second, First>::intersect(second, first);
+    }
+};
+
+template <typename T>
+struct pair_kernel_t<point_t<T>, point_t<T>> {
+    static bool intersect(const point_t<T>& point_1, const point_t<T>& point_2) {
+        return point_1.equal(point_2);
+    }
+};
+
+template <typename T>
+struct pair_kernel_t<point_t<T>, segment_t<T>> {
+    static bool intersect(const point_t<T>& point, const segment_t<T>& segment) {
+        return segment.point_lies_on_segment(point);
+    }
+};
+
+template <typename T>
+struct pair_kernel_t<point_t<T>, triangle_t<T>> {
+    static bool intersect(const point_t<T>& point, const triangle_t<T>& triangle) {
+        return triangle.point_lies_inside_triangle(point);
+    }
+};
+
+template <typename T>
+struct pair_kernel_t<segment_t<T>, segment_t<T>> {
+    static bool intersect(const segment_t<T>& segment_1, const segment_t<T>& segment_2) {
+        return segment_1.segments_intersects(segment_2) || segment_1.segments_overloap(segment_2);
+    }
+};
+
+template <typename T>
+struct pair_kernel_t<segment_t<T>, triangle_t<T>> {
+    static bool intersect(const segment_t<T>& segment, const triangle_t<T>& triangle) {
+        return triangle.triangle_intersect_segment(segment);
+    }
+};
+
+// Two triangles are decided exactly, for any T
+template <typename T>
+struct pair_kernel_t<triangle_t<T>, triangle_t<T>> {
+    static bool intersect(const triangle_t<T>& triangle_1, const triangle_t<T>& triangle_2) {
+        return triangles_intersect_exactly(triangle_1, triangle_2);
+    }
+};
+
+template <typename T>
+bool check_figures_intersection(const polygon_t<T>& first, const polygon_t<T>& second);
+
+// check_figures_intersection of a point or a segment of a narrower type than double:
+// the tests with a tolerance are done in double on the same vertices
+template <typename T>
+bool check_figures_intersection_in_double(const polygon_t<T>& first, const polygon_t<T>& second) {
+    polygon_t<double> first_in_double = convert_polygon<double>(first);
+    polygon_t<double> second_in_double = convert_polygon<double>(second);
+
+    return !boxes_are_apart(first_in_double, second_in_double) &&
+           check_figures_intersection(first_in_double, second_in_double);
+}
+
+// std::visit over both primitives is a table of pair kernels built at compile time,
+// one indirect call instead of two switches
+template <typename T>
+bool check_figures_intersection(const polygon_t<T>& first, const polygon_t<T>& second) {
+    if constexpr (!std::is_same_v<T, double>) {
+        if (first.index() != 2 || second.index() != 2)
+            return check_figures_intersection_in_double(first, second);
+    }
+
+    return std::visit([](const auto& first_primitive, const auto& second_primitive) {
+        using first_t  = std::decay_t<decltype(first_primitive)>;
+        using second_t = std::decay_t<decltype(second_primitive)>;
+        return pair_kernel_t<first_t, second_t>::intersect(first_primitive, second_primitive);
+    }, first, second);
 }
 
 } // namespace Geom_objects
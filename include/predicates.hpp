@@ -0,0 +1,322 @@
+#ifndef PREDICATES_HPP
+#define PREDICATES_HPP
+
+#include <array>
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <span>
+
+namespace Predicates {
+
+// Orientation predicates after J. R. Shewchuk, "Adaptive Precision Floating-Point Arithmetic
+// and Fast Robust Geometric Predicates". The determinant is computed in double first; if it is
+// farther from zero than the bound of its rounding error, its sign is the exact sign. Otherwise
+// the determinant is computed again exactly, as a sum of doubles that don't overlap (an expansion).
+// The intermediate stages B and C of the paper are left out: the exact stage is rare here.
+//
+// Error bounds hold only if every product and sum is rounded on its own, a * b + c must not
+// be fused (see CMakeLists.txt).
+
+// Half of the distance from 1.0 to the next double
+inline constexpr double unit_roundoff = 0x1p-53;
+
+inline constexpr double orient2d_error_bound = (3.0 + 16.0 * unit_roundoff) * unit_roundoff;
+inline constexpr double orient3d_error_bound = (7.0 + 56.0 * unit_roundoff) * unit_roundoff;
+
+// Error-free transformations: x is the rounded result, y the rounding error, x + y is exact
+
+// Requires |a| >= |b|
+inline void fast_two_sum(double a, double b, double& x, double& y) {
+    x = a + b;
+    double b_virtual = x - a;
+    y = b - b_virtual;
+}
+
+inline void two_sum(double a, double b, double& x, double& y) {
+    x = a + b;
+    double b_virtual = x - a;
+    double a_virtual = x - b_virtual;
+    y = (a - a_virtual) + (b - b_virtual);
+}
+
+// a = high + low, both halves with at most 26 significant bits
+inline void split(double a, double& high, double& low) {
+    constexpr double splitter = 0x1p27 + 1.0;
+    double c = splitter * a;
+    high = c - (c - a);
+    low = a - high;
+}
+
+inline void two_product(double a, double b, double& x, double& y) {
+    x = a * b;
+
+    double a_high, a_low, b_high, b_low;
+    split(a, a_high, a_low);
+    split(b, b_high, b_low);
+
+    double error = x - a_high * b_high;
+    error -= a_low * b_high;
+    error -= a_high * b_low;
+    y = a_low * b_low - error;
+}
+
+// Sum of terms[0, size) ordered by magnitude, no two of them overlap, no zeros except
+// a single zero for an empty sum. The last term has the sign of the sum.
+template <size_t N>
+struct expansion_t {
+    std::array<double, N> terms;
+    size_t size = 0;
+
+    double get_most_significant() const { return terms[size - 1]; }
+};
+
+inline expansion_t<2> make_product(double a, double b) {
+    expansion_t<2> product;
+    two_product(a, b, product.terms[1], product.terms[0]);
+    product.size = 2;
+    return product;
+}
+
+// expansion + value, Shewchuk's grow_expansion_zeroelim
+template <size_t N>
+expansion_t<N + 1> grow(const expansion_t<N>& expansion, double value) {
+    expansion_t<N + 1> sum;
+    double accumulated = value;
+    for (size_t number = 0; number < expansion.size; ++number) {
+        double rounded, error;
+        two_sum(accumulated, expansion.terms[number], rounded, error);
+        accumulated = rounded;
+        if (error != 0.0)
+            sum.terms[sum.size++] = error;
+    }
+
+    if (accumulated != 0.0 || sum.size == 0)
+        sum.terms[sum.size++] = accumulated;
+    return sum;
+}
+
+// Term by term, the expansions here have a few dozen terms at most
+template <size_t N, size_t M>
+expansion_t<N + M> add(const expansion_t<N>& first, const expansion_t<M>& second) {
+    expansion_t<N + M> sum;
+    sum.terms[0] = 0.0;
+    sum.size = 1;
+    for (size_t number = 0; number < first.size; ++number) {
+        auto grown = grow(sum, first.terms[number]);
+        std::copy(grown.terms.begin(), grown.terms.begin() + static_cast<std::ptrdiff_t>(grown.size), sum.terms.begin());
+        sum.size = grown.size;
+    }
+
+    for (size_t number = 0; number < second.size; ++number) {
+        auto grown = grow(sum, second.terms[number]);
+        std::copy(grown.terms.begin(), grown.terms.begin() + static_cast<std::ptrdiff_t>(grown.size), sum.terms.begin());
+        sum.size = grown.size;
+    }
+
+    return sum;
+}
+
+template <size_t N>
+expansion_t<N> negate(expansion_t<N> expansion) {
+    for (size_t number = 0; number < expansion.size; ++number)
+        expansion.terms[number] = -expansion.terms[number];
+    return expansion;
+}
+
+// expansion * value, Shewchuk's scale_expansion_zeroelim
+template <size_t N>
+expansion_t<2 * N> scale(const expansion_t<N>& expansion, double value) {
+    expansion_t<2 * N> product;
+
+    double accumulated, error;
+    two_product(expansion.terms[0], value, accumulated, error);
+    if (error != 0.0)
+        product.terms[product.size++] = error;
+
+    for (size_t number = 1; number < expansion.size; ++number) {
+        double high, low, sum;
+        two_product(expansion.terms[number], value, high, low);
+        two_sum(accumulated, low, sum, error);
+        if (error != 0.0)
+            product.terms[product.size++] = error;
+
+        fast_two_sum(high, sum, accumulated, error);
+        if (error != 0.0)
+            product.terms[product.size++] = error;
+    }
+
+    if (accumulated != 0.0 || product.size == 0)
+        product.terms[product.size++] = accumulated;
+    return product;
+}
+
+// Expansions are exact only while products of three coordinates stay in the range of double.
+// Orientations don't change when all coordinates are scaled by one power of two, so larger
+// coordinates are scaled down; the scaling is exact unless tiny ones become subnormal.
+inline constexpr int largest_exact_exponent = 320;
+
+// False for infinite or NaN coordinates, they have no orientation
+inline bool scale_to_exact_range(std::span<double> coordinates) {
+    double largest = 0.0;
+    for (double coordinate : coordinates)
+        largest = std::max(largest, std::fabs(coordinate));
+
+    if (!std::isfinite(largest))
+        return false;
+
+    if (largest == 0.0 || std::ilogb(largest) <= largest_exact_exponent)
+        return true;
+
+    int shift = largest_exact_exponent - std::ilogb(largest);
+    for (double& coordinate : coordinates)
+        coordinate = std::ldexp(coordinate, shift);
+    return true;
+}
+
+// first_x * second_y - second_x * first_y exactly
+inline expansion_t<4> cross(double first_x, double first_y, double second_x, double second_y) {
+    return add(make_product(first_x, second_y), negate(make_product(second_x, first_y)));
+}
+
+// Exact orient2d: a sum of three exact 2x2 minors of the coordinates themselves
+inline double orient2d_exact(double ax, double ay, double bx, double by, double cx, double cy) {
+    std::array<double, 6> points{ax, ay, bx, by, cx, cy};
+    if (!scale_to_exact_range(points))
+        return 0.0;
+
+    const auto [x_a, y_a, x_b, y_b, x_c, y_c] = points;
+    auto sum = add(add(cross(x_a, y_a, x_b, y_b), cross(x_b, y_b, x_c, y_c)), cross(x_c, y_c, x_a, y_a));
+    return sum.get_most_significant();
+}
+
+// Positive if a, b, c go counterclockwise, negative if clockwise, zero if they are collinear.
+// The value is twice the signed area of the triangle, approximately; only the sign is exact.
+inline double orient2d(double ax, double ay, double bx, double by, double cx, double cy) {
+    double left  = (ax - cx) * (by - cy);
+    double right = (ay - cy) * (bx - cx);
+    double determinant = left - right;
+
+    // Products of different signs: no cancellation, the sign is right
+    double magnitude;
+    if (left > 0.0) {
+        if (right <= 0.0)
+            return determinant;
+        magnitude = left + right;
+    } else if (left < 0.0) {
+        if (right >= 0.0)
+            return determinant;
+        magnitude = -left - right;
+    } else {
+        return determinant;
+    }
+
+    double error_bound = orient2d_error_bound * magnitude;
+    if (determinant >= error_bound || -determinant >= error_bound)
+        return determinant;
+
+    return orient2d_exact(ax, ay, bx, by, cx, cy);
+}
+
+// Exact orient3d, Shewchuk's orient3dexact: 2x2 minors of x and y of every two points,
+// 3x3 minors as their sums, then the expansion by z
+inline double orient3d_exact(std::array<double, 3> a, std::array<double, 3> b,
+                             std::array<double, 3> c, std::array<double, 3> d) {
+    std::array<double, 12> points;
+    std::ranges::copy(a, points.begin());
+    std::ranges::copy(b, points.begin() + 3);
+    std::ranges::copy(c, points.begin() + 6);
+    std::ranges::copy(d, points.begin() + 9);
+    if (!scale_to_exact_range(points))
+        return 0.0;
+
+    std::copy_n(points.begin(), 3, a.begin());
+    std::copy_n(points.begin() + 3, 3, b.begin());
+    std::copy_n(points.begin() + 6, 3, c.begin());
+    std::copy_n(points.begin() + 9, 3, d.begin());
+
+    auto ab = cross(a[0], a[1], b[0], b[1]);
+    auto bc = cross(b[0], b[1], c[0], c[1]);
+    auto cd = cross(c[0], c[1], d[0], d[1]);
+    auto da = cross(d[0], d[1], a[0], a[1]);
+    auto ac = cross(a[0], a[1], c[0], c[1]);
+    auto bd = cross(b[0], b[1], d[0], d[1]);
+
+    auto cda = add(add(cd, da), ac);
+    auto dab = add(add(da, ab), bd);
+    auto abc = add(add(ab, bc), negate(ac));
+    auto bcd = add(add(bc, cd), negate(bd));
+
+    auto a_part = scale(bcd, a[2]);
+    auto b_part = scale(cda, -b[2]);
+    auto c_part = scale(dab, c[2]);
+    auto d_part = scale(abc, -d[2]);
+
+    return add(add(a_part, b_part), add(c_part, d_part)).get_most_significant();
+}
+
+// Positive if d is below the plane through a, b, c (a, b, c go counterclockwise seen from above),
+// negative if above, zero if the four points are coplanar. The value is the determinant of the
+// rows a - d, b - d, c - d, approximately; only the sign is exact.
+inline double orient3d(const std::array<double, 3>& a, const std::array<double, 3>& b,
+                       const std::array<double, 3>& c, const std::array<double, 3>& d) {
+    double adx = a[0] - d[0], bdx = b[0] - d[0], cdx = c[0] - d[0];
+    double ady = a[1] - d[1], bdy = b[1] - d[1], cdy = c[1] - d[1];
+    double adz = a[2] - d[2], bdz = b[2] - d[2], cdz = c[2] - d[2];
+
+    double bdx_cdy = bdx * cdy, cdx_bdy = cdx * bdy;
+    double cdx_ady = cdx * ady, adx_cdy = adx * cdy;
+    double adx_bdy = adx * bdy, bdx_ady = bdx * ady;
+
+    double determinant = adz * (bdx_cdy - cdx_bdy) + bdz * (cdx_ady - adx_cdy) + cdz * (adx_bdy - bdx_ady);
+
+    double permanent = (std::fabs(bdx_cdy) + std::fabs(cdx_bdy)) * std::fabs(adz) +
+                       (std::fabs(cdx_ady) + std::fabs(adx_cdy)) * std::fabs(bdz) +
+                       (std::fabs(adx_bdy) + std::fabs(bdx_ady)) * std::fabs(cdz);
+
+    double error_bound = orient3d_error_bound * permanent;
+    if (determinant > error_bound || -determinant > error_bound)
+        return determinant;
+
+    return orient3d_exact(a, b, c, d);
+}
+
+// orient3d(a, b, point, d) for three points at once. The rows a - d and b - d and their products
+// are shared, every value is computed by the same operations as orient3d, so signs are the same.
+inline std::array<double, 3> orient3d(const std::array<double, 3>& a, const std::array<double, 3>& b,
+                                      const std::array<const std::array<double, 3>*, 3>& points,
+                                      const std::array<double, 3>& d) {
+    double adx = a[0] - d[0], bdx = b[0] - d[0];
+    double ady = a[1] - d[1], bdy = b[1] - d[1];
+    double adz = a[2] - d[2], bdz = b[2] - d[2];
+
+    double adx_bdy = adx * bdy, bdx_ady = bdx * ady;
+    double abd_minor = adx_bdy - bdx_ady;
+    double abd_permanent = std::fabs(adx_bdy) + std::fabs(bdx_ady);
+
+    std::array<double, 3> orientations;
+    for (size_t number = 0; number < 3; ++number) {
+        const std::array<double, 3>& c = *points[number];
+        double cdx = c[0] - d[0], cdy = c[1] - d[1], cdz = c[2] - d[2];
+
+        double bdx_cdy = bdx * cdy, cdx_bdy = cdx * bdy;
+        double cdx_ady = cdx * ady, adx_cdy = adx * cdy;
+
+        double determinant = adz * (bdx_cdy - cdx_bdy) + bdz * (cdx_ady - adx_cdy) + cdz * abd_minor;
+
+        double permanent = (std::fabs(bdx_cdy) + std::fabs(cdx_bdy)) * std::fabs(adz) +
+                           (std::fabs(cdx_ady) + std::fabs(adx_cdy)) * std::fabs(bdz) +
+                           abd_permanent * std::fabs(cdz);
+
+        double error_bound = orient3d_error_bound * permanent;
+        orientations[number] = determinant > error_bound || -determinant > error_bound
+                                   ? determinant
+                                   : orient3d_exact(a, b, c, d);
+    }
+
+    return orientations;
+}
+
+} // namespace Predicates
+
+#endif // PREDICATES_HPP
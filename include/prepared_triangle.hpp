@@ -0,0 +1,37 @@
+#ifndef PREPARED_TRIANGLE_HPP
+#define PREPARED_TRIANGLE_HPP
+
+#include <array>
+
+#include "point.hpp"
+#include "vector.hpp"
+#include "plane.hpp"
+#include "polygons.hpp"
+
+namespace Geom_objects {
+
+// What the separating axes of a triangle against boxes are built from, besides its vertices.
+// Computed once, when the triangle is put into primitive_store_t, instead of for every box
+// it is tested against. The tight box of the vertices is the one the store keeps anyway.
+template <typename T>
+struct prepared_triangle_t {
+    vector_t<T> normal;               // unit normal of plane_t through a, b, c
+    std::array<vector_t<T>, 3> edges; // b - a, c - b, a - c, like segments of triangle_t
+};
+
+template <typename T>
+prepared_triangle_t<T> prepare_triangle(const point_t<T>& a, const point_t<T>& b, const point_t<T>& c) {
+    prepared_triangle_t<T> triangle;
+    triangle.normal = plane_t<T>{a, b, c}.get_normal_vector().get_normalized();
+    triangle.edges  = {b - a, c - b, a - c};
+    return triangle;
+}
+
+template <typename T>
+prepared_triangle_t<T> prepare_triangle(const triangle_t<T>& triangle) {
+    return prepare_triangle(triangle.get_a(), triangle.get_b(), triangle.get_c());
+}
+
+} // namespace Geom_objects
+
+#endif // PREPARED_TRIANGLE_HPP
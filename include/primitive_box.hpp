@@ -0,0 +1,50 @@
+#ifndef PRIMITIVE_BOX_HPP
+#define PRIMITIVE_BOX_HPP
+
+#include <array>
+#include <algorithm>
+
+#include "double_compare.hpp"
+#include "primitive_store.hpp"
+
+namespace Broad_phase {
+
+template <typename T>
+using index_t = typename Geom_objects::primitive_store_t<T>::index_t;
+
+// Box of one primitive, widened by the tolerance of the exact tests
+template <typename T>
+struct primitive_box_t {
+    std::array<T, 3> min;
+    std::array<T, 3> max;
+    size_t           number; // in the input
+};
+
+// Box of x, y, z of three points stored one after another. Points and segments
+// are bounded by the same three points as the triangle they come from.
+template <typename T, typename S>
+primitive_box_t<T> make_primitive_box(const S* points, size_t number) {
+    const T tolerance = Compare::epsilon_v<T>;
+
+    primitive_box_t<T> box;
+    box.number = number;
+    for (size_t axis = 0; axis < 3; ++axis) {
+        T first = static_cast<T>(points[axis]), second = static_cast<T>(points[3 + axis]),
+          third = static_cast<T>(points[6 + axis]);
+        box.min[axis] = std::min({first, second, third}) - tolerance;
+        box.max[axis] = std::max({first, second, third}) + tolerance;
+    }
+
+    return box;
+}
+
+template <typename Box>
+bool boxes_overlap(const Box& first, const Box& second) {
+    return first.min[0] <= second.max[0] && second.min[0] <= first.max[0] &&
+           first.min[1] <= second.max[1] && second.min[1] <= first.max[1] &&
+           first.min[2] <= second.max[2] && second.min[2] <= first.max[2];
+}
+
+} // namespace Broad_phase
+
+#endif // PRIMITIVE_BOX_HPP
@@ -0,0 +1,165 @@
+#ifndef PRIMITIVE_STORE_HPP
+#define PRIMITIVE_STORE_HPP
+
+#include <vector>
+#include <array>
+#include <algorithm>
+#include <cstdint>
+#include <limits>
+#include <stdexcept>
+#include <variant>
+#include <initializer_list>
+#include <cassert>
+
+#include "point.hpp"
+#include "segment.hpp"
+#include "triangle.hpp"
+#include "polygons.hpp"
+#include "prepared_triangle.hpp"
+
+namespace Geom_objects {
+
+// Same order as alternatives of polygon_t
+enum class primitive_kind_t : uint8_t {
+    point    = 0,
+    segment  = 1,
+    triangle = 2
+};
+
+// Structure of arrays over all primitives of a scene. Every primitive keeps three vertices:
+// a point repeats itself, a segment repeats its end point, so code that only needs
+// vertices doesn't look at the kind. Primitives are addressed by 32-bit indices equal to
+// their numbers in the input. Triangles are also kept prepared for box tests.
+template <typename T>
+class primitive_store_t {
+    public:
+    using index_t = uint32_t;
+
+    static constexpr size_t vertices_in_primitive = 3;
+
+    private:
+    std::vector<T> x_, y_, z_;
+    std::vector<prepared_triangle_t<T>> triangles_; // default ones for points and segments
+    std::vector<packed_box_t<T>> boxes_;
+    std::vector<primitive_kind_t> kinds_;
+
+    public:
+    void reserve(size_t number_of_primitives) {
+        x_.reserve(number_of_primitives * vertices_in_primitive);
+        y_.reserve(number_of_primitives * vertices_in_primitive);
+        z_.reserve(number_of_primitives * vertices_in_primitive);
+        triangles_.reserve(number_of_primitives);
+        boxes_.reserve(number_of_primitives);
+        kinds_.reserve(number_of_primitives);
+    }
+
+    // Grows the store by default primitives that are replaced by set()
+    void resize(size_t number_of_primitives) {
+        if (number_of_primitives > std::numeric_limits<index_t>::max())
+            throw std::length_error("too many primitives for 32-bit indices");
+
+        x_.resize(number_of_primitives * vertices_in_primitive);
+        y_.resize(number_of_primitives * vertices_in_primitive);
+        z_.resize(number_of_primitives * vertices_in_primitive);
+        triangles_.resize(number_of_primitives);
+        boxes_.resize(number_of_primitives);
+        kinds_.resize(number_of_primitives);
+    }
+
+    index_t add(const polygon_t<T>& polygon) {
+        index_t index = static_cast<index_t>(kinds_.size());
+        resize(kinds_.size() + 1);
+        set(index, polygon);
+
+        return index;
+    }
+
+    // Different indices may be set from different threads
+    void set(index_t index, const polygon_t<T>& polygon) {
+        switch (polygon.index()) {
+            case 0: { // point_t
+                const auto& point = std::get<point_t<T>>(polygon);
+                set_vertices(index, point, point, point);
+                triangles_[index] = {};
+                kinds_[index]  = primitive_kind_t::point;
+                break;
+            }
+
+            case 1: { // segment_t
+                const auto& segment = std::get<segment_t<T>>(polygon);
+                set_vertices(index, segment.get_beg_point(), segment.get_end_point(), segment.get_end_point());
+                triangles_[index] = {};
+                kinds_[index]  = primitive_kind_t::segment;
+                break;
+            }
+
+            case 2: { // triangle_t
+                const auto& triangle = std::get<triangle_t<T>>(polygon);
+                set_vertices(index, triangle.get_a(), triangle.get_b(), triangle.get_c());
+                triangles_[index] = prepare_triangle(triangle);
+                kinds_[index]  = primitive_kind_t::triangle;
+                break;
+            }
+        }
+    }
+
+    size_t size() const { return kinds_.size(); }
+
+    primitive_kind_t       get_kind(index_t index)   const { return kinds_[index]; }
+    const packed_box_t<T>& get_box(index_t index)    const { return boxes_[index]; }
+    size_t                 get_number(index_t index) const { return index; }
+
+    // Only for triangles
+    const prepared_triangle_t<T>& get_prepared_triangle(index_t index) const { return triangles_[index]; }
+
+    // vertex < vertices_in_primitive
+    T get_x(index_t index, size_t vertex) const { return x_[index * vertices_in_primitive + vertex]; }
+    T get_y(index_t index, size_t vertex) const { return y_[index * vertices_in_primitive + vertex]; }
+    T get_z(index_t index, size_t vertex) const { return z_[index * vertices_in_primitive + vertex]; }
+
+    point_t<T> get_vertex(index_t index, size_t vertex) const {
+        return {get_x(index, vertex), get_y(index, vertex), get_z(index, vertex), get_number(index)};
+    }
+
+    // Rebuilds the object for exact tests, the same as the one that was added
+    polygon_t<T> get_polygon(index_t index) const {
+        switch (kinds_[index]) {
+            case primitive_kind_t::point:
+                return get_vertex(index, 0);
+
+            case primitive_kind_t::segment:
+                return segment_t<T>{get_vertex(index, 0), get_vertex(index, 1), get_number(index)};
+
+            case primitive_kind_t::triangle:
+                return triangle_t<T>{get_vertex(index, 0), get_vertex(index, 1), get_vertex(index, 2),
+                                     get_number(index)};
+        }
+
+        assert(0 && "unknown primitive kind");
+        return point_t<T>{};
+    }
+
+    size_t get_allocated_bytes() const {
+        return (x_.capacity() + y_.capacity() + z_.capacity()) * sizeof(T) +
+               triangles_.capacity() * sizeof(prepared_triangle_t<T>) +
+               boxes_.capacity() * sizeof(packed_box_t<T>) +
+               kinds_.capacity() * sizeof(primitive_kind_t);
+    }
+
+    private:
+    void set_vertices(index_t index, const point_t<T>& a, const point_t<T>& b, const point_t<T>& c) {
+        size_t vertex = index * vertices_in_primitive;
+        for (const point_t<T>* point : {&a, &b, &c}) {
+            x_[vertex] = point->get_x();
+            y_[vertex] = point->get_y();
+            z_[vertex] = point->get_z();
+            ++vertex;
+        }
+
+        boxes_[index] = make_box(a, b, c);
+    }
+};
+
+} // namespace Geom_objects
+
+#endif // PRIMITIVE_STORE_HPP
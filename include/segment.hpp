@@ -23,9 +23,9 @@ class segment_t {
           directing_vector_{directing_vector}, number_{number} {}
 
     public:
-    point_t<T>  get_beg_point()  const { return beg_point_; }
-    point_t<T>  get_end_point()  const { return end_point_; }
-    vector_t<T> get_dir_vector() const { return directing_vector_; }
+    const point_t<T>&  get_beg_point()  const { return beg_point_; }
+    const point_t<T>&  get_end_point()  const { return end_point_; }
+    const vector_t<T>& get_dir_vector() const { return directing_vector_; }
     size_t      get_number()     const { return number_; }
 
     T get_length() const {
@@ -0,0 +1,211 @@
+#ifndef SWEEP_AND_PRUNE_HPP
+#define SWEEP_AND_PRUNE_HPP
+
+#include <vector>
+#include <array>
+#include <span>
+#include <algorithm>
+#include <cstdint>
+
+#include "polygons.hpp"
+#include "primitive_store.hpp"
+#include "primitive_box.hpp"
+#include "thread_pool.hpp"
+#include "triangle_batch.hpp"
+#include "intersection_bitset.hpp"
+
+namespace Broad_phase {
+
+template <typename T>
+class sweep_and_prune_t;
+
+template <typename T>
+class sweep_detector_of_collisions_t {
+    private:
+    // Primitives after the current one in the sweep with overlapping boxes, tested as one batch
+    Geom_objects::store_batch_t<T> candidates_;
+    size_t number_of_candidates_ = 0;
+
+    public:
+    size_t get_number_of_candidates() const { return number_of_candidates_; }
+
+    // Primitives [begin, end) of the sorted order against the ones after them whose boxes
+    // overlap theirs. Pairs of two primitives already found intersecting something are
+    // counted, but not tested.
+    template <typename Result>
+    void intersect_sorted_polygons(const sweep_and_prune_t<T>& sweep, size_t begin, size_t end, Result& result) {
+        const auto& boxes = sweep.get_boxes();
+        const auto& store = sweep.get_store();
+        const size_t axis = sweep.get_sweep_axis();
+        const size_t axis_1 = (axis + 1) % 3, axis_2 = (axis + 2) % 3;
+
+        for (size_t number_1 = begin; number_1 < end; ++number_1) {
+            const auto& box = boxes[number_1];
+            bool polygon_is_found = result.is_found(box.number);
+
+            candidates_.clear();
+
+            // Boxes are sorted by min on the sweep axis, so the first one starting
+            // after this box ends closes the sweep
+            for (size_t number_2 = number_1 + 1; number_2 < boxes.size(); ++number_2) {
+                const auto& other = boxes[number_2];
+                if (other.min[axis] > box.max[axis])
+                    break;
+
+                if (other.min[axis_1] > box.max[axis_1] || other.max[axis_1] < box.min[axis_1] ||
+                    other.min[axis_2] > box.max[axis_2] || other.max[axis_2] < box.min[axis_2])
+                    continue;
+
+                ++number_of_candidates_;
+                if (!polygon_is_found || !result.is_found(other.number))
+                    candidates_.push_back(store, static_cast<index_t<T>>(number_2));
+            }
+
+            if (candidates_.size() == 0)
+                continue;
+
+            candidates_.intersect(store, static_cast<index_t<T>>(number_1), [&](index_t<T> candidate) {
+                result.insert_pair(box.number, boxes[candidate].number);
+            });
+        }
+    }
+};
+
+// Broad phase without a tree: boxes of all primitives are sorted along the axis where
+// their centers spread most, and every box is compared only with the boxes that start
+// before it ends. Unlike the octree, big and long primitives cost no more than small ones;
+// primitives piled up along the sweep axis are its worst case, they are all compared.
+template <typename T>
+class sweep_and_prune_t {
+    public:
+    // Sorted primitives are split into parts of this size for parallel detection
+    static constexpr size_t polygons_per_task   = 256;
+    static constexpr size_t parallel_build_size = 4096;
+
+    private:
+    // Both in the sweep order: candidates of a primitive lie right after it in the store.
+    // Indices in the store are places in the order, numbers in the input are in the boxes.
+    std::vector<primitive_box_t<T>> boxes_; // sorted by min on sweep_axis_
+    Geom_objects::primitive_store_t<T> store_;
+
+    size_t sweep_axis_ = 0;
+    size_t number_of_candidates_ = 0;
+    sweep_detector_of_collisions_t<T> detector_of_collisions_;
+
+    public:
+    // Nine coordinates per triangle
+    template <typename S>
+    explicit sweep_and_prune_t(std::span<const S> coordinates) {
+        boxes_.resize(coordinates.size() / coordinates_per_triangle);
+        set_boxes(coordinates, 0, boxes_.size());
+        sort_boxes();
+
+        store_.resize(boxes_.size());
+        set_primitives(coordinates, 0, boxes_.size());
+    }
+
+    template <typename S>
+    sweep_and_prune_t(std::span<const S> coordinates, Parallel::thread_pool_t& thread_pool) {
+        boxes_.resize(coordinates.size() / coordinates_per_triangle);
+        thread_pool.parallel_for(0, boxes_.size(), parallel_build_size, [&](size_t begin, size_t end) {
+            set_boxes(coordinates, begin, end);
+        });
+        sort_boxes();
+
+        store_.resize(boxes_.size());
+        thread_pool.parallel_for(0, boxes_.size(), parallel_build_size, [&](size_t begin, size_t end) {
+            set_primitives(coordinates, begin, end);
+        });
+    }
+
+    const Geom_objects::primitive_store_t<T>& get_store()      const { return store_; }
+    const std::vector<primitive_box_t<T>>&    get_boxes()      const { return boxes_; }
+    size_t                                    get_sweep_axis() const { return sweep_axis_; }
+
+    // Pairs of primitives with overlapping boxes tested by the last query
+    size_t get_number_of_candidates() const { return number_of_candidates_; }
+
+    size_t get_allocated_bytes() const { return boxes_.capacity() * sizeof(primitive_box_t<T>); }
+
+    // One sweep over all of the sorted boxes
+    template <typename Result>
+    void get_number_of_intersections(Result& result) {
+        size_t candidates_before = detector_of_collisions_.get_number_of_candidates();
+        detector_of_collisions_.intersect_sorted_polygons(*this, 0, boxes_.size(), result);
+        number_of_candidates_ = detector_of_collisions_.get_number_of_candidates() - candidates_before;
+    }
+
+    // Parts of the sorted order are swept by workers, each with its own detector: a box meets
+    // only the boxes after it, so parts never test the same pair
+    template <typename Result>
+    void get_number_of_intersections(Result& result, Parallel::thread_pool_t& thread_pool) {
+        std::vector<sweep_detector_of_collisions_t<T>> detectors(thread_pool.get_number_of_threads());
+
+        thread_pool.submit([&] {
+            thread_pool.parallel_for(0, boxes_.size(), polygons_per_task, [&](size_t begin, size_t end) {
+                size_t worker = thread_pool.get_current_worker();
+                detectors[worker].intersect_sorted_polygons(*this, begin, end, result);
+            });
+        });
+        thread_pool.wait();
+
+        number_of_candidates_ = 0;
+        for (const auto& detector : detectors)
+            number_of_candidates_ += detector.get_number_of_candidates();
+    }
+
+    private:
+    static constexpr size_t coordinates_per_triangle = 9;
+
+    template <typename S>
+    void set_boxes(std::span<const S> coordinates, size_t begin, size_t end) {
+        for (size_t number = begin; number < end; ++number)
+            boxes_[number] = make_primitive_box<T>(coordinates.data() + number * coordinates_per_triangle, number);
+    }
+
+    template <typename S>
+    void set_primitives(std::span<const S> coordinates, size_t begin, size_t end) {
+        for (size_t place = begin; place < end; ++place) {
+            size_t number = boxes_[place].number;
+            store_.set(static_cast<index_t<T>>(place), Geom_objects::make_geometric_primitive<T>(
+                                                          coordinates.data() + number * coordinates_per_triangle,
+                                                          number));
+        }
+    }
+
+    // The axis with the biggest variance of box centers separates boxes best
+    void sort_boxes() {
+        if (boxes_.empty())
+            return;
+
+        std::array<double, 3> sum{}, sum_of_squares{};
+        for (const auto& box : boxes_) {
+            for (size_t axis = 0; axis < 3; ++axis) {
+                double center = (static_cast<double>(box.min[axis]) + static_cast<double>(box.max[axis])) / 2;
+                sum[axis] += center;
+                sum_of_squares[axis] += center * center;
+            }
+        }
+
+        double number_of_boxes = static_cast<double>(boxes_.size());
+        double max_variance = -1;
+        for (size_t axis = 0; axis < 3; ++axis) {
+            double mean = sum[axis] / number_of_boxes;
+            double variance = sum_of_squares[axis] / number_of_boxes - mean * mean;
+            if (variance > max_variance) {
+                max_variance = variance;
+                sweep_axis_ = axis;
+            }
+        }
+
+        std::sort(boxes_.begin(), boxes_.end(), [axis = sweep_axis_](const auto& first, const auto& second) {
+            if (first.min[axis] != second.min[axis])
+                return first.min[axis] < second.min[axis];
+            return first.number < second.number;
+        });
+    }
+};
+
+} // namespace Broad_phase
+
+#endif // SWEEP_AND_PRUNE_HPP
@@ -0,0 +1,260 @@
+#ifndef THREAD_POOL_HPP
+#define THREAD_POOL_HPP
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <exception>
+#include <limits>
+#include <algorithm>
+#include <cstdint>
+
+namespace Parallel {
+
+// Every worker has its own deque: it takes tasks from the back of it and steals from
+// the front of the others' when it is empty. Tasks may submit new tasks.
+class thread_pool_t {
+    public:
+    using task_t = std::function<void()>;
+
+    static constexpr size_t not_a_worker = std::numeric_limits<size_t>::max();
+
+    private:
+    struct worker_queue_t {
+        std::mutex         mutex;
+        std::deque<task_t> tasks;
+    };
+
+    std::vector<std::unique_ptr<worker_queue_t>> queues_;
+    std::vector<std::thread> threads_;
+
+    std::atomic<size_t> queued_tasks_  = 0; // waiting in queues
+    std::atomic<size_t> pending_tasks_ = 0; // submitted and not finished
+    std::atomic<size_t> next_queue_    = 0; // for tasks from outside of the pool
+    std::atomic<bool>   stop_          = false;
+
+    // Changes on every submit, idle workers sleep on it
+    std::atomic<uint32_t> wake_up_epoch_ = 0;
+
+    std::mutex         exception_mutex_;
+    std::exception_ptr exception_;
+
+    static inline thread_local const thread_pool_t* current_pool_ = nullptr;
+    static inline thread_local size_t current_worker_ = not_a_worker;
+
+    public:
+    // 0 means one thread per hardware thread
+    explicit thread_pool_t(size_t number_of_threads) {
+        if (number_of_threads == 0)
+            number_of_threads = std::max(1u, std::thread::hardware_concurrency());
+
+        for (size_t worker = 0; worker < number_of_threads; ++worker)
+            queues_.push_back(std::make_unique<worker_queue_t>());
+
+        for (size_t worker = 0; worker < number_of_threads; ++worker)
+            threads_.emplace_back([this, worker] { work(worker); });
+    }
+
+    thread_pool_t(const thread_pool_t& other) = delete;
+    thread_pool_t& operator=(const thread_pool_t& other) = delete;
+
+    ~thread_pool_t() {
+        stop_.store(true);
+        wake_up_epoch_.fetch_add(1);
+        wake_up_epoch_.notify_all();
+
+        for (auto& thread : threads_)
+            thread.join();
+    }
+
+    size_t get_number_of_threads() const { return threads_.size(); }
+
+    // Index of the worker running the caller, not_a_worker outside of the pool
+    size_t get_current_worker() const {
+        return current_pool_ == this ? current_worker_ : not_a_worker;
+    }
+
+    void submit(task_t task) {
+        size_t worker = get_current_worker();
+        if (worker == not_a_worker)
+            worker = next_queue_.fetch_add(1, std::memory_order_relaxed) % queues_.size();
+
+        {
+            // Counted after the push, which may throw; nobody pops the task before the unlock
+            std::lock_guard lock{queues_[worker]->mutex};
+            queues_[worker]->tasks.push_back(std::move(task));
+            pending_tasks_.fetch_add(1);
+            queued_tasks_.fetch_add(1);
+        }
+
+        // A worker that has seen the old epoch and empty queues won't fall asleep
+        wake_up_epoch_.fetch_add(1);
+        wake_up_epoch_.notify_one();
+    }
+
+    // Waits for all submitted tasks including the ones they submitted,
+    // rethrows the first exception thrown by a task
+    void wait() {
+        size_t pending_tasks = pending_tasks_.load();
+        while (pending_tasks != 0) {
+            pending_tasks_.wait(pending_tasks);
+            pending_tasks = pending_tasks_.load();
+        }
+
+        std::lock_guard lock{exception_mutex_};
+        if (exception_) {
+            std::exception_ptr exception = exception_;
+            exception_ = nullptr;
+            std::rethrow_exception(exception);
+        }
+    }
+
+    // Calls function(part_begin, part_end) for parts of [begin, end) of at most part_size elements
+    // and returns when all of them are done. A worker runs pool tasks while waiting, so it may
+    // be called from a task. If parts throw, the first exception is rethrown after all parts end.
+    template <typename Function>
+    void parallel_for(size_t begin, size_t end, size_t part_size, Function&& function) {
+        if (begin >= end)
+            return;
+
+        // Parts refer to this stack frame, so it is never left before all of them are done
+        struct parts_state_t {
+            std::atomic<size_t> remaining_parts;
+            std::mutex          exception_mutex;
+            std::exception_ptr  exception;
+
+            void keep_exception(std::exception_ptr exception_of_part) {
+                std::lock_guard lock{exception_mutex};
+                if (!exception)
+                    exception = exception_of_part;
+            }
+        } state{(end - begin + part_size - 1) / part_size, {}, {}};
+
+        // The decrement is the last touch of the state by a part, whatever the part did
+        struct part_guard_t {
+            std::atomic<size_t>& remaining_parts;
+            ~part_guard_t() { remaining_parts.fetch_sub(1); }
+        };
+
+        auto run_part = [&function, &state](size_t part_begin, size_t part_end) {
+            part_guard_t guard{state.remaining_parts};
+            try {
+                function(part_begin, part_end);
+            } catch (...) {
+                state.keep_exception(std::current_exception());
+            }
+        };
+
+        for (size_t part_begin = begin + part_size; part_begin < end; part_begin += part_size) {
+            size_t part_end = std::min(end, part_begin + part_size);
+            try {
+                submit([&run_part, part_begin, part_end] { run_part(part_begin, part_end); });
+            } catch (...) {
+                // This and later parts are never run
+                state.keep_exception(std::current_exception());
+                state.remaining_parts.fetch_sub((end - part_begin + part_size - 1) / part_size);
+                break;
+            }
+        }
+
+        run_part(begin, std::min(end, begin + part_size));
+
+        while (state.remaining_parts.load() != 0) {
+            if (!run_one_task())
+                std::this_thread::yield();
+        }
+
+        if (state.exception)
+            std::rethrow_exception(state.exception);
+    }
+
+    private:
+    // Only workers run tasks here: tasks may rely on get_current_worker()
+    bool run_one_task() {
+        size_t worker = get_current_worker();
+        if (worker == not_a_worker)
+            return false;
+
+        task_t task;
+        if (!pop_task(worker, task))
+            return false;
+
+        execute(task);
+        return true;
+    }
+
+    void execute(task_t& task) {
+        try {
+            task();
+        } catch (...) {
+            std::lock_guard lock{exception_mutex_};
+            if (!exception_)
+                exception_ = std::current_exception();
+        }
+
+        if (pending_tasks_.fetch_sub(1) == 1)
+            pending_tasks_.notify_all();
+    }
+
+    bool pop_task(size_t worker, task_t& task) {
+        {
+            auto& own_queue = *queues_[worker];
+            std::lock_guard lock{own_queue.mutex};
+            if (!own_queue.tasks.empty()) {
+                task = std::move(own_queue.tasks.back());
+                own_queue.tasks.pop_back();
+                queued_tasks_.fetch_sub(1);
+                return true;
+            }
+        }
+
+        for (size_t shift = 1; shift < queues_.size(); ++shift) {
+            if (steal_task((worker + shift) % queues_.size(), task))
+                return true;
+        }
+
+        return false;
+    }
+
+    bool steal_task(size_t victim, task_t& task) {
+        auto& other_queue = *queues_[victim];
+        std::lock_guard lock{other_queue.mutex};
+        if (!other_queue.tasks.empty()) {
+            task = std::move(other_queue.tasks.front());
+            other_queue.tasks.pop_front();
+            queued_tasks_.fetch_sub(1);
+            return true;
+        }
+
+        return false;
+    }
+
+    void work(size_t worker) {
+        current_pool_   = this;
+        current_worker_ = worker;
+
+        while (true) {
+            uint32_t epoch = wake_up_epoch_.load();
+
+            task_t task;
+            if (pop_task(worker, task)) {
+                execute(task);
+                continue;
+            }
+
+            if (stop_.load() && queued_tasks_.load() == 0)
+                return;
+
+            if (queued_tasks_.load() == 0)
+                wake_up_epoch_.wait(epoch);
+        }
+    }
+};
+
+} // namespace Parallel
+
+#endif // THREAD_POOL_HPP
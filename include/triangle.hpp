@@ -21,13 +21,13 @@ class triangle_t {
     plane_{a, b, c}, number_{number} {}
 
     public:
-    point_t<T> get_a() const { return a_; }
-    point_t<T> get_b() const { return b_; }
-    point_t<T> get_c() const { return c_; }
-    segment_t<T> get_segment_ab() const { return segment_ab_; } 
-    segment_t<T> get_segment_bc() const { return segment_bc_; }
-    segment_t<T> get_segment_ca() const { return segment_ca_; }
-    plane_t<T> get_plane()  const { return plane_; };
+    const point_t<T>& get_a() const { return a_; }
+    const point_t<T>& get_b() const { return b_; }
+    const point_t<T>& get_c() const { return c_; }
+    const segment_t<T>& get_segment_ab() const { return segment_ab_; } 
+    const segment_t<T>& get_segment_bc() const { return segment_bc_; }
+    const segment_t<T>& get_segment_ca() const { return segment_ca_; }
+    const plane_t<T>& get_plane()  const { return plane_; };
     size_t     get_number() const { return number_; };
 
     bool triangle_intersect_segment(const segment_t<T>& segment) const {
@@ -46,8 +46,8 @@ class triangle_t {
             return point_lies_inside_triangle(plane_.intersect_plane_and_segment(segment));
     }
 
-    Compare::interval<double> calculate_intersection_interval(const segment_t<T>& line,
-                                                              const std::array<T, 3>& distance) const {
+    Compare::interval<T> calculate_intersection_interval(const segment_t<T>& line,
+                                                         const std::array<T, 3>& distance) const {
         vector_t<T> first_vector{a_ - line.get_beg_point()};
 
         vector_t<T> second_vector{b_ - line.get_beg_point()};
@@ -58,7 +58,7 @@ class triangle_t {
         T proj_1 = second_vector.dot_product(line.get_dir_vector());
         T proj_2 = third_vector.dot_product(line.get_dir_vector());
 
-        Compare::interval<double> interval{};
+        Compare::interval<T> interval{};
 
         bool segment_is_found = false;
 
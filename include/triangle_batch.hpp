@@ -0,0 +1,976 @@
+#ifndef TRIANGLE_BATCH_HPP
+#define TRIANGLE_BATCH_HPP
+
+#include <array>
+#include <vector>
+#include <cstdint>
+#include <cstring>
+#include <type_traits>
+#include <algorithm>
+#include <utility>
+#include <optional>
+
+#if defined(__x86_64__) || defined(__i386__)
+#include <immintrin.h>
+#endif
+
+#include "double_compare.hpp"
+#include "predicates.hpp"
+#include "triangle.hpp"
+#include "polygons.hpp"
+#include "primitive_store.hpp"
+#include "bounding_box.hpp"
+
+namespace Geom_objects {
+
+// One triangle against several at once: the plane-sign rejection of the exact triangle test
+// (triangle_intersection.hpp) in vector registers. Orientations are computed as the first stage
+// of Predicates::orient3d, a pair is rejected only if the error bound certifies the signs, so
+// the kernel never contradicts the exact test. Every other pair, and pairs with a point or
+// a segment, are left to check_figures_intersection.
+//
+// Before that every pair goes through a box test: a pair whose boxes are farther apart than
+// the tolerance of the comparisons is rejected with a few compares, without any plane math.
+
+enum class simd_level_t {
+    none,   // everything goes to check_figures_intersection
+    sse,    // 2 doubles
+    avx2,   // 4 doubles
+    avx512  // 8 doubles
+};
+
+enum class pair_status_t : uint8_t {
+    no_intersection = 0,
+    exact_test      = 1, // check_figures_intersection decides
+    undecided       = 2  // two triangles with overlapping boxes, for the kernel
+};
+
+inline simd_level_t get_supported_simd_level() {
+#if defined(__x86_64__) || defined(__i386__)
+    if (__builtin_cpu_supports("avx512f"))
+        return simd_level_t::avx512;
+    if (__builtin_cpu_supports("avx2"))
+        return simd_level_t::avx2;
+    return simd_level_t::sse;
+#else
+    return simd_level_t::none;
+#endif
+}
+
+template <typename T>
+struct triangle_query_t {
+    std::array<T, 3> x, y, z;
+
+    explicit triangle_query_t(const triangle_t<T>& triangle) {
+        const point_t<T>* points[3] = {&triangle.get_a(), &triangle.get_b(), &triangle.get_c()};
+        for (size_t vertex = 0; vertex < 3; ++vertex) {
+            x[vertex] = points[vertex]->get_x();
+            y[vertex] = points[vertex]->get_y();
+            z[vertex] = points[vertex]->get_z();
+        }
+    }
+
+    triangle_query_t(const primitive_store_t<T>& store, typename primitive_store_t<T>::index_t index) {
+        for (size_t vertex = 0; vertex < 3; ++vertex) {
+            x[vertex] = store.get_x(index, vertex);
+            y[vertex] = store.get_y(index, vertex);
+            z[vertex] = store.get_z(index, vertex);
+        }
+    }
+
+    Exact::point_3d_t get_vertex(size_t vertex) const {
+        return {static_cast<double>(x[vertex]), static_cast<double>(y[vertex]), static_cast<double>(z[vertex])};
+    }
+};
+
+// Pointers into structure of arrays, readable max_lanes elements past the end
+template <typename T>
+struct triangle_arrays_t {
+    std::array<const T*, 3> x, y, z;
+};
+
+template <typename T>
+struct box_arrays_t {
+    std::array<const T*, 3> min, max;
+};
+
+// no_intersection if the boxes are apart, otherwise exact_test or undecided for a triangle.
+// Without branches: which pairs the boxes reject is hard to predict.
+inline pair_status_t get_box_status(bool overlap, uint8_t is_triangle) {
+    return static_cast<pair_status_t>(overlap * (static_cast<unsigned>(pair_status_t::exact_test) + is_triangle));
+}
+
+// Statuses of pairs (query, box number) for numbers in [begin, end): no_intersection if the
+// boxes don't overlap, the query box is already widened. Returns the number of rejected pairs.
+template <typename T>
+size_t filter_boxes(const packed_box_t<T>& query, const box_arrays_t<T>& boxes, const uint8_t* is_triangle,
+                    size_t begin, size_t end, pair_status_t* statuses) {
+    size_t number_of_rejected = 0;
+    for (size_t number = begin; number < end; ++number) {
+        bool apart = false;
+        for (size_t axis = 0; axis < 3; ++axis)
+            apart |= boxes.min[axis][number] > query.max[axis] || boxes.max[axis][number] < query.min[axis];
+
+        statuses[number] = get_box_status(!apart, is_triangle[number]);
+        number_of_rejected += apart;
+    }
+
+    return number_of_rejected;
+}
+
+// Centers of the octants of a box as columns, in the order of AABB_t::get_octant, and their
+// half-extents widened by the tolerance of the box
+template <typename T>
+struct octant_columns_t {
+    std::array<T, 8> x, y, z;
+    std::array<T, 3> half_edges;
+
+    explicit octant_columns_t(const AABB_t<T>& box, T looseness = 1) {
+        auto octants = box.get_octants(looseness);
+        for (size_t octant = 0; octant < 8; ++octant) {
+            x[octant] = octants[octant].get_middle_point().get_x();
+            y[octant] = octants[octant].get_middle_point().get_y();
+            z[octant] = octants[octant].get_middle_point().get_z();
+        }
+
+        T tolerance = box.get_tolerance();
+        for (size_t axis = 0; axis < 3; ++axis)
+            half_edges[axis] = octants[0].get_box_edges()[axis] + tolerance;
+    }
+
+    // Octants the box axes don't separate from a triangle with this box. Octants are a 2x2x2 grid,
+    // so along an axis only two centers are compared: octant 0 is upper along all axes, the octant
+    // with bit 1 << axis is lower along that one. The comparisons are the slabs of make_triangle_slabs.
+    uint8_t get_overlapping(const packed_box_t<T>& box) const {
+        static constexpr unsigned lower_octants[3] = {0xaa, 0xcc, 0xf0};
+        const std::array<T, 8>* centers[3] = {&x, &y, &z};
+
+        unsigned overlapping = 0xff;
+        for (size_t axis = 0; axis < 3; ++axis) {
+            T low = box.min[axis] - half_edges[axis], high = box.max[axis] + half_edges[axis];
+            T upper = (*centers[axis])[0], lower = (*centers[axis])[size_t{1} << axis];
+
+            unsigned along_axis = 0;
+            if (!(upper < low || upper > high))
+                along_axis |= ~lower_octants[axis] & 0xff;
+            if (!(lower < low || lower > high))
+                along_axis |= lower_octants[axis];
+            overlapping &= along_axis;
+        }
+
+        return static_cast<uint8_t>(overlapping);
+    }
+};
+
+// Octants of candidates that no axis after the box axes separates from the triangle of the slabs.
+// The slabs are made for half_edges of the octants.
+template <typename T>
+uint8_t get_touched_octants(const octant_columns_t<T>& octants, const triangle_slabs_t<T>& slabs, uint8_t candidates) {
+    unsigned touched = 0;
+    for (size_t octant = 0; octant < 8; ++octant) {
+        if (!(candidates & (1u << octant)))
+            continue;
+
+        bool apart = false;
+        for (size_t axis = triangle_slabs_t<T>::number_of_box_axes; axis < triangle_slabs_t<T>::number_of_axes && !apart;
+             ++axis) {
+            const auto& separating_axis = slabs.axes[axis];
+            T projection = separating_axis.get_x() * octants.x[octant] + separating_axis.get_y() * octants.y[octant] +
+                           separating_axis.get_z() * octants.z[octant];
+            apart = projection < slabs.low[axis] || projection > slabs.high[axis];
+        }
+
+        touched |= static_cast<unsigned>(!apart) << octant;
+    }
+
+    return static_cast<uint8_t>(touched);
+}
+
+namespace Simd {
+
+#if defined(__x86_64__) || defined(__i386__)
+
+// Operations the kernel needs from an instruction set: arithmetic is done with
+// operators of the vector types, comparisons give masks
+struct sse_ops {
+    using vector_t = __m128d;
+    using mask_t   = __m128d;
+    static constexpr size_t lanes = 2;
+
+    static vector_t load(const double* data)        { return _mm_loadu_pd(data); }
+    static vector_t broadcast(double value)         { return _mm_set1_pd(value); }
+    static vector_t abs(vector_t x)                 { return _mm_andnot_pd(_mm_set1_pd(-0.0), x); }
+    static mask_t   less(vector_t x, vector_t y)    { return _mm_cmplt_pd(x, y); }
+    static mask_t   greater(vector_t x, vector_t y) { return _mm_cmpgt_pd(x, y); }
+    static mask_t   either(mask_t x, mask_t y)      { return _mm_or_pd(x, y); }
+    static unsigned bits(mask_t mask)               { return static_cast<unsigned>(_mm_movemask_pd(mask)); }
+};
+
+struct avx2_ops {
+    using vector_t = __m256d;
+    using mask_t   = __m256d;
+    static constexpr size_t lanes = 4;
+
+    [[gnu::target("avx2")]] static vector_t load(const double* data)        { return _mm256_loadu_pd(data); }
+    [[gnu::target("avx2")]] static vector_t broadcast(double value)         { return _mm256_set1_pd(value); }
+    [[gnu::target("avx2")]] static vector_t abs(vector_t x)                 { return _mm256_andnot_pd(_mm256_set1_pd(-0.0), x); }
+    [[gnu::target("avx2")]] static mask_t   less(vector_t x, vector_t y)    { return _mm256_cmp_pd(x, y, _CMP_LT_OQ); }
+    [[gnu::target("avx2")]] static mask_t   greater(vector_t x, vector_t y) { return _mm256_cmp_pd(x, y, _CMP_GT_OQ); }
+    [[gnu::target("avx2")]] static mask_t   either(mask_t x, mask_t y)      { return _mm256_or_pd(x, y); }
+    [[gnu::target("avx2")]] static unsigned bits(mask_t mask) {
+        return static_cast<unsigned>(_mm256_movemask_pd(mask));
+    }
+};
+
+struct avx512_ops {
+    using vector_t = __m512d;
+    using mask_t   = __mmask8;
+    static constexpr size_t lanes = 8;
+
+    [[gnu::target("avx512f")]] static vector_t load(const double* data)        { return _mm512_loadu_pd(data); }
+    [[gnu::target("avx512f")]] static vector_t broadcast(double value)         { return _mm512_set1_pd(value); }
+    [[gnu::target("avx512f")]] static vector_t abs(vector_t x)                 { return _mm512_abs_pd(x); }
+    [[gnu::target("avx512f")]] static mask_t   less(vector_t x, vector_t y)    { return _mm512_cmp_pd_mask(x, y, _CMP_LT_OQ); }
+    [[gnu::target("avx512f")]] static mask_t   greater(vector_t x, vector_t y) { return _mm512_cmp_pd_mask(x, y, _CMP_GT_OQ); }
+    [[gnu::target("avx512f")]] static mask_t   either(mask_t x, mask_t y)      { return x | y; }
+    [[gnu::target("avx512f")]] static unsigned bits(mask_t mask)               { return mask; }
+};
+
+// The box filter of float columns needs only loads and comparisons. There are no
+// 16-lane float ops: columns are readable just max_lanes elements past the end.
+struct sse_float_ops {
+    using vector_t = __m128;
+    using mask_t   = __m128;
+    static constexpr size_t lanes = 4;
+
+    static vector_t load(const float* data)         { return _mm_loadu_ps(data); }
+    static vector_t broadcast(float value)          { return _mm_set1_ps(value); }
+    static mask_t   less(vector_t x, vector_t y)    { return _mm_cmplt_ps(x, y); }
+    static mask_t   greater(vector_t x, vector_t y) { return _mm_cmpgt_ps(x, y); }
+    static mask_t   either(mask_t x, mask_t y)      { return _mm_or_ps(x, y); }
+    static unsigned bits(mask_t mask)               { return static_cast<unsigned>(_mm_movemask_ps(mask)); }
+};
+
+struct avx2_float_ops {
+    using vector_t = __m256;
+    using mask_t   = __m256;
+    static constexpr size_t lanes = 8;
+
+    [[gnu::target("avx2")]] static vector_t load(const float* data)         { return _mm256_loadu_ps(data); }
+    [[gnu::target("avx2")]] static vector_t broadcast(float value)          { return _mm256_set1_ps(value); }
+    [[gnu::target("avx2")]] static mask_t   less(vector_t x, vector_t y)    { return _mm256_cmp_ps(x, y, _CMP_LT_OQ); }
+    [[gnu::target("avx2")]] static mask_t   greater(vector_t x, vector_t y) { return _mm256_cmp_ps(x, y, _CMP_GT_OQ); }
+    [[gnu::target("avx2")]] static mask_t   either(mask_t x, mask_t y)      { return _mm256_or_ps(x, y); }
+    [[gnu::target("avx2")]] static unsigned bits(mask_t mask) {
+        return static_cast<unsigned>(_mm256_movemask_ps(mask));
+    }
+};
+
+// Signs of Predicates::orient3d for a vector of points, only those its error bound certifies.
+// Rows a - d, b - d, c - d are given, the arithmetic is the one of the scalar predicate.
+template <typename Ops, typename V = typename Ops::vector_t>
+[[gnu::always_inline]] inline void get_orientation_signs(const V (&ad)[3], const V (&bd)[3], const V (&cd)[3],
+                                                         unsigned& positive_bits, unsigned& negative_bits) {
+    V bdx_cdy = bd[0] * cd[1], cdx_bdy = cd[0] * bd[1];
+    V cdx_ady = cd[0] * ad[1], adx_cdy = ad[0] * cd[1];
+    V adx_bdy = ad[0] * bd[1], bdx_ady = bd[0] * ad[1];
+
+    V determinant = ad[2] * (bdx_cdy - cdx_bdy) + bd[2] * (cdx_ady - adx_cdy) + cd[2] * (adx_bdy - bdx_ady);
+
+    V permanent = (Ops::abs(bdx_cdy) + Ops::abs(cdx_bdy)) * Ops::abs(ad[2]) +
+                  (Ops::abs(cdx_ady) + Ops::abs(adx_cdy)) * Ops::abs(bd[2]) +
+                  (Ops::abs(adx_bdy) + Ops::abs(bdx_ady)) * Ops::abs(cd[2]);
+
+    V error_bound = Ops::broadcast(Predicates::orient3d_error_bound) * permanent;
+    positive_bits = Ops::bits(Ops::greater(determinant, error_bound));
+    negative_bits = Ops::bits(Ops::less(determinant, Ops::broadcast(0.0) - error_bound));
+}
+
+// Bit i is set if statuses[i] is undecided, for eight statuses at once
+inline unsigned get_undecided_bits(const pair_status_t* statuses) {
+    static_assert(static_cast<unsigned>(pair_status_t::undecided) == 2);
+
+    uint64_t bytes = 0;
+    std::memcpy(&bytes, statuses, sizeof(bytes));
+    uint64_t low_bits = (bytes >> 1) & 0x0101010101010101;
+    return static_cast<unsigned>((low_bits * 0x0102040810204080) >> 56); // gathers the low bits into one byte
+}
+
+// Vectorized filter_boxes
+template <typename Ops, typename T>
+[[gnu::always_inline]] inline size_t filter_boxes(const packed_box_t<T>& query, const box_arrays_t<T>& boxes,
+                                                  const uint8_t* is_triangle, size_t begin, size_t end,
+                                                  pair_status_t* statuses) {
+    using V = typename Ops::vector_t;
+
+    V query_min[3], query_max[3];
+    for (size_t axis = 0; axis < 3; ++axis) {
+        query_min[axis] = Ops::broadcast(query.min[axis]);
+        query_max[axis] = Ops::broadcast(query.max[axis]);
+    }
+
+    size_t number_of_rejected = 0;
+    for (size_t number = begin; number < end; number += Ops::lanes) {
+        auto apart = Ops::either(Ops::greater(Ops::load(boxes.min[0] + number), query_max[0]),
+                                 Ops::less(Ops::load(boxes.max[0] + number), query_min[0]));
+        for (size_t axis = 1; axis < 3; ++axis) {
+            apart = Ops::either(apart, Ops::either(Ops::greater(Ops::load(boxes.min[axis] + number), query_max[axis]),
+                                                   Ops::less(Ops::load(boxes.max[axis] + number), query_min[axis])));
+        }
+
+        size_t   lanes        = std::min(Ops::lanes, end - number);
+        unsigned overlap_bits = ~Ops::bits(apart) & ((1u << lanes) - 1);
+        number_of_rejected += lanes - static_cast<size_t>(__builtin_popcount(overlap_bits));
+
+        for (size_t lane = 0; lane < lanes; ++lane)
+            statuses[number + lane] = get_box_status((overlap_bits >> lane) & 1u, is_triangle[number + lane]);
+    }
+
+    return number_of_rejected;
+}
+
+// Statuses of undecided pairs (query, triangle number) for numbers in [begin, end):
+// no_intersection if the vertices of one triangle are certainly on one side of the plane
+// of the other, exact_test otherwise. Other statuses are kept.
+template <typename Ops>
+[[gnu::always_inline]] inline void classify_triangles(const triangle_query_t<double>& query,
+                                                      const triangle_arrays_t<double>& triangles,
+                                                      size_t begin, size_t end, pair_status_t* statuses) {
+    using V = typename Ops::vector_t;
+
+    V query_x[3], query_y[3], query_z[3];
+    for (size_t vertex = 0; vertex < 3; ++vertex) {
+        query_x[vertex] = Ops::broadcast(query.x[vertex]);
+        query_y[vertex] = Ops::broadcast(query.y[vertex]);
+        query_z[vertex] = Ops::broadcast(query.z[vertex]);
+    }
+
+    // Vertices of the triangles against the query plane, orient3d(p, q, vertex, r) of the query
+    // p, q, r: the rows p - r and q - r are the same for all triangles
+    const V query_pr[3] = {query_x[0] - query_x[2], query_y[0] - query_y[2], query_z[0] - query_z[2]};
+    const V query_qr[3] = {query_x[1] - query_x[2], query_y[1] - query_y[2], query_z[1] - query_z[2]};
+
+    for (size_t number = begin; number < end; number += Ops::lanes) {
+        size_t   lanes          = std::min(Ops::lanes, end - number);
+        unsigned candidate_bits = get_undecided_bits(statuses + number) & ((1u << lanes) - 1);
+
+        // Usually the boxes have rejected the whole chunk
+        if (candidate_bits == 0)
+            continue;
+
+        V x[3], y[3], z[3];
+        for (size_t vertex = 0; vertex < 3; ++vertex) {
+            x[vertex] = Ops::load(triangles.x[vertex] + number);
+            y[vertex] = Ops::load(triangles.y[vertex] + number);
+            z[vertex] = Ops::load(triangles.z[vertex] + number);
+        }
+
+        unsigned all_positive = ~0u, all_negative = ~0u;
+        for (size_t vertex = 0; vertex < 3; ++vertex) {
+            V vertex_r[3] = {x[vertex] - query_x[2], y[vertex] - query_y[2], z[vertex] - query_z[2]};
+            unsigned positive_bits, negative_bits;
+            get_orientation_signs<Ops>(query_pr, query_qr, vertex_r, positive_bits, negative_bits);
+            all_positive &= positive_bits;
+            all_negative &= negative_bits;
+        }
+
+        unsigned apart_bits = all_positive | all_negative;
+
+        // Query vertices against the planes of the triangles, if the chunk is not rejected yet
+        if ((candidate_bits & ~apart_bits) != 0) {
+            const V pr[3] = {x[0] - x[2], y[0] - y[2], z[0] - z[2]};
+            const V qr[3] = {x[1] - x[2], y[1] - y[2], z[1] - z[2]};
+
+            all_positive = ~0u;
+            all_negative = ~0u;
+            for (size_t vertex = 0; vertex < 3; ++vertex) {
+                V vertex_r[3] = {query_x[vertex] - x[2], query_y[vertex] - y[2], query_z[vertex] - z[2]};
+                unsigned positive_bits, negative_bits;
+                get_orientation_signs<Ops>(pr, qr, vertex_r, positive_bits, negative_bits);
+                all_positive &= positive_bits;
+                all_negative &= negative_bits;
+            }
+
+            apart_bits |= all_positive | all_negative;
+        }
+
+        for (size_t lane = 0; lane < lanes; ++lane) {
+            auto status = ((apart_bits >> lane) & 1u) ? pair_status_t::no_intersection : pair_status_t::exact_test;
+            statuses[number + lane] = ((candidate_bits >> lane) & 1u) ? status : statuses[number + lane];
+        }
+    }
+}
+
+// Vectorized get_touched_octants: the octants are the lanes, one or a few vectors of them.
+// Projections are computed by the same operations as in the scalar version.
+template <typename Ops>
+[[gnu::always_inline]] inline uint8_t get_touched_octants(const octant_columns_t<double>& octants,
+                                                          const triangle_slabs_t<double>& slabs, uint8_t candidates) {
+    using V = typename Ops::vector_t;
+
+    unsigned touched = 0;
+    for (size_t first = 0; first < 8; first += Ops::lanes) {
+        V x = Ops::load(octants.x.data() + first);
+        V y = Ops::load(octants.y.data() + first);
+        V z = Ops::load(octants.z.data() + first);
+
+        unsigned apart_bits = 0;
+        for (size_t axis = triangle_slabs_t<double>::number_of_box_axes; axis < triangle_slabs_t<double>::number_of_axes;
+             ++axis) {
+            const auto& separating_axis = slabs.axes[axis];
+            V projection = Ops::broadcast(separating_axis.get_x()) * x + Ops::broadcast(separating_axis.get_y()) * y +
+                           Ops::broadcast(separating_axis.get_z()) * z;
+            apart_bits |= Ops::bits(Ops::either(Ops::less(projection, Ops::broadcast(slabs.low[axis])),
+                                                Ops::greater(projection, Ops::broadcast(slabs.high[axis]))));
+        }
+
+        touched |= (~apart_bits & ((1u << Ops::lanes) - 1)) << first;
+    }
+
+    return static_cast<uint8_t>(touched & candidates);
+}
+
+[[gnu::target("avx512f")]] inline void classify_triangles_avx512(const triangle_query_t<double>& query,
+                                                                const triangle_arrays_t<double>& triangles,
+                                                                size_t begin, size_t end, pair_status_t* statuses) {
+    classify_triangles<avx512_ops>(query, triangles, begin, end, statuses);
+}
+
+[[gnu::target("avx2")]] inline void classify_triangles_avx2(const triangle_query_t<double>& query,
+                                                           const triangle_arrays_t<double>& triangles,
+                                                           size_t begin, size_t end, pair_status_t* statuses) {
+    classify_triangles<avx2_ops>(query, triangles, begin, end, statuses);
+}
+
+inline void classify_triangles_sse(const triangle_query_t<double>& query, const triangle_arrays_t<double>& triangles,
+                                   size_t begin, size_t end, pair_status_t* statuses) {
+    classify_triangles<sse_ops>(query, triangles, begin, end, statuses);
+}
+
+[[gnu::target("avx512f")]] inline size_t filter_boxes_avx512(const packed_box_t<double>& query,
+                                                            const box_arrays_t<double>& boxes,
+                                                            const uint8_t* is_triangle, size_t begin, size_t end,
+                                                            pair_status_t* statuses) {
+    return filter_boxes<avx512_ops>(query, boxes, is_triangle, begin, end, statuses);
+}
+
+[[gnu::target("avx2")]] inline size_t filter_boxes_avx2(const packed_box_t<double>& query,
+                                                       const box_arrays_t<double>& boxes,
+                                                       const uint8_t* is_triangle, size_t begin, size_t end,
+                                                       pair_status_t* statuses) {
+    return filter_boxes<avx2_ops>(query, boxes, is_triangle, begin, end, statuses);
+}
+
+inline size_t filter_boxes_sse(const packed_box_t<double>& query, const box_arrays_t<double>& boxes,
+                               const uint8_t* is_triangle, size_t begin, size_t end, pair_status_t* statuses) {
+    return filter_boxes<sse_ops>(query, boxes, is_triangle, begin, end, statuses);
+}
+
+[[gnu::target("avx2")]] inline size_t filter_boxes_avx2(const packed_box_t<float>& query,
+                                                       const box_arrays_t<float>& boxes,
+                                                       const uint8_t* is_triangle, size_t begin, size_t end,
+                                                       pair_status_t* statuses) {
+    return filter_boxes<avx2_float_ops>(query, boxes, is_triangle, begin, end, statuses);
+}
+
+inline size_t filter_boxes_sse(const packed_box_t<float>& query, const box_arrays_t<float>& boxes,
+                               const uint8_t* is_triangle, size_t begin, size_t end, pair_status_t* statuses) {
+    return filter_boxes<sse_float_ops>(query, boxes, is_triangle, begin, end, statuses);
+}
+
+[[gnu::target("avx512f")]] inline uint8_t get_touched_octants_avx512(const octant_columns_t<double>& octants,
+                                                                      const triangle_slabs_t<double>& slabs,
+                                                                      uint8_t candidates) {
+    return get_touched_octants<avx512_ops>(octants, slabs, candidates);
+}
+
+[[gnu::target("avx2")]] inline uint8_t get_touched_octants_avx2(const octant_columns_t<double>& octants,
+                                                                 const triangle_slabs_t<double>& slabs,
+                                                                 uint8_t candidates) {
+    return get_touched_octants<avx2_ops>(octants, slabs, candidates);
+}
+
+inline uint8_t get_touched_octants_sse(const octant_columns_t<double>& octants, const triangle_slabs_t<double>& slabs,
+                                       uint8_t candidates) {
+    return get_touched_octants<sse_ops>(octants, slabs, candidates);
+}
+
+#endif
+
+} // namespace Simd
+
+// Runs the kernel of the given level for triangles [begin, end)
+inline void classify_triangles(simd_level_t simd_level, const triangle_query_t<double>& query,
+                               const triangle_arrays_t<double>& triangles, size_t begin, size_t end,
+                               pair_status_t* statuses) {
+#if defined(__x86_64__) || defined(__i386__)
+    switch (simd_level) {
+        case simd_level_t::avx512:
+            Simd::classify_triangles_avx512(query, triangles, begin, end, statuses);
+            return;
+
+        case simd_level_t::avx2:
+            Simd::classify_triangles_avx2(query, triangles, begin, end, statuses);
+            return;
+
+        case simd_level_t::sse:
+            Simd::classify_triangles_sse(query, triangles, begin, end, statuses);
+            return;
+
+        default:
+            break;
+    }
+#endif
+    (void) simd_level;
+    (void) query;
+    (void) triangles;
+    std::replace(statuses + begin, statuses + end, pair_status_t::undecided, pair_status_t::exact_test);
+}
+
+// Runs the box filter of the given level for boxes [begin, end)
+template <typename T>
+size_t filter_boxes(simd_level_t simd_level, const packed_box_t<T>& query, const box_arrays_t<T>& boxes,
+                    const uint8_t* is_triangle, size_t begin, size_t end, pair_status_t* statuses) {
+#if defined(__x86_64__) || defined(__i386__)
+    if constexpr (std::is_same_v<T, double>) {
+        switch (simd_level) {
+            case simd_level_t::avx512:
+                return Simd::filter_boxes_avx512(query, boxes, is_triangle, begin, end, statuses);
+
+            case simd_level_t::avx2:
+                return Simd::filter_boxes_avx2(query, boxes, is_triangle, begin, end, statuses);
+
+            case simd_level_t::sse:
+                return Simd::filter_boxes_sse(query, boxes, is_triangle, begin, end, statuses);
+
+            default:
+                break;
+        }
+    } else if constexpr (std::is_same_v<T, float>) {
+        // 8 floats of avx2 already fill max_lanes
+        switch (simd_level) {
+            case simd_level_t::avx512:
+            case simd_level_t::avx2:
+                return Simd::filter_boxes_avx2(query, boxes, is_triangle, begin, end, statuses);
+
+            case simd_level_t::sse:
+                return Simd::filter_boxes_sse(query, boxes, is_triangle, begin, end, statuses);
+
+            default:
+                break;
+        }
+    }
+#endif
+    (void) simd_level;
+    return filter_boxes(query, boxes, is_triangle, begin, end, statuses);
+}
+
+// Bit i is set if the triangle touches octant i of the columns, by the slabs of AABB_t::is_part_inside_box.
+// The box axes go first, the other slabs are made only if they leave some octants,
+// and are tested by the kernel of the given level; vector kernels are only for double.
+template <typename T>
+uint8_t get_touched_octants(simd_level_t simd_level, const octant_columns_t<T>& octants, const point_t<T>& a,
+                            const point_t<T>& b, const point_t<T>& c, const prepared_triangle_t<T>& triangle) {
+    auto box = make_box(a, b, c);
+    uint8_t candidates = octants.get_overlapping(box);
+    if (candidates == 0)
+        return 0;
+
+    auto slabs = make_triangle_slabs(a, b, c, triangle, box, octants.half_edges);
+
+#if defined(__x86_64__) || defined(__i386__)
+    if constexpr (std::is_same_v<T, double>) {
+        switch (simd_level) {
+            case simd_level_t::avx512:
+                return Simd::get_touched_octants_avx512(octants, slabs, candidates);
+
+            case simd_level_t::avx2:
+                return Simd::get_touched_octants_avx2(octants, slabs, candidates);
+
+            case simd_level_t::sse:
+                return Simd::get_touched_octants_sse(octants, slabs, candidates);
+
+            default:
+                break;
+        }
+    }
+#endif
+    (void) simd_level;
+    return get_touched_octants(octants, slabs, candidates);
+}
+
+// Boxes of all primitives and vertices of triangles as structure of arrays,
+// max_lanes zeros after the last one
+template <typename T>
+class primitive_columns_t {
+    public:
+    static constexpr size_t max_lanes = 8;
+
+    private:
+    std::array<std::vector<T>, 3> min_, max_;
+    std::array<std::vector<T>, 3> x_, y_, z_;
+    std::vector<uint8_t> is_triangle_;
+    std::vector<pair_status_t> statuses_;
+
+    public:
+    // Makes place for triangle number, buffers only grow
+    void reserve_place(size_t number) {
+        if (is_triangle_.size() >= number + 1 + max_lanes)
+            return;
+
+        size_t new_size = 2 * (number + 1) + max_lanes;
+        for (size_t axis = 0; axis < 3; ++axis) {
+            min_[axis].resize(new_size);
+            max_[axis].resize(new_size);
+        }
+
+        for (size_t vertex = 0; vertex < 3; ++vertex) {
+            x_[vertex].resize(new_size);
+            y_[vertex].resize(new_size);
+            z_[vertex].resize(new_size);
+        }
+
+        is_triangle_.resize(new_size);
+        statuses_.resize(new_size);
+    }
+
+    void set_box(size_t number, const packed_box_t<T>& box) {
+        for (size_t axis = 0; axis < 3; ++axis) {
+            min_[axis][number] = box.min[axis];
+            max_[axis][number] = box.max[axis];
+        }
+    }
+
+    void set_not_triangle(size_t number) { is_triangle_[number] = false; }
+
+    void set_triangle(size_t number, const std::array<T, 3>& x, const std::array<T, 3>& y,
+                      const std::array<T, 3>& z) {
+        is_triangle_[number] = true;
+        for (size_t vertex = 0; vertex < 3; ++vertex) {
+            x_[vertex][number] = x[vertex];
+            y_[vertex][number] = y[vertex];
+            z_[vertex][number] = z[vertex];
+        }
+    }
+
+    bool          is_triangle(size_t number) const { return is_triangle_[number]; }
+    pair_status_t get_status(size_t number)  const { return statuses_[number]; }
+
+    // The exact test of the query against triangle number, the same as triangles_intersect_exactly
+    bool triangles_intersect(const triangle_query_t<T>& query, size_t number) const {
+        auto get_vertex = [&](size_t vertex) -> Exact::point_3d_t {
+            return {static_cast<double>(x_[vertex][number]), static_cast<double>(y_[vertex][number]),
+                    static_cast<double>(z_[vertex][number])};
+        };
+
+        return Exact::triangles_intersect(query.get_vertex(0), query.get_vertex(1), query.get_vertex(2),
+                                          get_vertex(0), get_vertex(1), get_vertex(2));
+    }
+
+    // Rejects pairs whose boxes are apart by more than the tolerance of both boxes,
+    // returns the number of rejected pairs
+    size_t filter(simd_level_t simd_level, packed_box_t<T> query, size_t begin, size_t end) {
+        const T tolerance = 2 * Compare::epsilon_v<T>;
+        for (size_t axis = 0; axis < 3; ++axis) {
+            query.min[axis] -= tolerance;
+            query.max[axis] += tolerance;
+        }
+
+        box_arrays_t<T> boxes{{min_[0].data(), min_[1].data(), min_[2].data()},
+                              {max_[0].data(), max_[1].data(), max_[2].data()}};
+        return filter_boxes(simd_level, query, boxes, is_triangle_.data(), begin, end, statuses_.data());
+    }
+
+    // Rejects pairs left after filter for which skip(number) is true
+    template <typename Skip>
+    void drop(size_t begin, size_t end, Skip&& skip) {
+        for (size_t number = begin; number < end; ++number) {
+            if (statuses_[number] != pair_status_t::no_intersection && skip(number))
+                statuses_[number] = pair_status_t::no_intersection;
+        }
+    }
+
+    // Decides undecided pairs of triangles, after filter
+    void classify(simd_level_t simd_level, const triangle_query_t<T>& query, size_t begin, size_t end) {
+        if constexpr (std::is_same_v<T, double>) {
+            triangle_arrays_t<double> triangles{{x_[0].data(), x_[1].data(), x_[2].data()},
+                                                {y_[0].data(), y_[1].data(), y_[2].data()},
+                                                {z_[0].data(), z_[1].data(), z_[2].data()}};
+            classify_triangles(simd_level, query, triangles, begin, end, statuses_.data());
+        } else {
+            (void) simd_level;
+            (void) query;
+        }
+    }
+
+    // Calls test(number) for pairs neither the boxes nor the kernel could reject
+    template <typename Test, typename Function>
+    void report(size_t begin, size_t end, Test&& test, Function&& on_intersection) const {
+        static_assert(static_cast<unsigned>(pair_status_t::no_intersection) == 0 && max_lanes == sizeof(uint64_t));
+
+        // Most pairs are rejected, eight of them are skipped at once
+        for (size_t chunk = begin; chunk < end; chunk += max_lanes) {
+            uint64_t statuses = 0;
+            std::memcpy(&statuses, statuses_.data() + chunk, sizeof(statuses));
+            if (statuses == 0)
+                continue;
+
+            for (size_t number = chunk; number < std::min(end, chunk + max_lanes); ++number) {
+                if (statuses_[number] != pair_status_t::no_intersection && test(number))
+                    on_intersection(number);
+            }
+        }
+    }
+};
+
+// The box filter is vectorized for double and float, the triangle kernel only for double:
+// pairs of float triangles with overlapping boxes go to check_figures_intersection
+template <typename T>
+inline constexpr bool has_simd_filter_v = std::is_same_v<T, double> || std::is_same_v<T, float>;
+
+template <typename T>
+inline constexpr bool has_simd_kernel_v = std::is_same_v<T, double>;
+
+template <typename T>
+simd_level_t get_default_simd_level() {
+    return has_simd_filter_v<T> ? get_supported_simd_level() : simd_level_t::none;
+}
+
+// Polygons tested against one polygon at a time: the polygons themselves for exact tests,
+// their boxes and triangles as structure of arrays for the box filter and the batched kernel.
+// Buffers only grow, so a reused batch doesn't allocate.
+template <typename T>
+class polygon_batch_t {
+    public:
+    static constexpr size_t max_lanes = primitive_columns_t<T>::max_lanes;
+
+    private:
+    std::vector<polygon_t<T>> polygons_;
+    primitive_columns_t<T> columns_;
+    size_t leading_triangles_  = 0; // polygons [0, leading_triangles_) are triangles
+    size_t number_of_pairs_    = 0;
+    size_t number_of_rejected_ = 0;
+
+    simd_level_t simd_level_ = get_default_simd_level<T>();
+
+    public:
+    void set_simd_level(simd_level_t simd_level) {
+        simd_level_ = has_simd_filter_v<T> ? simd_level : simd_level_t::none;
+    }
+
+    simd_level_t get_simd_level() const { return simd_level_; }
+
+    // Pairs tested and pairs rejected by boxes over the lifetime of the batch
+    size_t get_number_of_pairs()    const { return number_of_pairs_; }
+    size_t get_number_of_rejected() const { return number_of_rejected_; }
+
+    void clear() {
+        polygons_.clear();
+        leading_triangles_ = 0;
+    }
+
+    size_t size() const { return polygons_.size(); }
+
+    const polygon_t<T>& operator[](size_t number) const { return polygons_[number]; }
+
+    // Sets octants[k] to the octants of the box polygon numbers[k] has a part in, bit i for
+    // box.get_octant(i, looseness). Leading triangles go to the octant kernel without looking at kinds,
+    // get_prepared(number) gives the prepared triangle, e.g. from primitive_store_t.
+    template <typename GetPrepared>
+    void find_octants(const AABB_t<T>& box, T looseness, const std::vector<size_t>& numbers,
+                      std::vector<uint8_t>& octants, GetPrepared&& get_prepared) const {
+        octants.clear();
+
+        octant_columns_t<T> columns{box, looseness};
+        auto triangles_end = std::lower_bound(numbers.begin(), numbers.end(), leading_triangles_);
+        for (auto number = numbers.begin(); number != triangles_end; ++number) {
+            const auto& triangle = *std::get_if<triangle_t<T>>(&polygons_[*number]);
+            octants.push_back(get_touched_octants(simd_level_, columns, triangle.get_a(), triangle.get_b(),
+                                                  triangle.get_c(), get_prepared(*number)));
+        }
+
+        if (triangles_end == numbers.end())
+            return;
+
+        auto octant_boxes = box.get_octants(looseness);
+        for (auto number = triangles_end; number != numbers.end(); ++number) {
+            unsigned touched = 0;
+            for (size_t octant = 0; octant < 8; ++octant)
+                touched |= static_cast<unsigned>(octant_boxes[octant].is_polygon_part_inside_box(polygons_[*number])) << octant;
+            octants.push_back(static_cast<uint8_t>(touched));
+        }
+    }
+
+    void push_back(const polygon_t<T>& polygon) { push_back(polygon, make_box(polygon)); }
+
+    // The box must be the box of the polygon, like primitive_store_t::get_box
+    void push_back(const polygon_t<T>& polygon, const packed_box_t<T>& box) {
+        size_t number = polygons_.size();
+        polygons_.push_back(polygon);
+        columns_.reserve_place(number);
+        columns_.set_box(number, box);
+
+        if (polygon.index() != 2) {
+            columns_.set_not_triangle(number);
+            return;
+        }
+
+        if (leading_triangles_ == number)
+            ++leading_triangles_;
+
+        const auto& triangle = std::get<triangle_t<T>>(polygon);
+        const point_t<T>* points[3] = {&triangle.get_a(), &triangle.get_b(), &triangle.get_c()};
+        std::array<T, 3> x, y, z;
+        for (size_t vertex = 0; vertex < 3; ++vertex) {
+            x[vertex] = points[vertex]->get_x();
+            y[vertex] = points[vertex]->get_y();
+            z[vertex] = points[vertex]->get_z();
+        }
+
+        columns_.set_triangle(number, x, y, z);
+    }
+
+    // Calls on_intersection(number) for every number in [begin, size()) for which
+    // check_figures_intersection(polygon, (*this)[number]) is true
+    template <typename Function>
+    void intersect(const polygon_t<T>& polygon, size_t begin, Function&& on_intersection) {
+        intersect(polygon, begin, std::forward<Function>(on_intersection), [](size_t) { return false; });
+    }
+
+    // The same, but pairs with skip(number) true are not tested, e.g. both polygons
+    // of them are known to intersect something already. skip is called only for pairs
+    // with overlapping boxes.
+    template <typename Function, typename Skip>
+    void intersect(const polygon_t<T>& polygon, size_t begin, Function&& on_intersection, Skip&& skip) {
+        size_t end = size();
+        if (begin >= end)
+            return;
+
+        number_of_pairs_    += end - begin;
+        number_of_rejected_ += columns_.filter(simd_level_, make_box(polygon), begin, end);
+        columns_.drop(begin, end, skip);
+
+        auto test = [&](size_t number) { return check_figures_intersection(polygon, polygons_[number]); };
+        if (polygon.index() != 2) {
+            columns_.report(begin, end, test, on_intersection);
+            return;
+        }
+
+        triangle_query_t<T> query{std::get<triangle_t<T>>(polygon)};
+        if (has_simd_kernel_v<T> && simd_level_ != simd_level_t::none)
+            columns_.classify(simd_level_, query, begin, end);
+
+        // Leading triangles go to the triangle kernel without looking at kinds, the rest
+        // to the table of pair kernels. Octree nodes keep triangles first, so the rest is short.
+        size_t triangles_end = std::clamp(leading_triangles_, begin, end);
+        columns_.report(begin, triangles_end, [&](size_t number) {
+            return columns_.triangles_intersect(query, number);
+        }, on_intersection);
+        columns_.report(triangles_end, end, test, on_intersection);
+    }
+};
+
+// The same test as polygon_batch_t for primitives of a store given by their indices.
+// Candidates are kept sorted by kind: triangles are gathered from the store for the kernels,
+// a polygon is rebuilt only for a pair with a point or a segment, so a long list of candidates
+// is cheap to fill.
+template <typename T>
+class store_batch_t {
+    public:
+    using index_t = typename primitive_store_t<T>::index_t;
+
+    private:
+    std::vector<index_t> triangles_, others_;
+    primitive_columns_t<T> triangle_columns_, other_columns_;
+    size_t number_of_pairs_    = 0;
+    size_t number_of_rejected_ = 0;
+
+    simd_level_t simd_level_ = get_default_simd_level<T>();
+
+    public:
+    void set_simd_level(simd_level_t simd_level) {
+        simd_level_ = has_simd_filter_v<T> ? simd_level : simd_level_t::none;
+    }
+
+    simd_level_t get_simd_level() const { return simd_level_; }
+
+    // Pairs tested and pairs rejected by boxes over the lifetime of the batch
+    size_t get_number_of_pairs()    const { return number_of_pairs_; }
+    size_t get_number_of_rejected() const { return number_of_rejected_; }
+
+    void clear() {
+        triangles_.clear();
+        others_.clear();
+    }
+
+    size_t size() const { return triangles_.size() + others_.size(); }
+
+    void push_back(const primitive_store_t<T>& store, index_t index) {
+        if (store.get_kind(index) != primitive_kind_t::triangle) {
+            size_t number = others_.size();
+            others_.push_back(index);
+            other_columns_.reserve_place(number);
+            other_columns_.set_box(number, store.get_box(index));
+            other_columns_.set_not_triangle(number);
+            return;
+        }
+
+        size_t number = triangles_.size();
+        triangles_.push_back(index);
+        triangle_columns_.reserve_place(number);
+        triangle_columns_.set_box(number, store.get_box(index));
+
+        std::array<T, 3> x, y, z;
+        for (size_t vertex = 0; vertex < primitive_store_t<T>::vertices_in_primitive; ++vertex) {
+            x[vertex] = store.get_x(index, vertex);
+            y[vertex] = store.get_y(index, vertex);
+            z[vertex] = store.get_z(index, vertex);
+        }
+
+        triangle_columns_.set_triangle(number, x, y, z);
+    }
+
+    // Calls on_intersection(candidate) for every candidate for which
+    // check_figures_intersection(store.get_polygon(index), store.get_polygon(candidate)) is true,
+    // triangles first
+    template <typename Function>
+    void intersect(const primitive_store_t<T>& store, index_t index, Function&& on_intersection) {
+        if (size() == 0)
+            return;
+
+        const packed_box_t<T>& box = store.get_box(index);
+        number_of_pairs_    += size();
+        number_of_rejected_ += triangle_columns_.filter(simd_level_, box, 0, triangles_.size()) +
+                               other_columns_.filter(simd_level_, box, 0, others_.size());
+
+        std::optional<polygon_t<T>> polygon;
+        auto test = [&](index_t candidate) {
+            if (!polygon)
+                polygon = store.get_polygon(index);
+            return check_figures_intersection(*polygon, store.get_polygon(candidate));
+        };
+
+        auto report_triangle = [&](size_t number) { on_intersection(triangles_[number]); };
+        if (store.get_kind(index) == primitive_kind_t::triangle) {
+            triangle_query_t<T> query{store, index};
+            if (has_simd_kernel_v<T> && simd_level_ != simd_level_t::none)
+                triangle_columns_.classify(simd_level_, query, 0, triangles_.size());
+
+            triangle_columns_.report(0, triangles_.size(), [&](size_t number) {
+                return triangle_columns_.triangles_intersect(query, number);
+            }, report_triangle);
+        } else {
+            triangle_columns_.report(0, triangles_.size(), [&](size_t number) {
+                return test(triangles_[number]);
+            }, report_triangle);
+        }
+
+        other_columns_.report(0, others_.size(), [&](size_t number) {
+            return test(others_[number]);
+        }, [&](size_t number) { on_intersection(others_[number]); });
+    }
+};
+
+} // namespace Geom_objects
+
+#endif // TRIANGLE_BATCH_HPP
@@ -0,0 +1,244 @@
+#ifndef TRIANGLE_INTERSECTION_HPP
+#define TRIANGLE_INTERSECTION_HPP
+
+#include <array>
+#include <cmath>
+
+#include "predicates.hpp"
+#include "triangle.hpp"
+
+namespace Geom_objects {
+
+// Triangle-triangle test of P. Guigue and O. Devillers, "Fast and Robust Triangle-Triangle
+// Overlap Test Using Orientation Predicates", on the exact predicates of predicates.hpp.
+// Only signs of orientations are used: no planes, no line of their intersection, no division,
+// no epsilon. Triangles are closed, touching ones intersect. Coordinates of any T are taken
+// in double, float ones exactly.
+namespace Exact {
+
+using point_3d_t = std::array<double, 3>;
+using point_2d_t = std::array<double, 2>;
+
+inline double orient2d(const point_2d_t& a, const point_2d_t& b, const point_2d_t& c) {
+    return Predicates::orient2d(a[0], a[1], b[0], b[1], c[0], c[1]);
+}
+
+// p1 q1 r1 and p2 q2 r2 go counterclockwise, p1 is outside or on the border of triangle 2,
+// seen from the side of the vertex p2: the edges p2 q2 and r2 p2 don't both separate p1
+inline bool intersect_by_vertex(const point_2d_t& p1, const point_2d_t& q1, const point_2d_t& r1,
+                                const point_2d_t& p2, const point_2d_t& q2, const point_2d_t& r2) {
+    if (orient2d(r2, p2, q1) >= 0.0) {
+        if (orient2d(r2, q2, q1) <= 0.0) {
+            if (orient2d(p1, p2, q1) > 0.0)
+                return orient2d(p1, q2, q1) <= 0.0;
+
+            return orient2d(p1, p2, r1) >= 0.0 && orient2d(q1, r1, p2) >= 0.0;
+        }
+
+        return orient2d(p1, q2, q1) <= 0.0 && orient2d(r2, q2, r1) <= 0.0 && orient2d(q1, r1, q2) >= 0.0;
+    }
+
+    if (orient2d(r2, p2, r1) >= 0.0) {
+        if (orient2d(q1, r1, r2) >= 0.0)
+            return orient2d(p1, p2, r1) >= 0.0;
+
+        return orient2d(q1, r1, q2) >= 0.0 && orient2d(r2, r1, q2) >= 0.0;
+    }
+
+    return false;
+}
+
+// The same, p1 is seen from the side of the edge p2 q2
+inline bool intersect_by_edge(const point_2d_t& p1, const point_2d_t& q1, const point_2d_t& r1,
+                              const point_2d_t& p2, const point_2d_t& /* q2 */, const point_2d_t& r2) {
+    if (orient2d(r2, p2, q1) >= 0.0) {
+        if (orient2d(p1, p2, q1) >= 0.0)
+            return orient2d(p1, q1, r2) >= 0.0;
+
+        return orient2d(q1, r1, p2) >= 0.0 && orient2d(r1, p1, p2) >= 0.0;
+    }
+
+    if (orient2d(r2, p2, r1) >= 0.0) {
+        if (orient2d(p1, p2, r1) < 0.0)
+            return false;
+
+        return orient2d(p1, r1, r2) >= 0.0 || orient2d(q1, r1, r2) >= 0.0;
+    }
+
+    return false;
+}
+
+// Both triangles go counterclockwise. The region of p1 against the edges of triangle 2 picks
+// a vertex or an edge of triangle 2 to test.
+inline bool counterclockwise_triangles_intersect(const point_2d_t& p1, const point_2d_t& q1, const point_2d_t& r1,
+                                                 const point_2d_t& p2, const point_2d_t& q2, const point_2d_t& r2) {
+    if (orient2d(p2, q2, p1) >= 0.0) {
+        if (orient2d(q2, r2, p1) >= 0.0) {
+            if (orient2d(r2, p2, p1) >= 0.0)
+                return true; // p1 is inside triangle 2
+            return intersect_by_edge(p1, q1, r1, p2, q2, r2);
+        }
+
+        if (orient2d(r2, p2, p1) >= 0.0)
+            return intersect_by_edge(p1, q1, r1, r2, p2, q2);
+        return intersect_by_vertex(p1, q1, r1, p2, q2, r2);
+    }
+
+    if (orient2d(q2, r2, p1) >= 0.0) {
+        if (orient2d(r2, p2, p1) >= 0.0)
+            return intersect_by_edge(p1, q1, r1, q2, r2, p2);
+        return intersect_by_vertex(p1, q1, r1, q2, r2, p2);
+    }
+
+    return intersect_by_vertex(p1, q1, r1, r2, p2, q2);
+}
+
+inline bool triangles_intersect_2d(const point_2d_t& p1, const point_2d_t& q1, const point_2d_t& r1,
+                                   const point_2d_t& p2, const point_2d_t& q2, const point_2d_t& r2) {
+    bool first_is_clockwise  = orient2d(p1, q1, r1) < 0.0;
+    bool second_is_clockwise = orient2d(p2, q2, r2) < 0.0;
+
+    const point_2d_t& first_q  = first_is_clockwise  ? r1 : q1;
+    const point_2d_t& first_r  = first_is_clockwise  ? q1 : r1;
+    const point_2d_t& second_q = second_is_clockwise ? r2 : q2;
+    const point_2d_t& second_r = second_is_clockwise ? q2 : r2;
+
+    return counterclockwise_triangles_intersect(p1, first_q, first_r, p2, second_q, second_r);
+}
+
+// Triangles in one plane: both are projected along the axis where the normal of the first
+// is longest, the projection keeps everything but the orientation, which the 2d test fixes
+inline bool coplanar_triangles_intersect(const point_3d_t& p1, const point_3d_t& q1, const point_3d_t& r1,
+                                         const point_3d_t& p2, const point_3d_t& q2, const point_3d_t& r2) {
+    point_3d_t u{q1[0] - p1[0], q1[1] - p1[1], q1[2] - p1[2]};
+    point_3d_t v{r1[0] - p1[0], r1[1] - p1[1], r1[2] - p1[2]};
+    double normal_x = std::fabs(u[1] * v[2] - u[2] * v[1]);
+    double normal_y = std::fabs(u[2] * v[0] - u[0] * v[2]);
+    double normal_z = std::fabs(u[0] * v[1] - u[1] * v[0]);
+
+    size_t first_axis = 0, second_axis = 1; // along z
+    if (normal_x > normal_z && normal_x >= normal_y)
+        first_axis = 2; // along x: z and y
+    else if (normal_y > normal_z && normal_y >= normal_x)
+        second_axis = 2; // along y: x and z
+
+    auto project = [&](const point_3d_t& point) { return point_2d_t{point[first_axis], point[second_axis]}; };
+    return triangles_intersect_2d(project(p1), project(q1), project(r1), project(p2), project(q2), project(r2));
+}
+
+// p1 is alone on its side of the plane of triangle 2 and sees p2 q2 r2 counterclockwise.
+// The line of the planes crosses triangle 1 in a segment, triangle 2 in another one,
+// two orientations tell if the segments overlap.
+inline bool segments_on_line_overlap(const point_3d_t& p1, const point_3d_t& q1, const point_3d_t& r1,
+                                     const point_3d_t& p2, const point_3d_t& q2, const point_3d_t& r2) {
+    return Predicates::orient3d(p2, p1, q2, q1) <= 0.0 && Predicates::orient3d(p2, r1, r2, p1) <= 0.0;
+}
+
+// Vertices of triangle 2 are put in the order segments_on_line_overlap needs by the signs
+// of their orientations against triangle 1; all zeros mean the triangles are coplanar
+inline bool triangles_intersect_canonical(const point_3d_t& p1, const point_3d_t& q1, const point_3d_t& r1,
+                                          const point_3d_t& p2, const point_3d_t& q2, const point_3d_t& r2,
+                                          double dp2, double dq2, double dr2) {
+    if (dp2 > 0.0) {
+        if (dq2 > 0.0)
+            return segments_on_line_overlap(p1, r1, q1, r2, p2, q2);
+        if (dr2 > 0.0)
+            return segments_on_line_overlap(p1, r1, q1, q2, r2, p2);
+        return segments_on_line_overlap(p1, q1, r1, p2, q2, r2);
+    }
+
+    if (dp2 < 0.0) {
+        if (dq2 < 0.0)
+            return segments_on_line_overlap(p1, q1, r1, r2, p2, q2);
+        if (dr2 < 0.0)
+            return segments_on_line_overlap(p1, q1, r1, q2, r2, p2);
+        return segments_on_line_overlap(p1, r1, q1, p2, q2, r2);
+    }
+
+    if (dq2 < 0.0) {
+        if (dr2 >= 0.0)
+            return segments_on_line_overlap(p1, r1, q1, q2, r2, p2);
+        return segments_on_line_overlap(p1, q1, r1, p2, q2, r2);
+    }
+
+    if (dq2 > 0.0) {
+        if (dr2 > 0.0)
+            return segments_on_line_overlap(p1, r1, q1, p2, q2, r2);
+        return segments_on_line_overlap(p1, q1, r1, q2, r2, p2);
+    }
+
+    if (dr2 > 0.0)
+        return segments_on_line_overlap(p1, q1, r1, r2, p2, q2);
+    if (dr2 < 0.0)
+        return segments_on_line_overlap(p1, r1, q1, r2, p2, q2);
+
+    return coplanar_triangles_intersect(p1, q1, r1, p2, q2, r2);
+}
+
+inline bool triangles_intersect(const point_3d_t& p1, const point_3d_t& q1, const point_3d_t& r1,
+                                const point_3d_t& p2, const point_3d_t& q2, const point_3d_t& r2) {
+    // Vertices of triangle 1 against the plane of triangle 2
+    auto [dp1, dq1, dr1] = Predicates::orient3d(p2, q2, {&p1, &q1, &r1}, r2);
+    if ((dp1 > 0.0 && dq1 > 0.0 && dr1 > 0.0) || (dp1 < 0.0 && dq1 < 0.0 && dr1 < 0.0))
+        return false;
+
+    // Vertices of triangle 2 against the plane of triangle 1
+    auto [dp2, dq2, dr2] = Predicates::orient3d(q1, r1, {&p2, &q2, &r2}, p1);
+    if ((dp2 > 0.0 && dq2 > 0.0 && dr2 > 0.0) || (dp2 < 0.0 && dq2 < 0.0 && dr2 < 0.0))
+        return false;
+
+    // Triangle 1 is turned so that p1 is alone on its side, triangle 2 is flipped to match
+    if (dp1 > 0.0) {
+        if (dq1 > 0.0)
+            return triangles_intersect_canonical(r1, p1, q1, p2, r2, q2, dp2, dr2, dq2);
+        if (dr1 > 0.0)
+            return triangles_intersect_canonical(q1, r1, p1, p2, r2, q2, dp2, dr2, dq2);
+        return triangles_intersect_canonical(p1, q1, r1, p2, q2, r2, dp2, dq2, dr2);
+    }
+
+    if (dp1 < 0.0) {
+        if (dq1 < 0.0)
+            return triangles_intersect_canonical(r1, p1, q1, p2, q2, r2, dp2, dq2, dr2);
+        if (dr1 < 0.0)
+            return triangles_intersect_canonical(q1, r1, p1, p2, q2, r2, dp2, dq2, dr2);
+        return triangles_intersect_canonical(p1, q1, r1, p2, r2, q2, dp2, dr2, dq2);
+    }
+
+    if (dq1 < 0.0) {
+        if (dr1 >= 0.0)
+            return triangles_intersect_canonical(q1, r1, p1, p2, r2, q2, dp2, dr2, dq2);
+        return triangles_intersect_canonical(p1, q1, r1, p2, q2, r2, dp2, dq2, dr2);
+    }
+
+    if (dq1 > 0.0) {
+        if (dr1 > 0.0)
+            return triangles_intersect_canonical(p1, q1, r1, p2, r2, q2, dp2, dr2, dq2);
+        return triangles_intersect_canonical(q1, r1, p1, p2, q2, r2, dp2, dq2, dr2);
+    }
+
+    if (dr1 > 0.0)
+        return triangles_intersect_canonical(r1, p1, q1, p2, q2, r2, dp2, dq2, dr2);
+    if (dr1 < 0.0)
+        return triangles_intersect_canonical(r1, p1, q1, p2, r2, q2, dp2, dr2, dq2);
+
+    return coplanar_triangles_intersect(p1, q1, r1, p2, q2, r2);
+}
+
+template <typename T>
+point_3d_t to_double(const point_t<T>& point) {
+    return {static_cast<double>(point.get_x()), static_cast<double>(point.get_y()),
+            static_cast<double>(point.get_z())};
+}
+
+} // namespace Exact
+
+template <typename T>
+bool triangles_intersect_exactly(const triangle_t<T>& first, const triangle_t<T>& second) {
+    return Exact::triangles_intersect(Exact::to_double(first.get_a()), Exact::to_double(first.get_b()),
+                                      Exact::to_double(first.get_c()), Exact::to_double(second.get_a()),
+                                      Exact::to_double(second.get_b()), Exact::to_double(second.get_c()));
+}
+
+} // namespace Geom_objects
+
+#endif // TRIANGLE_INTERSECTION_HPP
@@ -1,73 +1,273 @@
 #include <iostream>
+#include <fstream>
 #include <vector>
-#include <set>
 #include <algorithm>
 #include <array>
+#include <memory>
+#include <optional>
+#include <span>
+#include <stdexcept>
 
 #include "polygons.hpp"
 #include "bounding_box.hpp"
 #include "octree.hpp"
+#include "linear_octree.hpp"
+#include "sweep_and_prune.hpp"
+#include "bvh.hpp"
+#include "hash_grid.hpp"
+#include "intersection_bitset.hpp"
+#include "pair_writer.hpp"
+#include "number_writer.hpp"
+#include "input_parser.hpp"
+#include "binary_format.hpp"
+#include "options.hpp"
+#include "thread_pool.hpp"
 
-int main() {
-    size_t number_of_polygons = 0;
+namespace {
 
-    std::cin >> number_of_polygons;
-    if (!std::cin.good()) {
-        std::cerr << "Error input" << std::endl;
+template <typename S>
+int convert(std::span<const S> coordinates, const Options::options_t& options) {
+    std::ofstream output{options.convert_path, std::ios::binary};
+    if (!output) {
+        std::cerr << "Can't open " << options.convert_path << std::endl;
         return -1;
     }
 
-    std::list<Geom_objects::polygon_t<double>> polygons{};
+    if (options.convert_scalar_type == Input::scalar_type_t::float_type)
+        Input::write_binary<float>(output, coordinates);
+    else 
+        Input::write_binary<double>(output, coordinates);
 
-    Geom_objects::point_t<double> point_1, point_2, point_3;
+    if (!output) {
+        std::cerr << "Error writing " << options.convert_path << std::endl;
+        return -1;
+    }
+
+    return 0;
+}
 
-    double x_coordinate, y_coordinate, z_coordinate;
+template <typename T>
+void print_statistics(const Octree::octree_t<T>& octree) {
+    std::cerr << "nodes: "                   << octree.get_number_of_nodes()          << "\n"
+              << "depth: "                   << octree.get_depth()                    << "\n"
+              << "straddling polygons: "     << octree.get_number_of_straddlers()     << "\n"
+              << "tested pairs: "            << octree.get_number_of_pairs()          << "\n"
+              << "pairs rejected by boxes: " << octree.get_number_of_rejected_pairs() << "\n"
+              << "arena bytes: "             << octree.get_allocated_bytes()          << "\n"
+              << "store bytes: "             << octree.get_store_bytes()              << std::endl;
+}
 
-    double max_x_coordinate = 0;
-    double max_y_coordinate = 0;
-    double max_z_coordinate = 0;
+template <typename T>
+void print_statistics(const Octree::linear_octree_t<T>& octree) {
+    std::cerr << "nodes: "                   << octree.get_number_of_nodes()             << "\n"
+              << "straddling polygons: "     << octree.get_number_of_straddlers()        << "\n"
+              << "tested pairs: "            << octree.get_number_of_pairs()             << "\n"
+              << "pairs rejected by boxes: " << octree.get_number_of_rejected_pairs()    << "\n"
+              << "tree bytes: "              << octree.get_allocated_bytes()             << "\n"
+              << "store bytes: "             << octree.get_store().get_allocated_bytes() << std::endl;
+}
 
-    for (size_t polygon_counter = 0; polygon_counter < number_of_polygons; ++polygon_counter) {
-        if (!(std::cin >> x_coordinate >> y_coordinate >> z_coordinate)) {
-            std::cerr << "Error reading point 1 for triangle " << polygon_counter << std::endl;
-            return -1;
+template <typename T>
+void print_statistics(const Broad_phase::sweep_and_prune_t<T>& sweep) {
+    std::cerr << "sweep axis: "      << sweep.get_sweep_axis()                   << "\n"
+              << "candidate pairs: " << sweep.get_number_of_candidates()         << "\n"
+              << "boxes bytes: "     << sweep.get_allocated_bytes()              << "\n"
+              << "store bytes: "     << sweep.get_store().get_allocated_bytes()  << std::endl;
+}
+
+template <typename T>
+void print_statistics(const Broad_phase::bvh_t<T>& bvh) {
+    std::cerr << "nodes: "           << bvh.get_number_of_nodes()              << "\n"
+              << "candidate pairs: " << bvh.get_number_of_candidates()         << "\n"
+              << "tree bytes: "      << bvh.get_allocated_bytes()              << "\n"
+              << "store bytes: "     << bvh.get_store().get_allocated_bytes()  << std::endl;
+}
+
+template <typename T>
+void print_statistics(const Broad_phase::hash_grid_t<T>& grid) {
+    std::cerr << "cell size: "       << grid.get_cell_size()                    << "\n"
+              << "cells: "           << grid.get_number_of_cells()              << "\n"
+              << "entries: "         << grid.get_entries().size()               << "\n"
+              << "candidate pairs: " << grid.get_number_of_candidates()         << "\n"
+              << "grid bytes: "      << grid.get_allocated_bytes()              << "\n"
+              << "store bytes: "     << grid.get_store().get_allocated_bytes()  << std::endl;
+}
+
+// arguments go to the constructor of DetectorT after coordinates, e.g. the bounding box of an octree.
+// Without a pool everything runs in the calling thread.
+template <typename DetectorT, typename S, typename Result, typename... Arguments>
+void find_intersections(std::span<const S> coordinates, const Options::options_t& options,
+                        Parallel::thread_pool_t* thread_pool, Result& result, const Arguments&... arguments) {
+    if (thread_pool == nullptr) {
+        DetectorT detector{coordinates, arguments...};
+        detector.get_number_of_intersections(result);
+        if (options.print_statistics)
+            print_statistics(detector);
+    } else {
+        DetectorT detector{coordinates, arguments..., *thread_pool};
+        detector.get_number_of_intersections(result, *thread_pool);
+        if (options.print_statistics)
+            print_statistics(detector);
+    }
+}
+
+// extents are known for binary input with a bounding box in its header
+template <typename S>
+int print_intersections(std::span<const S> coordinates, std::optional<Geom_objects::packed_box_t<double>> extents,
+                        const Options::options_t& options, std::ostream& output) {
+    // Detection runs in the scalar type of the input: float records stay float, pairs
+    // float can't decide are checked in double (check_figures_intersection_in_double)
+    using T = S;
+
+    std::unique_ptr<Parallel::thread_pool_t> thread_pool;
+    if (options.number_of_threads != 1)
+        thread_pool = std::make_unique<Parallel::thread_pool_t>(options.number_of_threads);
+
+    // The root box fits the points, wherever they are
+    if (!extents) {
+        auto coordinate_extents = thread_pool ? Geom_objects::get_extents(coordinates, *thread_pool)
+                                              : Geom_objects::get_extents(coordinates);
+        extents.emplace();
+        for (size_t axis = 0; axis < Input::coordinates_in_point; ++axis) {
+            extents->min[axis] = static_cast<double>(coordinate_extents.min[axis]);
+            extents->max[axis] = static_cast<double>(coordinate_extents.max[axis]);
         }
-        point_1 = {x_coordinate, y_coordinate, z_coordinate, polygon_counter};
+    }
+
+    auto bounding_box = Geom_objects::make_bounding_box<T>(*extents);
+
+    Octree::subdivision_parameters_t<T> subdivision_parameters;
+    subdivision_parameters.looseness = static_cast<T>(options.looseness);
+    if (options.min_size)
+        subdivision_parameters.min_size = *options.min_size;
+    if (options.max_depth)
+        subdivision_parameters.max_depth = *options.max_depth;
+    if (options.node_cost)
+        subdivision_parameters.node_cost = static_cast<T>(*options.node_cost);
+    if (options.max_straddling)
+        subdivision_parameters.max_straddling = static_cast<T>(*options.max_straddling);
+
+    auto detect = [&](auto& result) {
+        if (options.broad_phase == Options::broad_phase_t::sweep_and_prune)
+            find_intersections<Broad_phase::sweep_and_prune_t<T>>(coordinates, options, thread_pool.get(), result);
+        else if (options.broad_phase == Options::broad_phase_t::bvh)
+            find_intersections<Broad_phase::bvh_t<T>>(coordinates, options, thread_pool.get(), result);
+        else if (options.broad_phase == Options::broad_phase_t::grid)
+            find_intersections<Broad_phase::hash_grid_t<T>>(coordinates, options, thread_pool.get(), result);
+        else if (options.tree_layout == Options::tree_layout_t::linear)
+            find_intersections<Octree::linear_octree_t<T>>(coordinates, options, thread_pool.get(), result,
+                                                           bounding_box, subdivision_parameters);
+        else
+            find_intersections<Octree::octree_t<T>>(coordinates, options, thread_pool.get(), result,
+                                                    bounding_box, subdivision_parameters);
+    };
 
-        if (!(std::cin >> x_coordinate >> y_coordinate >> z_coordinate)) {
-            std::cerr << "Error reading point 2 for triangle " << polygon_counter << std::endl;
+    if (options.print_pairs) {
+        // Pairs are written as they are found, nothing is collected: a buffer for every
+        // worker of the pool and the last one for the calling thread
+        Output::pair_writer_t writer{output, options.pair_format};
+        size_t number_of_buffers = thread_pool ? thread_pool->get_number_of_threads() + 1 : 1;
+
+        std::vector<Output::pair_buffer_t> buffers;
+        buffers.reserve(number_of_buffers);
+        for (size_t buffer = 0; buffer < number_of_buffers; ++buffer)
+            buffers.emplace_back(writer);
+
+        Geom_objects::pair_callback_t result{[&](size_t first, size_t second) {
+            size_t worker = thread_pool ? thread_pool->get_current_worker() : Parallel::thread_pool_t::not_a_worker;
+            buffers[std::min(worker, number_of_buffers - 1)].push_back(first, second);
+        }};
+        detect(result);
+
+        for (auto& buffer : buffers)
+            buffer.flush();
+        output.flush();
+
+        return 0;
+    }
+
+    Geom_objects::intersection_bitset_t result{coordinates.size() / Input::coordinates_per_triangle};
+    detect(result);
+
+    // Bits are in the order of numbers, so one pass prints them sorted
+    Output::number_writer_t writer{output, options.number_format};
+    result.for_each([&writer](size_t number) { writer.write(number); });
+    writer.flush();
+
+    return 0;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]) {
+    Options::options_t options{};
+    if (!Options::parse_options(argc, argv, options))
+        return -1;
+
+    std::unique_ptr<Input::input_buffer_t> input_buffer;
+    try {
+        if (!options.input_path.empty())
+            input_buffer = std::make_unique<Input::input_buffer_t>(options.input_path);
+        else 
+            input_buffer = std::make_unique<Input::input_buffer_t>();
+    } catch (const std::exception& error) {
+        std::cerr << "Error input: " << error.what() << std::endl;
+        return -1;
+    }
+
+    std::ofstream output_file;
+    if (!options.output_path.empty()) {
+        output_file.open(options.output_path, std::ios::binary);
+        if (!output_file) {
+            std::cerr << "Can't open " << options.output_path << std::endl;
             return -1;
         }
-        point_2 = {x_coordinate, y_coordinate, z_coordinate, polygon_counter};
+    }
+    std::ostream& output = options.output_path.empty() ? std::cout : output_file;
+
+    auto run = [&options, &output](auto coordinates, std::optional<Geom_objects::packed_box_t<double>> extents) {
+        if (!options.convert_path.empty())
+            return convert(coordinates, options);
 
-        if (!(std::cin >> x_coordinate >> y_coordinate >> z_coordinate)) {
-            std::cerr << "Error reading point 3 for triangle " << polygon_counter << std::endl;
+        // Coordinates without a root box, e.g. infinite ones in binary input
+        try {
+            if (print_intersections(coordinates, extents, options, output) != 0)
+                return -1;
+        } catch (const std::domain_error& error) {
+            std::cerr << "Error input: " << error.what() << std::endl;
             return -1;
         }
-        point_3 = {x_coordinate, y_coordinate, z_coordinate, polygon_counter};
 
-        polygons.push_back(Geom_objects::make_geometric_primitive(point_1, point_2, point_3));
+        if (!output) {
+            std::cerr << "Error writing results" << std::endl;
+            return -1;
+        }
 
-        max_x_coordinate = std::max({max_x_coordinate, point_1.get_x(), point_2.get_x(), point_3.get_x()});
-        max_y_coordinate = std::max({max_y_coordinate, point_1.get_y(), point_2.get_y(), point_3.get_y()});
-        max_z_coordinate = std::max({max_z_coordinate, point_1.get_z(), point_2.get_z(), point_3.get_z()});
-    }   
+        return 0;
+    };
 
-    std::array<double, Geom_objects::AABB_t<double>::number_of_edges> box_edges{std::abs(max_x_coordinate),
-                                                                                std::abs(max_y_coordinate), 
-                                                                                std::abs(max_z_coordinate)};
+    if (Input::is_binary_input(input_buffer->view())) {
+        std::optional<Input::binary_view_t> binary_input;
+        try {
+            binary_input.emplace(input_buffer->view());
+        } catch (const std::exception& error) {
+            std::cerr << "Error input: " << error.what() << std::endl;
+            return -1;
+        }
 
-    Geom_objects::point_t<double> middle_of_space{0.0, 0.0, 0.0};
-    Geom_objects::AABB_t<double> bounding_box{middle_of_space, box_edges};
+        std::optional<Geom_objects::packed_box_t<double>> extents;
+        if (binary_input->has_bounding_box())
+            extents = Geom_objects::packed_box_t<double>{binary_input->get_min_point(), binary_input->get_max_point()};
 
-    Octree::octree_t<double> octree{polygons.begin(), polygons.end(), bounding_box};
+        if (binary_input->get_scalar_type() == Input::scalar_type_t::float_type)
+            return run(binary_input->get_records<float>(), extents);
 
-    std::set<size_t> result{};
-    
-    octree.get_number_of_intersections(result);
+        return run(binary_input->get_records<double>(), extents);
+    }
 
-    for (size_t number : result) 
-        std::cout << number << std::endl;
+    std::vector<double> coordinates{};
+    if (!Input::read_text_input(input_buffer->view(), coordinates))
+        return -1;
 
-    return 0;
-}
\ No newline at end of file
+    return run(std::span<const double>{coordinates}, std::nullopt);
+}
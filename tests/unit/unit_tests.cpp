@@ -6,6 +6,31 @@
 #include "segment.hpp"
 #include "plane.hpp"
 #include "triangle.hpp"
+#include "input_parser.hpp"
+#include "binary_format.hpp"
+#include "primitive_store.hpp"
+#include "thread_pool.hpp"
+#include "octree.hpp"
+#include "linear_octree.hpp"
+#include "triangle_batch.hpp"
+#include "predicates.hpp"
+#include "triangle_intersection.hpp"
+#include "sweep_and_prune.hpp"
+#include "bvh.hpp"
+#include "hash_grid.hpp"
+#include "intersection_bitset.hpp"
+#include "pair_writer.hpp"
+#include "number_writer.hpp"
+#include "scenes.hpp"
+
+#include <sstream>
+#include <algorithm>
+#include <atomic>
+#include <random>
+#include <mutex>
+#include <array>
+#include <chrono>
+#include <thread>
 
 TEST(POINT_FUNCTIONS, point_is_not_valid) {
     Geom_objects::point_t<double> p{NAN, NAN, NAN};
@@ -453,6 +478,1264 @@ TEST(TRIANGLE_FUNCTIONS, figures_intersection_9) {
     ASSERT_EQ(Geom_objects::check_figures_intersection(polygon_1, polygon_2), true);
 }
 
+// Every pair of kinds, in both orders, on a small grid where primitives touch and overlap
+TEST(PAIR_KERNELS, both_orders_of_kinds_agree) {
+    std::mt19937 generator{11};
+    std::uniform_int_distribution<int> grid{0, 2};
+
+    std::vector<Geom_objects::polygon_t<double>> polygons;
+    for (size_t number = 0; number < 90; ++number) {
+        double coordinates[9];
+        for (double& coordinate : coordinates)
+            coordinate = grid(generator);
+        if (number % 3 == 0) // a point
+            std::copy(coordinates, coordinates + 3, coordinates + 3);
+        if (number % 3 != 2) // a point or a segment
+            std::copy(coordinates, coordinates + 3, coordinates + 6);
+        polygons.push_back(Geom_objects::make_geometric_primitive<double>(coordinates, number));
+    }
+
+    std::array<std::array<size_t, 3>, 3> intersecting{};
+    for (const auto& first : polygons) {
+        for (const auto& second : polygons) {
+            bool intersect = Geom_objects::check_figures_intersection(first, second);
+            ASSERT_EQ(intersect, Geom_objects::check_figures_intersection(second, first));
+            intersecting[first.index()][second.index()] += intersect;
+        }
+    }
+
+    for (size_t first = 0; first < 3; ++first) {
+        for (size_t second = 0; second < 3; ++second)
+            EXPECT_GT(intersecting[first][second], 0u) << first << " " << second;
+    }
+}
+
+// Points a few ulps off the line y = x: the rounded determinant gets wrong signs here
+TEST(PREDICATES, signs_near_a_line_and_a_plane) {
+    const double ulp = std::nextafter(0.5, 1.0) - 0.5;
+
+    for (int i = 0; i < 16; ++i) {
+        for (int j = 0; j < 16; ++j) {
+            double x = 0.5 + i * ulp, y = 0.5 + j * ulp;
+            double expected = (j > i) - (j < i);
+
+            double orientation = Predicates::orient2d(x, y, 12.0, 12.0, 24.0, 24.0);
+            ASSERT_EQ((orientation > 0) - (orientation < 0), expected);
+
+            // The plane z = x through the line x = y = z
+            orientation = Predicates::orient3d({12.0, 12.0, 12.0}, {24.0, 24.0, 24.0}, {0.0, 1.0, 0.0}, {x, 0.25, y});
+            double above = Predicates::orient3d({12.0, 12.0, 12.0}, {24.0, 24.0, 24.0}, {0.0, 1.0, 0.0}, {0.0, 0.0, 1.0});
+            ASSERT_EQ((orientation > 0) - (orientation < 0), ((above > 0) - (above < 0)) * expected);
+        }
+    }
+}
+
+TEST(EXACT_TRIANGLES, touching_and_almost_touching) {
+    Geom_objects::point_t<double> a{0.0, 0.0, 0.0}, b{1.0, 0.0, 0.0}, c{0.0, 1.0, 0.0};
+    Geom_objects::triangle_t<double> triangle{a, b, c};
+
+    // A common vertex, a common edge in the same plane, an edge through the interior
+    ASSERT_TRUE(Geom_objects::triangles_intersect_exactly(triangle, {b, {2.0, 0.0, 1.0}, {2.0, 1.0, -1.0}}));
+    ASSERT_TRUE(Geom_objects::triangles_intersect_exactly(triangle, {b, c, {1.0, 1.0, 0.0}}));
+    ASSERT_TRUE(Geom_objects::triangles_intersect_exactly(triangle, {{0.25, 0.25, -1.0}, {0.25, 0.25, 1.0},
+                                                                     {5.0, 5.0, 0.0}}));
+
+    // Closer than Compare::epsilon, but apart
+    const double gap = 1.0e-12;
+    Geom_objects::triangle_t<double> parallel{{0.0, 0.0, gap}, {1.0, 0.0, gap}, {0.0, 1.0, gap}};
+    Geom_objects::triangle_t<double> beside{{0.5 + gap, 0.5, -1.0}, {0.5 + gap, 0.5, 1.0}, {2.0, 2.0, 0.0}};
+    ASSERT_FALSE(Geom_objects::triangles_intersect_exactly(triangle, parallel));
+    ASSERT_FALSE(Geom_objects::triangles_intersect_exactly(triangle, beside));
+    ASSERT_FALSE(Geom_objects::check_figures_intersection<double>(triangle, parallel));
+
+    // Far from the origin an absolute epsilon is below the spacing of doubles
+    const double far = 1.0e8;
+    Geom_objects::triangle_t<double> far_triangle{{far, far, far}, {far + 1.0, far, far}, {far, far + 1.0, far}};
+    Geom_objects::triangle_t<double> crossing{{far + 0.25, far + 0.25, far - 1.0}, {far + 0.25, far + 0.25, far + 1.0},
+                                              {far + 5.0, far + 5.0, far}};
+    Geom_objects::triangle_t<double> above{{far, far, far + 1.0e-7}, {far + 1.0, far, far + 1.0e-7},
+                                           {far, far + 1.0, far + 1.0e-7}};
+    ASSERT_TRUE(Geom_objects::triangles_intersect_exactly(far_triangle, crossing));
+    ASSERT_FALSE(Geom_objects::triangles_intersect_exactly(far_triangle, above));
+}
+
+TEST(INPUT_PARSER, read_numbers) {
+    Input::text_parser_t<double> parser{"2\n -1.5 +2 3e2\t0 0 0"};
+    size_t number = 0;
+    double coordinates[6] = {};
+    ASSERT_EQ(parser.read_number(number), true);
+    ASSERT_EQ(number, 2);
+    ASSERT_EQ(parser.read_point(coordinates), true);
+    ASSERT_EQ(parser.read_point(coordinates + 3), true);
+    ASSERT_DOUBLE_EQ(coordinates[0], -1.5);
+    ASSERT_DOUBLE_EQ(coordinates[1], 2.0);
+    ASSERT_DOUBLE_EQ(coordinates[2], 300.0);
+}
+
+TEST(INPUT_PARSER, not_enough_numbers) {
+    Input::text_parser_t<double> parser{"1 2"};
+    double coordinates[3] = {};
+    ASSERT_EQ(parser.read_point(coordinates), false);
+}
+
+TEST(INPUT_PARSER, broken_number) {
+    Input::text_parser_t<double> parser{"1 2x 3"};
+    double coordinates[3] = {};
+    ASSERT_EQ(parser.read_point(coordinates), false);
+}
+
+TEST(INPUT_PARSER, infinity_is_not_a_number) {
+    for (const char* text : {"1 inf 3", "1 -infinity 3", "INF 2 3"}) {
+        Input::text_parser_t<double> parser{text};
+        double coordinates[3] = {};
+        ASSERT_EQ(parser.read_point(coordinates), false);
+    }
+}
+
+TEST(INPUT_PARSER, nan_is_not_a_number) {
+    for (const char* text : {"1 2 nan", "nan(1) 2 3", "-NaN 2 3"}) {
+        Input::text_parser_t<double> parser{text};
+        double coordinates[3] = {};
+        ASSERT_EQ(parser.read_point(coordinates), false);
+    }
+}
+
+TEST(BINARY_FORMAT, write_and_view) {
+    std::vector<double> coordinates{0.0, 0.0, 0.0, 1.0, 0.0, 0.0, 0.0, 1.0, 0.0,
+                                    -1.0, 2.0, 3.0, 4.0, -5.0, 6.0, 7.0, 8.0, -9.0};
+    std::ostringstream output;
+    Input::write_binary<float>(output, std::span<const double>{coordinates});
+    std::string data = output.str();
+
+    ASSERT_EQ(Input::is_binary_input(data), true);
+    Input::binary_view_t view{data};
+    ASSERT_EQ(view.get_number_of_triangles(), 2);
+    ASSERT_EQ(view.get_scalar_type(), Input::scalar_type_t::float_type);
+    ASSERT_EQ(view.has_bounding_box(), true);
+    ASSERT_DOUBLE_EQ(view.get_min_point()[1], -5.0);
+    ASSERT_DOUBLE_EQ(view.get_max_point()[2], 6.0);
+
+    auto records = view.get_records<float>();
+    ASSERT_EQ(records.size(), coordinates.size());
+    ASSERT_FLOAT_EQ(records[17], -9.0f);
+}
+
+TEST(BINARY_FORMAT, truncated_input) {
+    std::vector<double> coordinates(9, 1.0);
+    std::ostringstream output;
+    Input::write_binary<double>(output, std::span<const double>{coordinates});
+    std::string data = output.str();
+    data.pop_back();
+
+    ASSERT_THROW(Input::binary_view_t{data}, std::runtime_error);
+}
+
+TEST(BINARY_FORMAT, coordinates_that_are_not_numbers) {
+    std::vector<double> coordinates(18, 1.0);
+    for (double broken : {std::numeric_limits<double>::quiet_NaN(), std::numeric_limits<double>::infinity()}) {
+        coordinates[13] = broken;
+
+        std::ostringstream double_output, float_output;
+        Input::write_binary<double>(double_output, std::span<const double>{coordinates});
+        Input::write_binary<float>(float_output, std::span<const double>{coordinates});
+        ASSERT_THROW(Input::binary_view_t{double_output.str()}, std::runtime_error);
+        ASSERT_THROW(Input::binary_view_t{float_output.str()}, std::runtime_error);
+
+        // Without a box in the header
+        std::string data = double_output.str();
+        data[offsetof(Input::binary_header_t, flags)] = 0;
+        ASSERT_THROW(Input::binary_view_t{data}, std::runtime_error);
+    }
+}
+
+TEST(PRIMITIVE_STORE, kinds_and_rebuild) {
+    Geom_objects::primitive_store_t<double> store;
+    Geom_objects::point_t<double> a{0.0, 0.0, 0.0, 0}, b{1.0, 0.0, 0.0, 0}, c{0.0, 1.0, 0.0, 0};
+
+    auto triangle_index = store.add(Geom_objects::make_geometric_primitive(a, b, c));
+    auto point_index    = store.add(Geom_objects::make_geometric_primitive(a, a, a));
+    auto segment_index  = store.add(Geom_objects::make_geometric_primitive(a, b, b));
+
+    ASSERT_EQ(store.size(), 3);
+    ASSERT_EQ(store.get_kind(triangle_index), Geom_objects::primitive_kind_t::triangle);
+    ASSERT_EQ(store.get_kind(point_index),    Geom_objects::primitive_kind_t::point);
+    ASSERT_EQ(store.get_kind(segment_index),  Geom_objects::primitive_kind_t::segment);
+    ASSERT_DOUBLE_EQ(store.get_prepared_triangle(triangle_index).normal.get_z(), 1.0);
+    ASSERT_DOUBLE_EQ(store.get_prepared_triangle(triangle_index).edges[0].get_x(), b.get_x() - a.get_x());
+    ASSERT_DOUBLE_EQ(store.get_x(segment_index, 2), store.get_x(segment_index, 1));
+
+    ASSERT_EQ(Geom_objects::check_figures_intersection(store.get_polygon(triangle_index), 
+                                                       store.get_polygon(segment_index)), true);
+    ASSERT_EQ(store.get_polygon(triangle_index).index(), 2);
+}
+
+TEST(PREPARED_TRIANGLE, normal_edges_and_box_tests) {
+    std::mt19937 generator{13};
+    std::uniform_real_distribution<double> distribution{-3.0, 3.0};
+
+    for (size_t number = 0; number < 500; ++number) {
+        Geom_objects::point_t<double> vertices[3];
+        for (auto& vertex : vertices)
+            vertex = {distribution(generator), distribution(generator), distribution(generator)};
+
+        Geom_objects::triangle_t<double> triangle{vertices[0], vertices[1], vertices[2]};
+        auto prepared = Geom_objects::prepare_triangle(triangle);
+        ASSERT_NEAR(prepared.normal.get_length(), 1.0, 1e-12);
+
+        // Edges go around the triangle and lie in its plane
+        for (size_t edge = 0; edge < 3; ++edge) {
+            auto expected = vertices[(edge + 1) % 3] - vertices[edge];
+            ASSERT_DOUBLE_EQ(prepared.edges[edge].get_x(), expected.get_x());
+            ASSERT_NEAR(prepared.normal.dot_product(prepared.edges[edge]), 0.0, 1e-12);
+        }
+
+        Geom_objects::AABB_t<double> box{{distribution(generator), distribution(generator), distribution(generator)},
+                                         {1.0, 0.5, 2.0}};
+        ASSERT_EQ(box.is_part_inside_box(triangle),
+                  box.is_part_inside_box(vertices[0], vertices[1], vertices[2], prepared));
+    }
+}
+
+TEST(TRIANGLE_BOX, separating_axes_agree_with_clipping) {
+    using point_3d_t = std::array<double, 3>;
+
+    // Reference: what is left of the triangle after clipping by the six planes of the box
+    auto clip = [](std::vector<point_3d_t> polygon, const point_3d_t& min, const point_3d_t& max) {
+        for (size_t axis = 0; axis < 3; ++axis) {
+            for (double sign : {1.0, -1.0}) {
+                double bound = sign > 0 ? max[axis] : -min[axis];
+                std::vector<point_3d_t> clipped;
+                for (size_t vertex = 0; vertex < polygon.size(); ++vertex) {
+                    const auto& current = polygon[vertex];
+                    const auto& next    = polygon[(vertex + 1) % polygon.size()];
+                    double current_distance = sign * current[axis] - bound, next_distance = sign * next[axis] - bound;
+
+                    if (current_distance <= 0.0)
+                        clipped.push_back(current);
+                    if ((current_distance < 0.0 && next_distance > 0.0) || (current_distance > 0.0 && next_distance < 0.0)) {
+                        double t = current_distance / (current_distance - next_distance);
+                        clipped.push_back({current[0] + t * (next[0] - current[0]), current[1] + t * (next[1] - current[1]),
+                                           current[2] + t * (next[2] - current[2])});
+                    }
+                }
+                polygon = std::move(clipped);
+            }
+        }
+        return !polygon.empty();
+    };
+
+    std::mt19937 generator{22};
+    std::uniform_real_distribution<double> coordinate{-3.0, 3.0}, center{-2.0, 2.0}, half{0.2, 1.5};
+
+    size_t touching = 0;
+    for (size_t number = 0; number < 5000; ++number) {
+        Geom_objects::point_t<double> vertices[3];
+        for (auto& vertex : vertices)
+            vertex = {coordinate(generator), coordinate(generator), coordinate(generator)};
+
+        Geom_objects::AABB_t<double> box{{center(generator), center(generator), center(generator)},
+                                         {half(generator), half(generator), half(generator)}};
+
+        // Every tenth triangle lies in the upper face plane of the box
+        if (number % 10 == 0) {
+            for (auto& vertex : vertices)
+                vertex = {vertex.get_x(), vertex.get_y(), box.get_middle_point().get_z() + box.get_box_z_edge()};
+        }
+
+        point_3d_t min, max, widened_min, widened_max;
+        for (size_t axis = 0; axis < 3; ++axis) {
+            min[axis] = box.get_middle_point()[axis] - box.get_box_edges()[axis];
+            max[axis] = box.get_middle_point()[axis] + box.get_box_edges()[axis];
+            widened_min[axis] = min[axis] - 1e-6;
+            widened_max[axis] = max[axis] + 1e-6;
+        }
+
+        std::vector<point_3d_t> triangle;
+        for (const auto& vertex : vertices)
+            triangle.push_back({vertex.get_x(), vertex.get_y(), vertex.get_z()});
+
+        bool overlap = box.is_part_inside_box(vertices[0], vertices[1], vertices[2],
+                                              Geom_objects::prepare_triangle(vertices[0], vertices[1], vertices[2]));
+        touching += overlap;
+
+        // Never misses a touching triangle, and reports only triangles touching a slightly bigger box
+        if (clip(triangle, min, max)) {
+            ASSERT_TRUE(overlap);
+        }
+        if (overlap) {
+            ASSERT_TRUE(clip(triangle, widened_min, widened_max));
+        }
+    }
+
+    ASSERT_GT(touching, 500);
+}
+
+TEST(TRIANGLE_BOX, octant_kernels_agree) {
+    std::mt19937 generator{8};
+    std::uniform_real_distribution<double> coordinate{-3.0, 3.0}, center{-1.0, 1.0}, half{0.5, 2.0};
+
+    const Geom_objects::simd_level_t levels[] = {Geom_objects::simd_level_t::sse, Geom_objects::simd_level_t::avx2,
+                                                 Geom_objects::simd_level_t::avx512};
+
+    for (size_t number = 0; number < 2000; ++number) {
+        Geom_objects::point_t<double> a{coordinate(generator), coordinate(generator), coordinate(generator)},
+                                      b{coordinate(generator), coordinate(generator), coordinate(generator)},
+                                      c{coordinate(generator), coordinate(generator), coordinate(generator)};
+        auto prepared = Geom_objects::prepare_triangle(a, b, c);
+
+        Geom_objects::AABB_t<double> box{{center(generator), center(generator), center(generator)},
+                                         {half(generator), half(generator), half(generator)}};
+        Geom_objects::octant_columns_t<double> octants{box};
+
+        uint8_t touched = Geom_objects::get_touched_octants(Geom_objects::simd_level_t::none, octants, a, b, c, prepared);
+        for (auto level : levels) {
+            if (level <= Geom_objects::get_supported_simd_level()) {
+                ASSERT_EQ(Geom_objects::get_touched_octants(level, octants, a, b, c, prepared), touched);
+            }
+        }
+
+        // The octants are widened by the tolerance of the parent, not smaller than their own
+        auto octant_boxes = box.get_octants();
+        for (size_t octant = 0; octant < 8; ++octant) {
+            if (octant_boxes[octant].is_part_inside_box(a, b, c, prepared)) {
+                ASSERT_TRUE(touched & (1u << octant));
+            }
+        }
+    }
+}
+
+TEST(ROOT_BOX, extents_in_one_pass) {
+    std::mt19937 generator{24};
+    std::uniform_real_distribution<double> distribution{-1e3, 5e2};
+
+    // Whole blocks of twelve, a tail, and enough parts for the pool
+    for (size_t number_of_points : std::array<size_t, 5>{0, 1, 4, 37, 90001}) {
+        std::vector<double> coordinates(number_of_points * 3);
+        for (double& coordinate : coordinates)
+            coordinate = distribution(generator);
+
+        std::vector<float> float_coordinates(coordinates.begin(), coordinates.end());
+
+        Geom_objects::packed_box_t<double> expected;
+        expected.min.fill(std::numeric_limits<double>::infinity());
+        expected.max.fill(-std::numeric_limits<double>::infinity());
+        for (size_t index = 0; index < coordinates.size(); ++index) {
+            expected.min[index % 3] = std::min(expected.min[index % 3], coordinates[index]);
+            expected.max[index % 3] = std::max(expected.max[index % 3], coordinates[index]);
+        }
+
+        auto extents = Geom_objects::get_extents(std::span<const double>{coordinates});
+        ASSERT_EQ(extents.min, expected.min);
+        ASSERT_EQ(extents.max, expected.max);
+
+        Parallel::thread_pool_t thread_pool{3};
+        auto parallel_extents = Geom_objects::get_extents(std::span<const double>{coordinates}, thread_pool);
+        ASSERT_EQ(parallel_extents.min, expected.min);
+        ASSERT_EQ(parallel_extents.max, expected.max);
+
+        auto float_extents = Geom_objects::get_extents(std::span<const float>{float_coordinates});
+        for (size_t axis = 0; axis < 3; ++axis) {
+            ASSERT_EQ(float_extents.min[axis], static_cast<float>(expected.min[axis]));
+            ASSERT_EQ(float_extents.max[axis], static_cast<float>(expected.max[axis]));
+        }
+    }
+}
+
+TEST(ROOT_BOX, far_from_origin_scene_is_pruned) {
+    std::mt19937 generator{25};
+    std::uniform_real_distribution<double> distribution{-50.0, 50.0};
+    std::uniform_real_distribution<double> offset{-1.0, 1.0};
+
+    // Georeferenced: far from the origin, flat along z
+    std::vector<double> coordinates;
+    for (size_t triangle = 0; triangle < 3000; ++triangle) {
+        double center[2] = {1e6 + distribution(generator), -2e6 + distribution(generator)};
+        for (size_t point = 0; point < 3; ++point) {
+            coordinates.push_back(center[0] + offset(generator));
+            coordinates.push_back(center[1] + offset(generator));
+            coordinates.push_back(300.0);
+        }
+    }
+
+    std::vector<float> float_coordinates(coordinates.begin(), coordinates.end());
+    auto float_box = Geom_objects::make_bounding_box<float>(
+        Geom_objects::get_extents(std::span<const float>{float_coordinates}));
+    for (size_t index = 0; index < float_coordinates.size(); index += 3) {
+        ASSERT_TRUE(float_box.is_point_inside_box({float_coordinates[index], float_coordinates[index + 1],
+                                                   float_coordinates[index + 2]}));
+    }
+
+    Geom_objects::packed_box_t<double> point_extents{{1e6, 1e6, 1e6}, {1e6, 1e6, 1e6}};
+    ASSERT_TRUE(Geom_objects::make_bounding_box<float>(point_extents).is_point_inside_box({1e6f, 1e6f, 1e6f}));
+
+    std::span<const double> span{coordinates};
+    auto bounding_box = Geom_objects::make_bounding_box<double>(Geom_objects::get_extents(span));
+    Octree::octree_t<double> octree{span, bounding_box};
+
+    size_t number_of_polygons = coordinates.size() / 9;
+    Geom_objects::intersection_bitset_t result{number_of_polygons};
+    octree.get_number_of_intersections(result);
+
+    Broad_phase::sweep_and_prune_t<double> sweep{span};
+    Geom_objects::intersection_bitset_t sweep_result{number_of_polygons};
+    sweep.get_number_of_intersections(sweep_result);
+
+    ASSERT_FALSE(result.empty());
+    ASSERT_EQ(result, sweep_result);
+    ASSERT_LT(octree.get_number_of_pairs(), number_of_polygons * (number_of_polygons - 1) / 2 / 20);
+}
+
+TEST(ROOT_BOX, extents_near_the_largest_double) {
+    // The sizes of the extents are out of the range of double, their halves are not
+    Geom_objects::packed_box_t<double> extents{{-1e308, 0, 0}, {1e308, 1, 0}};
+    auto bounding_box = Geom_objects::make_bounding_box<double>(extents);
+    for (double edge : bounding_box.get_box_edges())
+        ASSERT_TRUE(std::isfinite(edge));
+    ASSERT_TRUE(bounding_box.is_point_inside_box({-1e308, 0, 0}));
+    ASSERT_TRUE(bounding_box.is_point_inside_box({1e308, 1, 0}));
+
+    Geom_objects::packed_box_t<double> largest{{-1.7e308, -1.7e308, -1.7e308}, {1.7e308, 1.7e308, 1.7e308}};
+    ASSERT_TRUE(std::isfinite(Geom_objects::make_bounding_box<double>(largest).get_box_x_edge()));
+
+    Geom_objects::packed_box_t<double> infinite{{-INFINITY, 0, 0}, {0, 0, 0}};
+    ASSERT_THROW(Geom_objects::make_bounding_box<double>(infinite), std::domain_error);
+
+    // Orientations of such triangles are decided exactly, the pair is found
+    std::vector<double> coordinates{1e308, 0, 0, -1e308, 0, 0, 0, 1, 0,
+                                    0,     0, 0, 1,      0, 0, 0, 1, 0};
+    std::span<const double> span{coordinates};
+    Octree::octree_t<double> octree{span, Geom_objects::make_bounding_box<double>(Geom_objects::get_extents(span))};
+
+    Geom_objects::intersection_bitset_t result{2};
+    octree.get_number_of_intersections(result);
+    ASSERT_TRUE(result.contains(0));
+    ASSERT_TRUE(result.contains(1));
+}
+
+TEST(ROOT_BOX, coordinates_that_are_not_numbers_have_no_box) {
+    Parallel::thread_pool_t thread_pool{3};
+
+    // In a whole block, in the tail, and in the last part of the pool
+    for (size_t broken_index : std::array<size_t, 3>{4, 270001, 250000}) {
+        std::vector<double> coordinates(270003, 1.0);
+        coordinates[broken_index] = std::numeric_limits<double>::quiet_NaN();
+        std::span<const double> span{coordinates};
+
+        for (const auto& extents : {Geom_objects::get_extents(span), Geom_objects::get_extents(span, thread_pool)}) {
+            ASSERT_TRUE(std::isnan(extents.min[broken_index % 3]));
+            ASSERT_EQ(extents.max[(broken_index + 1) % 3], 1.0);
+            ASSERT_THROW(Geom_objects::make_bounding_box<double>(extents), std::domain_error);
+        }
+    }
+}
+
+TEST(THREAD_POOL, nested_tasks) {
+    Parallel::thread_pool_t thread_pool{4};
+    std::atomic<size_t> counter = 0;
+
+    for (size_t task = 0; task < 100; ++task) {
+        thread_pool.submit([&] {
+            for (size_t subtask = 0; subtask < 10; ++subtask)
+                thread_pool.submit([&] { ++counter; });
+        });
+    }
+    thread_pool.wait();
+
+    ASSERT_EQ(counter.load(), 1000);
+}
+
+TEST(THREAD_POOL, parallel_for_inside_task) {
+    Parallel::thread_pool_t thread_pool{2};
+    std::vector<size_t> values(10000, 0);
+
+    thread_pool.submit([&] {
+        thread_pool.parallel_for(0, values.size(), 64, [&](size_t begin, size_t end) {
+            for (size_t index = begin; index < end; ++index)
+                values[index] = index;
+        });
+    });
+    thread_pool.wait();
+
+    for (size_t index = 0; index < values.size(); ++index)
+        ASSERT_EQ(values[index], index);
+}
+
+TEST(THREAD_POOL, parallel_for_rethrows_after_all_parts) {
+    Parallel::thread_pool_t thread_pool{3};
+
+    // A queued part and the part run by the caller throw, the others still run to the end
+    for (size_t throwing_part : std::array<size_t, 2>{0, 5}) {
+        std::atomic<size_t> finished_parts = 0;
+        auto run = [&] {
+            thread_pool.parallel_for(0, 640, 64, [&](size_t begin, size_t) {
+                if (begin == throwing_part * 64)
+                    throw std::runtime_error("part failed");
+                std::this_thread::sleep_for(std::chrono::milliseconds(1));
+                ++finished_parts;
+            });
+        };
+
+        ASSERT_THROW(run(), std::runtime_error);
+        ASSERT_EQ(finished_parts.load(), 9u);
+
+        finished_parts = 0;
+        thread_pool.submit(run);
+        ASSERT_THROW(thread_pool.wait(), std::runtime_error);
+        ASSERT_EQ(finished_parts.load(), 9u);
+    }
+}
+
+TEST(OCTREE, parallel_build_and_detection_are_the_same) {
+    std::mt19937 generator{1};
+    std::uniform_real_distribution<double> distribution{-50.0, 50.0};
+    std::uniform_real_distribution<double> offset{-3.0, 3.0};
+
+    std::vector<double> coordinates;
+    for (size_t triangle = 0; triangle < 3000; ++triangle) {
+        double center[3] = {distribution(generator), distribution(generator), distribution(generator)};
+        for (size_t coordinate = 0; coordinate < 9; ++coordinate)
+            coordinates.push_back(center[coordinate % 3] + offset(generator));
+    }
+
+    Geom_objects::AABB_t<double> bounding_box{{0.0, 0.0, 0.0}, {60.0, 60.0, 60.0}};
+    Octree::octree_t<double> octree{std::span<const double>{coordinates}, bounding_box};
+
+    Geom_objects::intersection_bitset_t serial_result{coordinates.size() / 9};
+    octree.get_number_of_intersections(serial_result);
+
+    Parallel::thread_pool_t thread_pool{3};
+    Octree::octree_t<double> parallel_octree{std::span<const double>{coordinates}, bounding_box, thread_pool};
+
+    Geom_objects::intersection_bitset_t parallel_result{coordinates.size() / 9};
+    parallel_octree.get_number_of_intersections(parallel_result, thread_pool);
+
+    ASSERT_FALSE(serial_result.empty());
+    ASSERT_EQ(serial_result, parallel_result);
+}
+
+TEST(OCTREE, triangles_come_first_in_every_node) {
+    std::mt19937 generator{12};
+    std::uniform_real_distribution<double> distribution{-20.0, 20.0};
+    std::uniform_real_distribution<double> offset{-1.0, 1.0};
+
+    std::vector<double> coordinates;
+    for (size_t triangle = 0; triangle < 2000; ++triangle) {
+        double center[3] = {distribution(generator), distribution(generator), distribution(generator)};
+        for (size_t coordinate = 0; coordinate < 9; ++coordinate)
+            coordinates.push_back(center[coordinate % 3] + (triangle % 4 == 0 ? 0.0 : offset(generator)));
+    }
+
+    Geom_objects::AABB_t<double> bounding_box{{0.0, 0.0, 0.0}, {25.0, 25.0, 25.0}};
+    Octree::octree_t<double> octree{std::span<const double>{coordinates}, bounding_box, 20};
+    const auto& store = octree.get_store();
+
+    size_t number_of_polygons = 0;
+    std::vector<const Octree::octree_node_t<double>*> nodes{octree.get_root()};
+    while (!nodes.empty()) {
+        const auto* node = nodes.back();
+        nodes.pop_back();
+
+        const auto& polygons = node->polygons_in_space_;
+        ASSERT_TRUE(std::is_partitioned(polygons.begin(), polygons.end(), [&](uint32_t index) {
+            return store.get_kind(index) == Geom_objects::primitive_kind_t::triangle;
+        }));
+        number_of_polygons += polygons.size();
+
+        for (size_t number_of_child = 0; number_of_child < Octree::number_of_children; ++number_of_child) {
+            if (node->valid_children_[number_of_child])
+                nodes.push_back(node->children_[number_of_child]);
+        }
+    }
+
+    ASSERT_EQ(number_of_polygons, coordinates.size() / 9);
+}
+
+TEST(OCTREE, children_are_allocated_only_with_polygons) {
+    Octree::memory_manager_t<double> memory_manager;
+    Geom_objects::AABB_t<double> box{{0.0, 0.0, 0.0}, {1.0, 1.0, 1.0}};
+
+    Octree::octree_node_t<double>* root = memory_manager.make_node(box, nullptr);
+    std::array<Geom_objects::AABB_t<double>, Octree::number_of_children> children_boxes{
+        box, box, box, box, box, box, box, box};
+    memory_manager.make_children(root, children_boxes, {3, 0, 0, 1, 0, 0, 0, 0});
+
+    ASSERT_EQ(memory_manager.get_number_of_nodes(), 3);
+    ASSERT_EQ(root->children_[1], nullptr);
+    ASSERT_EQ(root->children_[0] + 1, root->children_[3]);
+    ASSERT_EQ(root->children_[3]->depth, 1);
+    ASSERT_GE(root->children_[0]->polygons_in_space_.capacity(), 3);
+
+    memory_manager.delete_tree(root);
+    ASSERT_EQ(memory_manager.get_number_of_nodes(), 0);
+}
+
+TEST(LINEAR_OCTREE, same_result_as_pointer_octree) {
+    std::mt19937 generator{2};
+    std::uniform_real_distribution<double> distribution{-50.0, 50.0};
+    std::uniform_real_distribution<double> offset{-3.0, 3.0};
+
+    std::vector<double> coordinates;
+    for (size_t triangle = 0; triangle < 3000; ++triangle) {
+        double center[3] = {distribution(generator), distribution(generator), distribution(generator)};
+        for (size_t coordinate = 0; coordinate < 9; ++coordinate)
+            coordinates.push_back(center[coordinate % 3] + offset(generator));
+    }
+
+    Geom_objects::AABB_t<double> bounding_box{{0.0, 0.0, 0.0}, {60.0, 60.0, 60.0}};
+    Octree::octree_t<double> octree{std::span<const double>{coordinates}, bounding_box};
+    Octree::linear_octree_t<double> linear_octree{octree};
+
+    ASSERT_EQ(linear_octree.get_number_of_nodes(), octree.get_number_of_nodes());
+    ASSERT_EQ(linear_octree.get_node_polygons(0).size(), octree.get_root()->polygons_in_space_.size());
+
+    Geom_objects::intersection_bitset_t result{coordinates.size() / 9};
+    octree.get_number_of_intersections(result);
+
+    Geom_objects::intersection_bitset_t linear_result{coordinates.size() / 9};
+    linear_octree.get_number_of_intersections(linear_result);
+
+    Parallel::thread_pool_t thread_pool{3};
+    Geom_objects::intersection_bitset_t parallel_linear_result{coordinates.size() / 9};
+    linear_octree.get_number_of_intersections(parallel_linear_result, thread_pool);
+
+    ASSERT_FALSE(result.empty());
+    ASSERT_EQ(result, linear_result);
+    ASSERT_EQ(result, parallel_linear_result);
+}
+
+TEST(LOOSE_OCTREE, every_pair_is_reported_once) {
+    std::mt19937 generator{23};
+    std::uniform_real_distribution<double> distribution{-20.0, 20.0};
+    std::uniform_real_distribution<double> offset{-1.5, 1.5};
+
+    std::vector<double> coordinates;
+    for (size_t triangle = 0; triangle < 2000; ++triangle) {
+        double center[3] = {distribution(generator), distribution(generator), distribution(generator)};
+        for (size_t coordinate = 0; coordinate < 9; ++coordinate)
+            coordinates.push_back(center[coordinate % 3] + offset(generator));
+    }
+
+    std::span<const double> span{coordinates};
+    Geom_objects::AABB_t<double> bounding_box{{0.0, 0.0, 0.0}, {22.0, 22.0, 22.0}};
+
+    std::mutex mutex;
+    std::vector<std::pair<size_t, size_t>> pairs;
+    Geom_objects::pair_callback_t result{[&](size_t first, size_t second) {
+        std::lock_guard lock{mutex};
+        pairs.emplace_back(std::min(first, second), std::max(first, second));
+    }};
+
+    auto take_pairs = [&] {
+        auto taken = std::move(pairs);
+        pairs.clear();
+        std::sort(taken.begin(), taken.end());
+        return taken;
+    };
+
+    Broad_phase::sweep_and_prune_t<double> sweep{span};
+    sweep.get_number_of_intersections(result);
+    auto expected = take_pairs();
+    ASSERT_FALSE(expected.empty());
+
+    Octree::octree_t<double> octree{span, bounding_box};
+
+    for (double looseness : {1.5, 2.0}) {
+        Octree::subdivision_parameters_t<double> parameters;
+        parameters.looseness = looseness;
+
+        Octree::octree_t<double> loose_octree{span, bounding_box, parameters};
+        ASSERT_LT(loose_octree.get_number_of_straddlers(), octree.get_number_of_straddlers());
+
+        loose_octree.get_number_of_intersections(result);
+        ASSERT_EQ(take_pairs(), expected);
+
+        Parallel::thread_pool_t thread_pool{3};
+        Octree::octree_t<double> parallel_octree{span, bounding_box, parameters, thread_pool};
+        parallel_octree.get_number_of_intersections(result, thread_pool);
+        ASSERT_EQ(take_pairs(), expected);
+
+        Octree::linear_octree_t<double> linear_octree{loose_octree};
+        ASSERT_EQ(linear_octree.get_number_of_straddlers(), loose_octree.get_number_of_straddlers());
+
+        linear_octree.get_number_of_intersections(result);
+        ASSERT_EQ(take_pairs(), expected);
+
+        linear_octree.get_number_of_intersections(result, thread_pool);
+        ASSERT_EQ(take_pairs(), expected);
+    }
+}
+
+TEST(LOOSE_OCTREE, looseness_one_is_the_plain_tree) {
+    Geom_objects::AABB_t<double> box{{1.0, 2.0, 3.0}, {4.0, 4.0, 4.0}};
+    auto plain = box.get_octant(5);
+    auto loose = box.get_octant(5, 2.0);
+
+    ASSERT_DOUBLE_EQ(plain.get_middle_point().get_x(), -1.0);
+    ASSERT_DOUBLE_EQ(plain.get_middle_point().get_y(), 4.0);
+    ASSERT_DOUBLE_EQ(plain.get_middle_point().get_z(), 1.0);
+    ASSERT_DOUBLE_EQ(loose.get_middle_point().get_x(), 0.0);
+    ASSERT_DOUBLE_EQ(loose.get_middle_point().get_z(), 2.0);
+    ASSERT_DOUBLE_EQ(loose.get_box_x_edge(), plain.get_box_x_edge());
+
+    std::mt19937 generator{24};
+    std::uniform_real_distribution<double> distribution{-10.0, 10.0};
+    std::vector<double> coordinates(900);
+    for (double& coordinate : coordinates)
+        coordinate = distribution(generator);
+
+    std::span<const double> span{coordinates};
+    Geom_objects::AABB_t<double> bounding_box{{0.0, 0.0, 0.0}, {10.0, 10.0, 10.0}};
+    Octree::octree_t<double> octree{span, bounding_box};
+    Octree::octree_t<double> loose_octree{span, bounding_box, Octree::subdivision_parameters_t<double>{}};
+
+    ASSERT_EQ(loose_octree.get_number_of_nodes(), octree.get_number_of_nodes());
+    ASSERT_EQ(loose_octree.get_number_of_straddlers(), octree.get_number_of_straddlers());
+}
+
+TEST(SPLIT_POLICY, depth_is_limited_on_coincident_triangles) {
+    // The same tiny triangle fits an octant at every depth, splitting it saves nothing
+    std::vector<double> coordinates;
+    for (size_t triangle = 0; triangle < 200; ++triangle) {
+        for (double coordinate : {1.0, 1.0, 1.0, 1.001, 1.0, 1.0, 1.0, 1.001, 1.0})
+            coordinates.push_back(coordinate);
+    }
+
+    std::span<const double> span{coordinates};
+    Geom_objects::AABB_t<double> bounding_box{{0.0, 0.0, 0.0}, {10.0, 10.0, 10.0}};
+
+    Octree::octree_t<double> octree{span, bounding_box};
+    ASSERT_EQ(octree.get_number_of_nodes(), 1);
+
+    Octree::subdivision_parameters_t<double> parameters;
+    parameters.min_size     = 1;
+    parameters.max_depth    = 5;
+    parameters.split_policy = [](const Octree::split_candidate_t<double>&) { return true; };
+
+    Octree::octree_t<double> deep_octree{span, bounding_box, parameters};
+    ASSERT_EQ(deep_octree.get_depth(), 5);
+    ASSERT_EQ(deep_octree.get_number_of_nodes(), 6);
+
+    parameters.max_depth = 1000;
+    Octree::octree_t<double> deepest_octree{span, bounding_box, parameters};
+    ASSERT_LT(deepest_octree.get_depth(), 64);
+
+    Geom_objects::intersection_bitset_t result{200};
+    deepest_octree.get_number_of_intersections(result);
+    ASSERT_EQ(result.size(), 200);
+}
+
+TEST(SPLIT_POLICY, same_result_with_any_parameters) {
+    std::mt19937 generator{26};
+    std::uniform_real_distribution<double> distribution{-30.0, 30.0};
+    std::uniform_real_distribution<double> offset{-2.0, 2.0};
+
+    std::vector<double> coordinates;
+    for (size_t triangle = 0; triangle < 3000; ++triangle) {
+        double center[3] = {distribution(generator), distribution(generator), distribution(generator)};
+        for (size_t coordinate = 0; coordinate < 9; ++coordinate)
+            coordinates.push_back(center[coordinate % 3] + offset(generator));
+    }
+
+    std::span<const double> span{coordinates};
+    Geom_objects::AABB_t<double> bounding_box{{0.0, 0.0, 0.0}, {33.0, 33.0, 33.0}};
+
+    Broad_phase::sweep_and_prune_t<double> sweep{span};
+    Geom_objects::intersection_bitset_t expected{3000};
+    sweep.get_number_of_intersections(expected);
+    ASSERT_FALSE(expected.empty());
+
+    Octree::subdivision_parameters_t<double> cheap_nodes;
+    cheap_nodes.min_size  = 2;
+    cheap_nodes.node_cost = 0;
+
+    Octree::subdivision_parameters_t<double> shallow;
+    shallow.max_depth      = 2;
+    shallow.max_straddling = 0.1;
+
+    Octree::subdivision_parameters_t<double> never_split;
+    never_split.split_policy = [](const Octree::split_candidate_t<double>&) { return false; };
+
+    size_t default_nodes = Octree::octree_t<double>{span, bounding_box}.get_number_of_nodes();
+    ASSERT_GT(default_nodes, 1);
+    ASSERT_GT(Octree::octree_t<double>(span, bounding_box, cheap_nodes).get_number_of_nodes(), default_nodes);
+    ASSERT_EQ(Octree::octree_t<double>(span, bounding_box, never_split).get_number_of_nodes(), 1);
+
+    Parallel::thread_pool_t thread_pool{3};
+    for (const auto& parameters : {Octree::subdivision_parameters_t<double>{}, cheap_nodes, shallow, never_split}) {
+        Octree::octree_t<double> octree{span, bounding_box, parameters};
+        ASSERT_LE(octree.get_depth(), parameters.max_depth);
+
+        Geom_objects::intersection_bitset_t result{3000};
+        octree.get_number_of_intersections(result);
+        ASSERT_EQ(result, expected);
+
+        Octree::octree_t<double> parallel_octree{span, bounding_box, parameters, thread_pool};
+        ASSERT_EQ(parallel_octree.get_number_of_nodes(), octree.get_number_of_nodes());
+
+        Geom_objects::intersection_bitset_t parallel_result{3000};
+        parallel_octree.get_number_of_intersections(parallel_result, thread_pool);
+        ASSERT_EQ(parallel_result, expected);
+    }
+}
+
+TEST(INTERSECTION_BITSET, insert_and_scan_in_order) {
+    Geom_objects::intersection_bitset_t result{200};
+    ASSERT_TRUE(result.empty());
+
+    // Several threads mark the same words
+    Parallel::thread_pool_t thread_pool{3};
+    thread_pool.parallel_for(0, 200, 7, [&](size_t begin, size_t end) {
+        for (size_t number = begin; number < end; ++number) {
+            if (number % 3 == 0 || number == 199)
+                result.insert(number);
+        }
+    });
+
+    std::vector<size_t> expected;
+    for (size_t number = 0; number < 200; ++number) {
+        if (number % 3 == 0 || number == 199)
+            expected.push_back(number);
+    }
+
+    ASSERT_EQ(result.get_numbers(), expected);
+    ASSERT_EQ(result.size(), expected.size());
+    ASSERT_TRUE(result.contains(63));
+    ASSERT_FALSE(result.contains(64));
+
+    result.insert(64);
+    ASSERT_TRUE(result.contains(64));
+    result.clear();
+    ASSERT_TRUE(result.empty());
+}
+
+TEST(INTERSECTION_BITSET, pairs_of_found_polygons_are_skipped) {
+    std::mt19937 generator{8};
+    std::uniform_real_distribution<double> distribution{-3.0, 3.0};
+
+    // Dense: almost every triangle intersects many others
+    std::vector<Geom_objects::polygon_t<double>> polygons;
+    for (size_t number = 0; number < 100; ++number) {
+        double coordinates[9];
+        for (double& coordinate : coordinates)
+            coordinate = distribution(generator);
+        polygons.push_back(Geom_objects::make_geometric_primitive<double>(coordinates, number));
+    }
+
+    Geom_objects::polygon_batch_t<double> batch;
+    for (const auto& polygon : polygons)
+        batch.push_back(polygon);
+
+    std::set<size_t> expected;
+    Geom_objects::intersection_bitset_t result{polygons.size()};
+    size_t number_of_skipped = 0;
+    for (size_t first = 0; first < polygons.size(); ++first) {
+        bool first_is_found = result.contains(first);
+        batch.intersect(polygons[first], first + 1, [&](size_t second) {
+            result.insert(first);
+            result.insert(second);
+        }, [&](size_t second) {
+            bool skip = first_is_found && result.contains(second);
+            number_of_skipped += skip;
+            return skip;
+        });
+
+        batch.intersect(polygons[first], first + 1, [&](size_t second) {
+            expected.insert(first);
+            expected.insert(second);
+        });
+    }
+
+    ASSERT_EQ(result.get_numbers(), std::vector<size_t>(expected.begin(), expected.end()));
+    ASSERT_GT(number_of_skipped, 0u);
+}
+
+// Batches reject a pair by boxes before the exact test. check_figures_intersection alone
+// reports some triangles with boxes a unit apart as intersecting, those pairs are dropped
+// (Geom_objects::boxes_are_apart).
+TEST(TRIANGLE_BATCH, same_as_scalar_test) {
+    std::mt19937 generator{3};
+    std::uniform_real_distribution<double> distribution{-2.0, 2.0};
+    std::uniform_int_distribution<int> grid{-2, 2};
+
+    // Random triangles and triangles on a small grid: those touch, share planes and edges
+    std::vector<Geom_objects::polygon_t<double>> polygons;
+    for (size_t number = 0; number < 300; ++number) {
+        double coordinates[9];
+        for (double& coordinate : coordinates)
+            coordinate = number % 2 ? distribution(generator) : grid(generator);
+        polygons.push_back(Geom_objects::make_geometric_primitive<double>(coordinates, number));
+    }
+
+    Geom_objects::primitive_store_t<double> store;
+    for (const auto& polygon : polygons)
+        store.add(polygon);
+
+    auto supported = Geom_objects::get_supported_simd_level();
+    for (auto level : {Geom_objects::simd_level_t::sse, Geom_objects::simd_level_t::avx2,
+                       Geom_objects::simd_level_t::avx512}) {
+        if (level > supported)
+            continue;
+
+        Geom_objects::polygon_batch_t<double> batch;
+        batch.set_simd_level(level);
+        for (const auto& polygon : polygons)
+            batch.push_back(polygon);
+
+        for (size_t first = 0; first < polygons.size(); ++first) {
+            std::vector<size_t> expected, found;
+            for (size_t second = first + 1; second < polygons.size(); ++second) {
+                if (!Geom_objects::boxes_are_apart(polygons[first], polygons[second]) &&
+                    Geom_objects::check_figures_intersection(polygons[first], polygons[second]))
+                    expected.push_back(second);
+            }
+
+            batch.intersect(polygons[first], first + 1, [&](size_t second) { found.push_back(second); });
+            ASSERT_EQ(expected, found);
+
+            Geom_objects::store_batch_t<double> store_batch;
+            store_batch.set_simd_level(level);
+            for (size_t second = first + 1; second < polygons.size(); ++second)
+                store_batch.push_back(store, static_cast<uint32_t>(second));
+
+            // Triangles come first, then points and segments
+            found.clear();
+            store_batch.intersect(store, static_cast<uint32_t>(first), [&](uint32_t second) { found.push_back(second); });
+            std::sort(found.begin(), found.end());
+            ASSERT_EQ(expected, found);
+        }
+    }
+}
+
+TEST(TRIANGLE_BATCH, box_filter_counts_rejected_pairs) {
+    std::mt19937 generator{7};
+    std::uniform_int_distribution<int> grid{-6, 6};
+    std::uniform_int_distribution<int> offset{0, 2};
+
+    // Small triangles, segments and points on a grid: boxes touch by faces, edges and corners
+    std::vector<Geom_objects::polygon_t<double>> polygons;
+    for (size_t number = 0; number < 400; ++number) {
+        double corner[3] = {double(grid(generator)), double(grid(generator)), double(grid(generator))};
+        double coordinates[9];
+        for (size_t coordinate = 0; coordinate < 9; ++coordinate)
+            coordinates[coordinate] = corner[coordinate % 3] + (number % 6 == 0 ? 0 : offset(generator));
+        if (number % 6 == 1)
+            std::copy(coordinates, coordinates + 3, coordinates + 6);
+        polygons.push_back(Geom_objects::make_geometric_primitive<double>(coordinates, number));
+    }
+
+    auto supported = Geom_objects::get_supported_simd_level();
+    for (auto level : {Geom_objects::simd_level_t::none, Geom_objects::simd_level_t::sse,
+                       Geom_objects::simd_level_t::avx2, Geom_objects::simd_level_t::avx512}) {
+        if (level > supported)
+            continue;
+
+        Geom_objects::polygon_batch_t<double> batch;
+        batch.set_simd_level(level);
+        for (const auto& polygon : polygons)
+            batch.push_back(polygon);
+
+        size_t expected_rejected = 0;
+        for (size_t first = 0; first < polygons.size(); ++first) {
+            std::vector<size_t> expected, found;
+            for (size_t second = first + 1; second < polygons.size(); ++second) {
+                bool apart = Geom_objects::boxes_are_apart(polygons[first], polygons[second]);
+                expected_rejected += apart;
+                if (!apart && Geom_objects::check_figures_intersection(polygons[first], polygons[second]))
+                    expected.push_back(second);
+            }
+
+            batch.intersect(polygons[first], first + 1, [&](size_t second) { found.push_back(second); });
+            ASSERT_EQ(expected, found);
+        }
+
+        EXPECT_EQ(batch.get_number_of_pairs(), polygons.size() * (polygons.size() - 1) / 2);
+        EXPECT_EQ(batch.get_number_of_rejected(), expected_rejected);
+        EXPECT_GT(expected_rejected, 0u);
+    }
+}
+
+namespace {
+
+// A broad phase built serially and on a pool finds the same intersections as the octree.
+// check(serial, parallel) adds what is specific to the broad phase.
+template <typename BroadPhaseT, typename Check>
+void check_same_result_as_octree(const std::vector<double>& coordinates, Check&& check) {
+    std::span<const double> span{coordinates};
+    size_t number_of_polygons = coordinates.size() / Input::coordinates_per_triangle;
+
+    Octree::octree_t<double> octree{span, Benchmarks::make_bounding_box(coordinates)};
+    Geom_objects::intersection_bitset_t result{number_of_polygons};
+    octree.get_number_of_intersections(result);
+
+    BroadPhaseT serial{span};
+    Geom_objects::intersection_bitset_t serial_result{number_of_polygons};
+    serial.get_number_of_intersections(serial_result);
+
+    Parallel::thread_pool_t thread_pool{3};
+    BroadPhaseT parallel{span, thread_pool};
+    Geom_objects::intersection_bitset_t parallel_result{number_of_polygons};
+    parallel.get_number_of_intersections(parallel_result, thread_pool);
+
+    ASSERT_FALSE(result.empty());
+    ASSERT_EQ(result, serial_result);
+    ASSERT_EQ(result, parallel_result);
+    check(serial, parallel);
+}
+
+// Every pair of overlapping boxes is a candidate of the sweep exactly once
+size_t get_number_of_box_pairs(const std::vector<double>& coordinates) {
+    Broad_phase::sweep_and_prune_t<double> sweep{std::span<const double>{coordinates}};
+    Geom_objects::intersection_bitset_t result{coordinates.size() / Input::coordinates_per_triangle};
+    sweep.get_number_of_intersections(result);
+    return sweep.get_number_of_candidates();
+}
+
+} // namespace
+
+TEST(SWEEP_AND_PRUNE, same_result_as_octree) {
+    // Points, segments, triangles in shared planes, and long thin ones that stay at the root of the octree
+    auto coordinates = Benchmarks::make_scene(Benchmarks::scene_kind_t::degenerate, 3000, 4);
+    for (size_t triangle = 0; triangle < 3000; triangle += 7)
+        coordinates[triangle * 9 + 6] = -coordinates[triangle * 9];
+
+    using sweep_and_prune_t = Broad_phase::sweep_and_prune_t<double>;
+    check_same_result_as_octree<sweep_and_prune_t>(coordinates, [](const sweep_and_prune_t& serial,
+                                                                   const sweep_and_prune_t& parallel) {
+        ASSERT_EQ(serial.get_number_of_candidates(), parallel.get_number_of_candidates());
+    });
+}
+
+TEST(BVH, same_result_as_octree) {
+    // Dense clusters and sparse triangles between them
+    auto coordinates = Benchmarks::make_scene(Benchmarks::scene_kind_t::clustered, 4000, 5);
+    size_t number_of_box_pairs = get_number_of_box_pairs(coordinates);
+
+    using bvh_t = Broad_phase::bvh_t<double>;
+    check_same_result_as_octree<bvh_t>(coordinates, [&](const bvh_t& serial, const bvh_t& parallel) {
+        ASSERT_EQ(serial.get_number_of_nodes(), parallel.get_number_of_nodes());
+        ASSERT_EQ(serial.get_number_of_candidates(), number_of_box_pairs);
+        ASSERT_EQ(parallel.get_number_of_candidates(), number_of_box_pairs);
+    });
+}
+
+TEST(HASH_GRID, same_result_as_octree) {
+    // Triangles of similar size, every tenth one is long and spans many cells
+    auto coordinates = Benchmarks::make_scene(Benchmarks::scene_kind_t::uniform, 3000, 6);
+    for (size_t triangle = 0; triangle < 3000; triangle += 10) {
+        double* points = coordinates.data() + triangle * 9;
+        for (size_t coordinate = 3; coordinate < 9; ++coordinate)
+            points[coordinate] = points[coordinate % 3] + 8.0 * (points[coordinate] - points[coordinate % 3]);
+    }
+    size_t number_of_box_pairs = get_number_of_box_pairs(coordinates);
+
+    // A pair sharing several cells is tested once
+    using hash_grid_t = Broad_phase::hash_grid_t<double>;
+    check_same_result_as_octree<hash_grid_t>(coordinates, [&](const hash_grid_t& serial, const hash_grid_t& parallel) {
+        ASSERT_GT(serial.get_entries().size(), coordinates.size() / 9);
+        ASSERT_EQ(serial.get_number_of_candidates(), number_of_box_pairs);
+        ASSERT_EQ(parallel.get_number_of_candidates(), number_of_box_pairs);
+    });
+}
+
+// Float primitives are the double ones with rounded vertices, the kind is decided in double
+TEST(FLOAT_PIPELINE, kinds_are_decided_in_double) {
+    // Collinear in double, but rounding to float puts the middle vertex off the line
+    const double coordinates[9] = {0.0, 0.0, 0.0, 0.1, 0.2, 0.3, 0.2, 0.4, 0.6};
+    auto polygon = Geom_objects::make_geometric_primitive<float>(coordinates, 7);
+
+    ASSERT_EQ(polygon.index(), Geom_objects::make_geometric_primitive<double>(coordinates, 7).index());
+    ASSERT_EQ(Geom_objects::convert_polygon<double>(polygon).index(), polygon.index());
+    ASSERT_EQ(std::visit([](const auto& primitive) { return primitive.get_number(); }, polygon), 7u);
+}
+
+// Coordinates exactly representable in float: both pipelines see the same scene
+TEST(FLOAT_PIPELINE, same_result_as_double) {
+    std::mt19937 generator{18};
+    std::uniform_real_distribution<float> distribution{-20.0f, 20.0f};
+    std::uniform_int_distribution<int> grid{-4, 4};
+
+    // Random triangles and triangles on a grid: those touch and share planes
+    std::vector<double> coordinates;
+    for (size_t triangle = 0; triangle < 2000; ++triangle) {
+        float center[3] = {distribution(generator), distribution(generator), distribution(generator)};
+        for (size_t coordinate = 0; coordinate < 9; ++coordinate) {
+            float value = triangle % 2 ? center[coordinate % 3] + distribution(generator) / 10
+                                       : static_cast<float>(grid(generator)) / 2;
+            coordinates.push_back(value);
+        }
+    }
+
+    std::span<const double> span{coordinates};
+    size_t number_of_triangles = coordinates.size() / 9;
+
+    Broad_phase::sweep_and_prune_t<double> sweep{span};
+    Geom_objects::intersection_bitset_t result{number_of_triangles};
+    sweep.get_number_of_intersections(result);
+
+    Broad_phase::sweep_and_prune_t<float> float_sweep{span};
+    Geom_objects::intersection_bitset_t float_result{number_of_triangles};
+    float_sweep.get_number_of_intersections(float_result);
+
+    Geom_objects::AABB_t<float> bounding_box{{0.0f, 0.0f, 0.0f}, {30.0f, 30.0f, 30.0f}};
+    Octree::octree_t<float> octree{span, bounding_box};
+    Geom_objects::intersection_bitset_t octree_result{number_of_triangles};
+    octree.get_number_of_intersections(octree_result);
+
+    ASSERT_FALSE(result.empty());
+    ASSERT_EQ(result, float_result);
+    ASSERT_EQ(result, octree_result);
+
+    // The vectorized float box filter rejects the same pairs as the scalar one
+    std::vector<Geom_objects::polygon_t<float>> polygons;
+    for (size_t number = 0; number < 300; ++number)
+        polygons.push_back(Geom_objects::make_geometric_primitive<float>(coordinates.data() + number * 9, number));
+
+    auto supported = Geom_objects::get_supported_simd_level();
+    for (auto level : {Geom_objects::simd_level_t::sse, Geom_objects::simd_level_t::avx2}) {
+        if (level > supported)
+            continue;
+
+        Geom_objects::polygon_batch_t<float> batch, scalar_batch;
+        batch.set_simd_level(level);
+        scalar_batch.set_simd_level(Geom_objects::simd_level_t::none);
+        for (const auto& polygon : polygons) {
+            batch.push_back(polygon);
+            scalar_batch.push_back(polygon);
+        }
+
+        for (size_t first = 0; first < polygons.size(); ++first) {
+            std::vector<size_t> expected, found;
+            scalar_batch.intersect(polygons[first], first + 1, [&](size_t second) { expected.push_back(second); });
+            batch.intersect(polygons[first], first + 1, [&](size_t second) { found.push_back(second); });
+            ASSERT_EQ(expected, found);
+        }
+
+        ASSERT_EQ(batch.get_number_of_rejected(), scalar_batch.get_number_of_rejected());
+    }
+}
+
+TEST(PAIR_OUTPUT, every_pair_is_reported_once) {
+    std::mt19937 generator{9};
+    std::uniform_real_distribution<double> distribution{-10.0, 10.0};
+    std::uniform_real_distribution<double> offset{-1.5, 1.5};
+
+    std::vector<double> coordinates;
+    for (size_t triangle = 0; triangle < 1000; ++triangle) {
+        double center[3] = {distribution(generator), distribution(generator), distribution(generator)};
+        for (size_t coordinate = 0; coordinate < 9; ++coordinate)
+            coordinates.push_back(center[coordinate % 3] + offset(generator));
+    }
+
+    size_t number_of_polygons = coordinates.size() / 9;
+    std::vector<Geom_objects::polygon_t<double>> polygons;
+    Geom_objects::polygon_batch_t<double> batch;
+    for (size_t number = 0; number < number_of_polygons; ++number) {
+        polygons.push_back(Geom_objects::make_geometric_primitive<double>(coordinates.data() + number * 9, number));
+        batch.push_back(polygons.back());
+    }
+
+    std::vector<std::pair<size_t, size_t>> expected;
+    for (size_t first = 0; first < number_of_polygons; ++first)
+        batch.intersect(polygons[first], first + 1, [&](size_t second) { expected.emplace_back(first, second); });
+
+    std::mutex mutex;
+    std::vector<std::pair<size_t, size_t>> pairs;
+    Geom_objects::pair_callback_t result{[&](size_t first, size_t second) {
+        std::lock_guard lock{mutex};
+        pairs.emplace_back(std::min(first, second), std::max(first, second));
+    }};
+
+    auto check_pairs = [&] {
+        std::sort(pairs.begin(), pairs.end());
+        ASSERT_EQ(pairs, expected);
+        pairs.clear();
+    };
+
+    Broad_phase::sweep_and_prune_t<double> sweep{std::span<const double>{coordinates}};
+    sweep.get_number_of_intersections(result);
+    check_pairs();
+
+    Parallel::thread_pool_t thread_pool{3};
+    Broad_phase::bvh_t<double> bvh{std::span<const double>{coordinates}, thread_pool};
+    bvh.get_number_of_intersections(result, thread_pool);
+    check_pairs();
+
+    Broad_phase::hash_grid_t<double> grid{std::span<const double>{coordinates}, thread_pool};
+    grid.get_number_of_intersections(result, thread_pool);
+    check_pairs();
+
+    ASSERT_FALSE(expected.empty());
+}
+
+TEST(PAIR_OUTPUT, text_and_binary_records) {
+    std::vector<std::pair<size_t, size_t>> pairs;
+    for (size_t number = 0; number < 3 * Output::pair_buffer_t::pairs_in_block + 5; ++number)
+        pairs.emplace_back(number * 7 + 3, number % 11);
+
+    auto write = [&](Output::pair_format_t format) {
+        std::ostringstream output;
+        Output::pair_writer_t writer{output, format};
+        {
+            Output::pair_buffer_t buffer{writer};
+            for (auto [first, second] : pairs)
+                buffer.push_back(first, second);
+        }
+        EXPECT_EQ(writer.get_number_of_pairs(), pairs.size());
+        return output.str();
+    };
+
+    std::string text = write(Output::pair_format_t::text);
+    std::istringstream input{text};
+    for (auto [first, second] : pairs) {
+        size_t read_first = 0, read_second = 0;
+        ASSERT_TRUE(input >> read_first >> read_second);
+        ASSERT_EQ(read_first, std::min(first, second));
+        ASSERT_EQ(read_second, std::max(first, second));
+    }
+
+    std::string binary = write(Output::pair_format_t::binary);
+    ASSERT_EQ(binary.size(), pairs.size() * 2 * sizeof(uint32_t));
+    for (size_t number = 0; number < pairs.size(); ++number) {
+        uint32_t record[2];
+        std::memcpy(record, binary.data() + number * sizeof(record), sizeof(record));
+        ASSERT_EQ(record[0], std::min(pairs[number].first, pairs[number].second));
+        ASSERT_EQ(record[1], std::max(pairs[number].first, pairs[number].second));
+    }
+}
+
+TEST(NUMBER_OUTPUT, text_and_binary_records) {
+    // Several blocks and numbers of every length
+    std::vector<size_t> numbers;
+    for (size_t number = 0; numbers.size() < 3 * Output::number_writer_t::block_size / 4; number = number * 3 + 1)
+        numbers.push_back(number % 4000000000u);
+
+    std::ostringstream text_output;
+    {
+        Output::number_writer_t writer{text_output, Output::number_format_t::text};
+        for (size_t number : numbers)
+            writer.write(number);
+    }
+
+    std::string expected;
+    for (size_t number : numbers)
+        expected += std::to_string(number) + "\n";
+    ASSERT_EQ(text_output.str(), expected);
+
+    std::ostringstream binary_output;
+    Output::number_writer_t writer{binary_output, Output::number_format_t::binary};
+    for (size_t number : numbers)
+        writer.write(number);
+    writer.flush();
+
+    std::string binary = binary_output.str();
+    ASSERT_EQ(binary.size(), numbers.size() * sizeof(uint32_t));
+    for (size_t number = 0; number < numbers.size(); ++number) {
+        uint32_t value = 0;
+        std::memcpy(&value, binary.data() + number * sizeof(value), sizeof(value));
+        ASSERT_EQ(value, numbers[number]);
+    }
+}
+
 int main(int argc, char** argv) {
     testing::InitGoogleTest(&argc, argv);
 